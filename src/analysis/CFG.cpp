@@ -0,0 +1,94 @@
+#include "analysis/CFG.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "ir/Instruction.h"
+
+namespace analysis {
+
+CFG::CFG(Function &Fn) {
+  auto &AllBlocks = Fn.getBlocks();
+  Blocks.reserve(AllBlocks.size());
+  Numbers.assign(Fn.getNumBlockIDs(), NoNumber);
+  for (auto &BB : AllBlocks) {
+    Numbers[BB.getID()] = Blocks.size();
+    Blocks.push_back(&BB);
+  }
+
+  Preds.resize(Blocks.size());
+  Succs.resize(Blocks.size());
+  for (unsigned N = 0; N < size(); ++N) {
+    Succs[N] = findSuccessors(N);
+    for (auto S : Succs[N])
+      Preds[S].push_back(N);
+  }
+}
+
+std::vector<unsigned> CFG::findSuccessors(unsigned N) const {
+  std::vector<unsigned> Result;
+  for (auto &Inst : *Blocks[N]) {
+    if (!Inst.isTerminator())
+      continue;
+    // Only the first terminator is ever reached.
+    for (auto *Target : Inst.successors()) {
+      unsigned S = getNumber(Target);
+      if (std::find(Result.begin(), Result.end(), S) == Result.end())
+        Result.push_back(S);
+    }
+    return Result;
+  }
+
+  if (auto *LayoutNext = Blocks[N]->getNextNode())
+    Result.push_back(getNumber(LayoutNext));
+  return Result;
+}
+
+unsigned CFG::getNumber(BasicBlock *BB) const {
+  assert(BB->getID() < Numbers.size() && Numbers[BB->getID()] != NoNumber &&
+         "Block is not in the graph");
+  return Numbers[BB->getID()];
+}
+
+unsigned CFG::addBlock(BasicBlock *BB) {
+  if (Numbers.size() <= BB->getID())
+    Numbers.resize(BB->getParent()->getNumBlockIDs(), NoNumber);
+  if (Numbers[BB->getID()] != NoNumber)
+    return Numbers[BB->getID()];
+
+  unsigned N = Blocks.size();
+  Numbers[BB->getID()] = N;
+  Blocks.push_back(BB);
+  Preds.emplace_back();
+  Succs.emplace_back();
+  return N;
+}
+
+bool CFG::addEdge(unsigned From, unsigned To) {
+  auto &Out = Succs[From];
+  if (std::find(Out.begin(), Out.end(), To) != Out.end())
+    return false;
+  Out.push_back(To);
+  Preds[To].push_back(From);
+  return true;
+}
+
+bool CFG::removeEdge(unsigned From, unsigned To) {
+  auto &Out = Succs[From];
+  auto It = std::find(Out.begin(), Out.end(), To);
+  if (It == Out.end())
+    return false;
+  Out.erase(It);
+  auto &In = Preds[To];
+  In.erase(std::find(In.begin(), In.end(), From));
+  return true;
+}
+
+void CFG::updateSuccessors(unsigned N) {
+  for (auto S : std::vector<unsigned>(Succs[N]))
+    removeEdge(N, S);
+  for (auto S : findSuccessors(N))
+    addEdge(N, S);
+}
+
+} // namespace analysis
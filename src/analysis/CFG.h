@@ -0,0 +1,64 @@
+#ifndef TOY_LANG_ANALYSIS_CFG_H
+#define TOY_LANG_ANALYSIS_CFG_H
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "ir/BasicBlock.h"
+#include "ir/Function.h"
+
+namespace analysis {
+
+/// CFG - The predecessors and successors of the blocks of a function.
+///
+/// Blocks are numbered in layout order, so the entry block is 0, and the
+/// analyses refer to blocks by number. The successors of a block are the
+/// targets of its first terminator, or the next block in layout order if it
+/// has none.
+///
+/// A pass that changes branches can keep the graph up to date edge by edge,
+/// or have the edges of one block read again, rather than build it anew.
+class CFG {
+public:
+  explicit CFG(Function &Fn);
+
+  unsigned size() const { return Blocks.size(); }
+
+  BasicBlock *getBlock(unsigned N) const { return Blocks[N]; }
+  unsigned getNumber(BasicBlock *BB) const;
+
+  std::span<const unsigned> preds(unsigned N) const { return Preds[N]; }
+  std::span<const unsigned> succs(unsigned N) const { return Succs[N]; }
+
+  /// Number a block that was added to the function after the graph was built.
+  /// It starts out without edges.
+  unsigned addBlock(BasicBlock *BB);
+
+  /// Add the edge from \p From to \p To, and return false if it was already
+  /// there.
+  bool addEdge(unsigned From, unsigned To);
+
+  /// Remove the edge from \p From to \p To, and return false if there was
+  /// none.
+  bool removeEdge(unsigned From, unsigned To);
+
+  /// Read the successors of block \p N again from its instructions.
+  void updateSuccessors(unsigned N);
+
+private:
+  /// The successors that the instructions of block \p N give it.
+  std::vector<unsigned> findSuccessors(unsigned N) const;
+
+  std::vector<BasicBlock *> Blocks;
+  /// The number of each block, indexed by its ID, or NoNumber for blocks
+  /// that are not in the graph.
+  static constexpr unsigned NoNumber = ~0U;
+  std::vector<unsigned> Numbers;
+  std::vector<std::vector<unsigned>> Preds;
+  std::vector<std::vector<unsigned>> Succs;
+};
+
+} // namespace analysis
+
+#endif // !TOY_LANG_ANALYSIS_CFG_H
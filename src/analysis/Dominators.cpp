@@ -0,0 +1,274 @@
+#include "analysis/Dominators.h"
+
+#include <algorithm>
+#include <cassert>
+#include <queue>
+#include <utility>
+
+namespace analysis {
+
+DominatorTree::DominatorTree(const CFG &G) : G(G) { recalculate(); }
+
+void DominatorTree::recalculate() {
+  unsigned Size = G.size();
+  IDom.assign(Size, None);
+  Level.assign(Size, 0);
+  Children.assign(Size, {});
+  VisitedEpoch.assign(Size, 0);
+  DFSValid = false;
+  if (Size == 0)
+    return;
+
+  // Number the reachable blocks in post-order, with an explicit stack since
+  // the graph may be arbitrarily deep.
+  std::vector<unsigned> PostNum(Size, None);
+  std::vector<unsigned> Order;
+  std::vector<std::pair<unsigned, size_t>> Stack{{0, 0}};
+  std::vector<bool> Seen(Size);
+  Seen[0] = true;
+  while (!Stack.empty()) {
+    auto [B, Next] = Stack.back();
+    auto Succs = G.succs(B);
+    if (Next < Succs.size()) {
+      ++Stack.back().second;
+      if (unsigned S = Succs[Next]; !Seen[S]) {
+        Seen[S] = true;
+        Stack.emplace_back(S, 0);
+      }
+      continue;
+    }
+    PostNum[B] = Order.size();
+    Order.push_back(B);
+    Stack.pop_back();
+  }
+
+  auto Intersect = [&](unsigned A, unsigned B) {
+    while (A != B) {
+      while (PostNum[A] < PostNum[B])
+        A = IDom[A];
+      while (PostNum[B] < PostNum[A])
+        B = IDom[B];
+    }
+    return A;
+  };
+
+  // Visit the blocks in reverse post-order until nothing changes. The entry
+  // is its own dominator while this runs, so that the walks stop there.
+  IDom[0] = 0;
+  for (bool Changed = true; Changed;) {
+    Changed = false;
+    for (auto It = std::next(Order.rbegin()); It != Order.rend(); ++It) {
+      unsigned B = *It;
+      unsigned NewIDom = None;
+      for (auto P : G.preds(B)) {
+        if (IDom[P] == None)
+          continue;
+        NewIDom = NewIDom == None ? P : Intersect(P, NewIDom);
+      }
+      if (IDom[B] != NewIDom) {
+        IDom[B] = NewIDom;
+        Changed = true;
+      }
+    }
+  }
+  IDom[0] = None;
+
+  for (auto It = std::next(Order.rbegin()); It != Order.rend(); ++It) {
+    Level[*It] = Level[IDom[*It]] + 1;
+    Children[IDom[*It]].push_back(*It);
+  }
+}
+
+bool DominatorTree::dominates(unsigned A, unsigned B) const {
+  if (!isReachable(A) || !isReachable(B))
+    return false;
+  if (A == B)
+    return true;
+  if (!DFSValid)
+    computeDFSNumbers();
+  return DFSIn[A] <= DFSIn[B] && DFSOut[B] <= DFSOut[A];
+}
+
+void DominatorTree::computeDFSNumbers() const {
+  DFSIn.assign(G.size(), 0);
+  DFSOut.assign(G.size(), 0);
+  unsigned Clock = 0;
+  std::vector<std::pair<unsigned, size_t>> Stack{{0, 0}};
+  DFSIn[0] = Clock++;
+  while (!Stack.empty()) {
+    auto [B, Next] = Stack.back();
+    if (Next < Children[B].size()) {
+      ++Stack.back().second;
+      unsigned C = Children[B][Next];
+      DFSIn[C] = Clock++;
+      Stack.emplace_back(C, 0);
+      continue;
+    }
+    DFSOut[B] = Clock++;
+    Stack.pop_back();
+  }
+  DFSValid = true;
+}
+
+unsigned DominatorTree::findNearestCommonDominator(unsigned A,
+                                                   unsigned B) const {
+  assert(isReachable(A) && isReachable(B) && "Block is not in the tree");
+  while (Level[A] > Level[B])
+    A = IDom[A];
+  while (Level[B] > Level[A])
+    B = IDom[B];
+  while (A != B) {
+    A = IDom[A];
+    B = IDom[B];
+  }
+  return A;
+}
+
+std::vector<unsigned> DominatorTree::postOrder() const {
+  std::vector<unsigned> Order;
+  if (G.size() == 0)
+    return Order;
+
+  std::vector<std::pair<unsigned, size_t>> Stack{{0, 0}};
+  while (!Stack.empty()) {
+    auto [B, Next] = Stack.back();
+    if (Next < Children[B].size()) {
+      ++Stack.back().second;
+      Stack.emplace_back(Children[B][Next], 0);
+      continue;
+    }
+    Order.push_back(B);
+    Stack.pop_back();
+  }
+  return Order;
+}
+
+void DominatorTree::setIDom(unsigned N, unsigned NewIDom) {
+  auto &Siblings = Children[IDom[N]];
+  auto It = std::find(Siblings.begin(), Siblings.end(), N);
+  std::swap(*It, Siblings.back());
+  Siblings.pop_back();
+
+  IDom[N] = NewIDom;
+  Children[NewIDom].push_back(N);
+}
+
+bool DominatorTree::visit(unsigned N) {
+  if (VisitedEpoch[N] == Epoch)
+    return false;
+  VisitedEpoch[N] = Epoch;
+  return true;
+}
+
+void DominatorTree::insertEdge(unsigned From, unsigned To) {
+  // Blocks added to the CFG since the tree was computed are not in it.
+  IDom.resize(G.size(), None);
+  Level.resize(G.size());
+  Children.resize(G.size());
+  VisitedEpoch.resize(G.size());
+
+  if (!isReachable(From))
+    return;
+  // The blocks that the edge makes reachable need their dominators found
+  // from scratch.
+  if (!isReachable(To)) {
+    recalculate();
+    return;
+  }
+
+  // A block whose dominator changes now has the nearest common dominator of
+  // From and To as its dominator. Only blocks deeper than the level below it
+  // can be affected, and those are found from To, deepest first.
+  unsigned NCD = findNearestCommonDominator(From, To);
+  unsigned NCDLevel = Level[NCD];
+  if (Level[To] <= NCDLevel + 1)
+    return;
+
+  ++Epoch;
+  std::priority_queue<std::pair<unsigned, unsigned>> Bucket;
+  std::vector<unsigned> Affected;
+  std::vector<unsigned> Unaffected;
+  visit(To);
+  Bucket.emplace(Level[To], To);
+  while (!Bucket.empty()) {
+    unsigned N = Bucket.top().second;
+    Bucket.pop();
+    Affected.push_back(N);
+
+    // Blocks deeper than N that are reached from it are not affected, but
+    // their successors may be.
+    unsigned CurrentLevel = Level[N];
+    while (true) {
+      for (auto S : G.succs(N)) {
+        unsigned SuccLevel = Level[S];
+        if (SuccLevel <= NCDLevel + 1 || !visit(S))
+          continue;
+        if (SuccLevel > CurrentLevel)
+          Unaffected.push_back(S);
+        else
+          Bucket.emplace(SuccLevel, S);
+      }
+      if (Unaffected.empty())
+        break;
+      N = Unaffected.back();
+      Unaffected.pop_back();
+    }
+  }
+
+  for (auto N : Affected)
+    setIDom(N, NCD);
+
+  // The affected blocks are now children of NCD, and their subtrees are
+  // disjoint, so each one is relevelled once.
+  std::vector<unsigned> Worklist;
+  for (auto N : Affected) {
+    Level[N] = NCDLevel + 1;
+    Worklist.push_back(N);
+    while (!Worklist.empty()) {
+      unsigned B = Worklist.back();
+      Worklist.pop_back();
+      for (auto C : Children[B]) {
+        Level[C] = Level[B] + 1;
+        Worklist.push_back(C);
+      }
+    }
+  }
+  DFSValid = false;
+}
+
+void DominatorTree::deleteEdge(unsigned From, unsigned To) {
+  if (!isReachable(From) || !isReachable(To))
+    return;
+  // Every path that used a back edge reached its target before, so removing
+  // one changes no dominator.
+  if (dominates(To, From))
+    return;
+  recalculate();
+}
+
+DominanceFrontier::DominanceFrontier(const CFG &G, const DominatorTree &DT)
+    : Frontiers(G.size()) {
+  for (unsigned B = 0; B < G.size(); ++B) {
+    auto Preds = G.preds(B);
+    // Control also enters the entry block from outside the function.
+    if (!DT.isReachable(B) || Preds.size() + (B == 0) < 2)
+      continue;
+
+    // B is in the frontier of each block that dominates one of its
+    // predecessors but not B itself.
+    unsigned IDom = DT.getIDom(B);
+    for (auto P : Preds) {
+      if (!DT.isReachable(P))
+        continue;
+      for (unsigned Runner = P; Runner != IDom; Runner = DT.getIDom(Runner)) {
+        auto &Frontier = Frontiers[Runner];
+        if (Frontier.empty() || Frontier.back() != B)
+          Frontier.push_back(B);
+        if (Runner == 0)
+          break;
+      }
+    }
+  }
+}
+
+} // namespace analysis
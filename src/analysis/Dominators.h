@@ -0,0 +1,102 @@
+#ifndef TOY_LANG_ANALYSIS_DOMINATORS_H
+#define TOY_LANG_ANALYSIS_DOMINATORS_H
+
+#include <climits>
+#include <span>
+#include <vector>
+
+#include "analysis/CFG.h"
+
+namespace analysis {
+
+/// DominatorTree - The immediate dominator of each block of a CFG, computed
+/// with the iterative algorithm of Cooper, Harvey and Kennedy, "A Simple,
+/// Fast Dominance Algorithm". Blocks that the entry cannot reach are not in
+/// the tree.
+///
+/// The tree can follow edges that are added to the CFG one at a time, with
+/// the insertion algorithm of Georgiadis et al., "An Experimental Study of
+/// Dynamic Dominators": only the blocks whose immediate dominator changes are
+/// visited. Removing an edge that is not a back edge, or adding one that
+/// makes blocks reachable, computes the tree again.
+class DominatorTree {
+public:
+  static constexpr unsigned None = UINT_MAX;
+
+  explicit DominatorTree(const CFG &G);
+
+  /// Compute the tree from scratch.
+  void recalculate();
+
+  bool isReachable(unsigned N) const { return N == 0 || IDom[N] != None; }
+
+  /// The immediate dominator of \p N, or None for the entry block and for
+  /// unreachable blocks.
+  unsigned getIDom(unsigned N) const { return N == 0 ? None : IDom[N]; }
+
+  /// The blocks that \p N immediately dominates.
+  std::span<const unsigned> children(unsigned N) const { return Children[N]; }
+
+  /// The depth of \p N in the tree, where the entry block is 0.
+  unsigned getLevel(unsigned N) const { return Level[N]; }
+
+  /// Whether every path from the entry to \p B goes through \p A. Every block
+  /// dominates itself, and nothing dominates an unreachable block.
+  bool dominates(unsigned A, unsigned B) const;
+
+  unsigned findNearestCommonDominator(unsigned A, unsigned B) const;
+
+  /// The reachable blocks with every block after the ones it dominates.
+  std::vector<unsigned> postOrder() const;
+
+  /// Update the tree after the edge from \p From to \p To was added to the CFG.
+  void insertEdge(unsigned From, unsigned To);
+
+  /// Update the tree after the edge from \p From to \p To was removed from
+  /// the CFG.
+  void deleteEdge(unsigned From, unsigned To);
+
+private:
+  void setIDom(unsigned N, unsigned NewIDom);
+
+  /// Number the tree depth-first, for dominates().
+  void computeDFSNumbers() const;
+
+  /// Mark \p N as visited by the current update, and return false if it
+  /// already was.
+  bool visit(unsigned N);
+
+  const CFG &G;
+  std::vector<unsigned> IDom;
+  std::vector<unsigned> Level;
+  std::vector<std::vector<unsigned>> Children;
+
+  /// Entry and exit times of a walk over the tree. A block dominates another
+  /// when its interval contains the other's. Updates invalidate them, and the
+  /// next query numbers the tree again.
+  mutable std::vector<unsigned> DFSIn;
+  mutable std::vector<unsigned> DFSOut;
+  mutable bool DFSValid = false;
+
+  /// The blocks that an update has visited are those marked with its epoch,
+  /// so that an update does not need to clear anything for the whole tree.
+  std::vector<unsigned> VisitedEpoch;
+  unsigned Epoch = 0;
+};
+
+/// DominanceFrontier - For each block B, the blocks where the dominance of B
+/// ends: those that B does not strictly dominate but that have a predecessor
+/// B dominates. This is where SSA construction places phis.
+class DominanceFrontier {
+public:
+  DominanceFrontier(const CFG &G, const DominatorTree &DT);
+
+  std::span<const unsigned> get(unsigned N) const { return Frontiers[N]; }
+
+private:
+  std::vector<std::vector<unsigned>> Frontiers;
+};
+
+} // namespace analysis
+
+#endif // !TOY_LANG_ANALYSIS_DOMINATORS_H
@@ -0,0 +1,100 @@
+#include "analysis/LoopInfo.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace analysis {
+
+LoopInfo::LoopInfo(const CFG &G, const DominatorTree &DT)
+    : BlockLoops(G.size()) {
+  // Inner loops are found first, since their headers come first in a post
+  // order of the dominator tree, and are then folded into the loops around
+  // them.
+  std::vector<unsigned> Latches;
+  for (auto Header : DT.postOrder()) {
+    Latches.clear();
+    for (auto P : G.preds(Header))
+      if (DT.dominates(Header, P))
+        Latches.push_back(P);
+    if (Latches.empty())
+      continue;
+
+    Loops.push_back(std::make_unique<Loop>(Header));
+    discoverAndMapSubloop(Loops.back().get(), Latches, G, DT);
+  }
+  populate(G);
+}
+
+void LoopInfo::discoverAndMapSubloop(Loop *L, std::vector<unsigned> &Latches,
+                                     const CFG &G, const DominatorTree &DT) {
+  auto &Worklist = Latches;
+  while (!Worklist.empty()) {
+    unsigned B = Worklist.back();
+    Worklist.pop_back();
+
+    Loop *Sub = BlockLoops[B];
+    if (Sub == nullptr) {
+      if (!DT.isReachable(B))
+        continue;
+      BlockLoops[B] = L;
+      if (B == L->getHeader())
+        continue;
+      auto Preds = G.preds(B);
+      Worklist.insert(Worklist.end(), Preds.begin(), Preds.end());
+      continue;
+    }
+
+    // B is in a loop found before, which is nested in L. Skip over all of
+    // it, and go on from the predecessors of its header outside it.
+    while (Sub->Parent != nullptr)
+      Sub = Sub->Parent;
+    if (Sub == L)
+      continue;
+    Sub->Parent = L;
+    for (auto P : G.preds(Sub->getHeader()))
+      if (BlockLoops[P] != Sub)
+        Worklist.push_back(P);
+  }
+}
+
+void LoopInfo::populate(const CFG &G) {
+  if (G.size() == 0)
+    return;
+
+  // Every block of a loop comes before its header in a post order of the
+  // CFG, so a loop is complete when its header is reached.
+  std::vector<bool> Seen(G.size());
+  std::vector<std::pair<unsigned, size_t>> Stack{{0, 0}};
+  Seen[0] = true;
+  while (!Stack.empty()) {
+    auto [B, Next] = Stack.back();
+    auto Succs = G.succs(B);
+    if (Next < Succs.size()) {
+      ++Stack.back().second;
+      if (unsigned S = Succs[Next]; !Seen[S]) {
+        Seen[S] = true;
+        Stack.emplace_back(S, 0);
+      }
+      continue;
+    }
+    Stack.pop_back();
+
+    Loop *Sub = BlockLoops[B];
+    if (Sub != nullptr && Sub->getHeader() == B) {
+      if (Sub->Parent != nullptr)
+        Sub->Parent->SubLoops.push_back(Sub);
+      else
+        TopLevelLoops.push_back(Sub);
+      // The lists were built in post order. Put them in reverse post order,
+      // with the header still first.
+      std::reverse(Sub->Blocks.begin() + 1, Sub->Blocks.end());
+      std::reverse(Sub->SubLoops.begin(), Sub->SubLoops.end());
+      Sub = Sub->Parent;
+    }
+    for (; Sub != nullptr; Sub = Sub->Parent)
+      Sub->Blocks.push_back(B);
+  }
+  std::reverse(TopLevelLoops.begin(), TopLevelLoops.end());
+}
+
+} // namespace analysis
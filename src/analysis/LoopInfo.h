@@ -0,0 +1,95 @@
+#ifndef TOY_LANG_ANALYSIS_LOOP_INFO_H
+#define TOY_LANG_ANALYSIS_LOOP_INFO_H
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "analysis/CFG.h"
+#include "analysis/Dominators.h"
+
+namespace analysis {
+
+/// Loop - A natural loop: a header that dominates the blocks of the loop, and
+/// back edges to it from inside the loop. Inner loops are subloops of the
+/// loops that contain them.
+class Loop {
+public:
+  explicit Loop(unsigned Header) : Blocks{Header} {}
+
+  unsigned getHeader() const { return Blocks.front(); }
+
+  /// The innermost loop that contains this one, or null.
+  Loop *getParentLoop() const { return Parent; }
+
+  std::span<Loop *const> getSubLoops() const { return SubLoops; }
+
+  /// The blocks of the loop and of its subloops, header first.
+  std::span<const unsigned> getBlocks() const { return Blocks; }
+
+  /// 1 for an outermost loop.
+  unsigned getLoopDepth() const {
+    unsigned Depth = 1;
+    for (auto *L = Parent; L != nullptr; L = L->Parent)
+      ++Depth;
+    return Depth;
+  }
+
+  bool contains(const Loop *L) const {
+    while (L != nullptr && L != this)
+      L = L->Parent;
+    return L == this;
+  }
+
+private:
+  friend class LoopInfo;
+
+  Loop *Parent = nullptr;
+  std::vector<Loop *> SubLoops;
+  std::vector<unsigned> Blocks;
+};
+
+/// LoopInfo - The natural loops of a function and how they nest. A loop is
+/// found from the back edges to its header, that is the edges to a block from
+/// blocks it dominates, and its body from there by walking predecessors back
+/// to the header. Loops with the same header are one loop. Control flow that
+/// enters a cycle at more than one block is not a natural loop and is not
+/// reported.
+class LoopInfo {
+public:
+  LoopInfo(const CFG &G, const DominatorTree &DT);
+
+  /// The innermost loop that contains block \p N, or null.
+  Loop *getLoopFor(unsigned N) const { return BlockLoops[N]; }
+
+  /// The number of loops that contain block \p N.
+  unsigned getLoopDepth(unsigned N) const {
+    return BlockLoops[N] != nullptr ? BlockLoops[N]->getLoopDepth() : 0;
+  }
+
+  bool isLoopHeader(unsigned N) const {
+    return BlockLoops[N] != nullptr && BlockLoops[N]->getHeader() == N;
+  }
+
+  std::span<Loop *const> getTopLevelLoops() const { return TopLevelLoops; }
+
+  size_t getNumLoops() const { return Loops.size(); }
+
+private:
+  /// Find the blocks of the loop with header \p L that are not in one of its
+  /// subloops, and the outermost of those subloops, from the sources of the
+  /// back edges \p Latches.
+  void discoverAndMapSubloop(Loop *L, std::vector<unsigned> &Latches,
+                             const CFG &G, const DominatorTree &DT);
+
+  /// Fill in the block and subloop lists of the loops.
+  void populate(const CFG &G);
+
+  std::vector<std::unique_ptr<Loop>> Loops;
+  std::vector<Loop *> TopLevelLoops;
+  std::vector<Loop *> BlockLoops;
+};
+
+} // namespace analysis
+
+#endif // !TOY_LANG_ANALYSIS_LOOP_INFO_H
@@ -5,12 +5,13 @@
 
 class AllocaInst : public Instruction {
 public:
-  AllocaInst(std::string Name = "") : Instruction(std::move(Name)) {}
+  AllocaInst(Symbol Name = {}) : Instruction(ValueKind::Alloca, Name) {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Alloca;
+  }
 
-  bool isLValue() override { return true; }
-  bool hasResult() override { return true; }
+  std::span<Use> operands() override { return {}; }
 };
 
 #endif // !TOY_LANG_IR_ALLOCA_H
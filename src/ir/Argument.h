@@ -5,11 +5,11 @@
 
 class Parameter : public Value {
 public:
-  Parameter(std::string Name) : Value(std::move(Name)) {}
+  Parameter(Symbol Name) : Value(ValueKind::Parameter, Name) {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
-
-  bool isLValue() override { return true; }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Parameter;
+  }
 };
 
 #endif // !TOY_LANG_IR_ARGUMENT_H
@@ -1,12 +1,48 @@
 #include "ir/BasicBlock.h"
 
 #include <cassert>
+#include <iterator>
 
-void BasicBlock::append(std::unique_ptr<Instruction> Inst) {
-  AllInsts.emplace_back(std::move(Inst));
+BasicBlock::~BasicBlock() {
+  while (!Insts.empty())
+    erase(&Insts.front());
 }
 
 Instruction *BasicBlock::getLastInst() {
-  assert(!AllInsts.empty() && "Empty BasicBlock");
-  return AllInsts.back().get();
+  assert(!Insts.empty() && "Empty BasicBlock");
+  return &Insts.back();
+}
+
+BasicBlock::iterator BasicBlock::insert(iterator Pos, Instruction *Inst) {
+  assert(Inst->Parent == nullptr && "Instruction is already in a block");
+  Inst->Parent = this;
+  return Insts.insert(Pos, Inst);
+}
+
+void BasicBlock::remove(Instruction *Inst) {
+  assert(Inst->Parent == this && "Instruction is in another block");
+  Insts.remove(Inst);
+  Inst->Parent = nullptr;
+}
+
+BasicBlock::iterator BasicBlock::erase(Instruction *Inst) {
+  auto Next = std::next(getIterator(Inst));
+  remove(Inst);
+  Inst->destroy();
+  return Next;
+}
+
+BasicBlock::iterator BasicBlock::erase(iterator First, iterator Last) {
+  while (First != Last)
+    First = erase(&*First);
+  return Last;
+}
+
+void BasicBlock::splice(iterator Pos, BasicBlock &Dest) {
+  assert(&Dest != this && "Splicing a block into itself");
+  while (Pos != end()) {
+    auto *Inst = &*Pos++;
+    remove(Inst);
+    Dest.append(Inst);
+  }
 }
@@ -1,27 +1,81 @@
 #ifndef TOY_LANG_IR_BASIC_BLOCK_H
 #define TOY_LANG_IR_BASIC_BLOCK_H
 
-#include <vector>
+#include <cassert>
+#include <cstddef>
 
 #include "ir/Instruction.h"
 #include "ir/Value.h"
+#include "support/IntrusiveList.h"
 
-class BasicBlock : public Value {
+class Function;
+
+/// BasicBlock - A run of instructions on an intrusive list. The instructions
+/// are allocated in the arena of the function, but the block destroys those
+/// still on it when it is destroyed.
+class BasicBlock : public Value, public IntrusiveListNode<BasicBlock> {
 public:
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  BasicBlock() : Value(ValueKind::BasicBlock) {}
+  ~BasicBlock() override;
+
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::BasicBlock;
+  }
+
+  using iterator = IntrusiveList<Instruction>::iterator;
 
-  bool isLValue() override { return false; }
+  /// The function the block is laid out in.
+  Function *getParent() const { return Parent; }
 
-  void append(std::unique_ptr<Instruction> Inst);
+  void append(Instruction *Inst) { insert(end(), Inst); }
   Instruction *getLastInst();
 
-  auto begin() { return AllInsts.begin(); }
-  auto end() { return AllInsts.end(); }
+  /// Link \p Inst, which must be on no block, in before \p Pos.
+  iterator insert(iterator Pos, Instruction *Inst);
+
+  /// Unlink \p Inst, which is kept alive to be inserted again or destroyed.
+  void remove(Instruction *Inst);
+
+  /// Unlink and destroy \p Inst, and return the position after it.
+  iterator erase(Instruction *Inst);
+
+  /// Destroy the instructions in [\p First, \p Last).
+  iterator erase(iterator First, iterator Last);
+
+  /// Move the instructions from \p Pos to the end onto the end of \p Dest.
+  void splice(iterator Pos, BasicBlock &Dest);
+
+  /// Destroy the instructions that \p Pred holds for, and return how many
+  /// there were.
+  template <typename PredT> size_t eraseIf(PredT Pred) {
+    size_t Erased = 0;
+    for (auto It = begin(); It != end();) {
+      if (Pred(*It)) {
+        It = erase(&*It);
+        ++Erased;
+      } else {
+        ++It;
+      }
+    }
+    return Erased;
+  }
+
+  /// The position of \p Inst, which must be in this block.
+  iterator getIterator(Instruction *Inst) const {
+    assert(Inst->getParent() == this && "Instruction is in another block");
+    return Insts.getIterator(Inst);
+  }
+
+  iterator begin() const { return Insts.begin(); }
+  iterator end() const { return Insts.end(); }
+  size_t size() const { return Insts.size(); }
+  bool empty() const { return Insts.empty(); }
 
 private:
-  // TODO: Use Use/Def Chain to track Preds. Use Terminator to track Succs.
+  friend class Function;
 
-  std::vector<std::unique_ptr<Instruction>> AllInsts;
+  IntrusiveList<Instruction> Insts;
+  Function *Parent = nullptr;
 };
 
 #endif // !TOY_LANG_IR_BASIC_BLOCK_H
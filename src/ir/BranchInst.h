@@ -1,23 +1,34 @@
 #ifndef TOY_LANG_IR_BRANCH_INST_H
 #define TOY_LANG_IR_BRANCH_INST_H
 
+#include <array>
+#include <span>
+
 #include "ir/BasicBlock.h"
 #include "ir/Instruction.h"
 
 class BranchInst : public Instruction {
 public:
-  BranchInst(std::string Name = "") : Instruction(std::move(Name)) {}
+  BranchInst(ValueKind Kind, Symbol Name = {}) : Instruction(Kind, Name) {}
 
-  bool isTerminator() override { return true; }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Jump ||
+           V->getKind() == ValueKind::CJump;
+  }
 };
 
 class JumpInst : public BranchInst {
 public:
-  JumpInst(BasicBlock *Dest, std::string Name = "")
-      : BranchInst(std::move(Name)),
+  JumpInst(BasicBlock *Dest, Symbol Name = {})
+      : BranchInst(ValueKind::Jump, Name),
         Dest(Dest) {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Jump;
+  }
+
+  std::span<Use> operands() override { return {}; }
+  std::span<BasicBlock *const> successors() override { return {&Dest, 1}; }
 
   BasicBlock *getDest() { return Dest; }
 
@@ -28,22 +39,25 @@ private:
 class CJumpInst : public BranchInst {
 public:
   CJumpInst(Value *Cond, BasicBlock *IfTrue, BasicBlock *IfElse,
-            std::string Name = "")
-      : BranchInst(std::move(Name)),
-        Cond(Cond),
-        IfTrue(IfTrue),
-        IfElse(IfElse) {}
+            Symbol Name = {})
+      : BranchInst(ValueKind::CJump, Name),
+        Cond(Cond, this),
+        Targets{IfTrue, IfElse} {}
+
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::CJump;
+  }
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  std::span<Use> operands() override { return {&Cond, 1}; }
+  std::span<BasicBlock *const> successors() override { return Targets; }
 
   Value *getCond() { return Cond; }
-  BasicBlock *getTrueBB() { return IfTrue; }
-  BasicBlock *getFalseBB() { return IfElse; }
+  BasicBlock *getTrueBB() { return Targets[0]; }
+  BasicBlock *getFalseBB() { return Targets[1]; }
 
 private:
-  Value *Cond;
-  BasicBlock *IfTrue;
-  BasicBlock *IfElse;
+  Use Cond;
+  std::array<BasicBlock *, 2> Targets;
 };
 
 #endif // !TOY_LANG_IR_BRANCH_INST_H
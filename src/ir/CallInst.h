@@ -1,27 +1,34 @@
 #ifndef TOY_LANG_IR_CALL_INST_H
 #define TOY_LANG_IR_CALL_INST_H
 
+#include <span>
+#include <vector>
+
 #include "ir/Function.h"
 #include "ir/Instruction.h"
 
 class CallInst : public Instruction {
 public:
-  CallInst(Function *Callee, std::vector<Value *> Arguments,
-           std::string Name = "")
-      : Instruction(std::move(Name)),
-        Callee(Callee),
-        Arguments(Arguments) {}
+  CallInst(Function *Callee, std::vector<Value *> Arguments, Symbol Name = {})
+      : Instruction(ValueKind::Call, Name),
+        Callee(Callee) {
+    this->Arguments.reserve(Arguments.size());
+    for (auto *Arg : Arguments)
+      this->Arguments.emplace_back(Arg, this);
+  }
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Call;
+  }
 
-  bool hasResult() override { return true; }
+  std::span<Use> operands() override { return Arguments; }
 
   Function *getCallee() { return Callee; }
-  std::vector<Value *> &getArguments() { return Arguments; }
+  std::span<Use> getArguments() { return Arguments; }
 
 private:
   Function *Callee;
-  std::vector<Value *> Arguments;
+  std::vector<Use> Arguments;
 };
 
 #endif // !TOY_LANG_IR_CALL_INST_H
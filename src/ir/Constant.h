@@ -7,9 +7,11 @@
 
 class Constant : public Value {
 public:
-  Constant(int64_t Val) : Val(Val) {}
+  Constant(int64_t Val) : Value(ValueKind::Constant), Val(Val) {}
 
-  void accept(IRVisitor &V) { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Constant;
+  }
 
   int64_t getVal() const { return Val; }
 
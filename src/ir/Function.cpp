@@ -1,9 +1,7 @@
 #include "ir/Function.h"
 
-#include <algorithm>
 #include <cassert>
-
-#include "fmt/format.h"
+#include <iterator>
 
 #include "ir/AllocaInst.h"
 #include "ir/Argument.h"
@@ -12,35 +10,93 @@
 #include "ir/CallInst.h"
 #include "ir/Constant.h"
 #include "ir/Instruction.h"
+#include "ir/PhiInst.h"
 
-Function::Function(std::string Name, const std::vector<std::string> &Params)
-    : Name(std::move(Name)) {
+Function::Function(Symbol Name, const std::vector<Symbol> &Params)
+    : Name(Name) {
   Arguments.reserve(Params.size());
-  for (const auto &Param : Params)
-    Arguments.push_back(makeValue<Parameter>(Param));
+  for (auto Param : Params) {
+    Arguments.push_back(std::make_unique<Parameter>(Param));
+    Arguments.back()->ID = NextValueID++;
+  }
 
   // DO NOT create EntryBlock now, because it can be a external linkage
   // function.
 }
 
+Function::~Function() { destroyBody(); }
+
+void Function::destroyBody() {
+  while (!AllBlocks.empty())
+    eraseBlock(&AllBlocks.front());
+  for (auto *C : AllConstants)
+    C->~Constant();
+  // Swap with empty containers so that their capacity is released as well.
+  std::vector<Constant *>().swap(AllConstants);
+  std::unordered_map<int64_t, Constant *>().swap(ConstantPool);
+  Body = Arena(BodySlabSize, BodySlabGrowthDelay);
+}
+
+void Function::releaseBody() {
+  InsertPoint = nullptr;
+  destroyBody();
+  // A body made later, such as a definition replacing an imported body,
+  // is numbered afresh after the parameters.
+  NextValueID = static_cast<unsigned>(Arguments.size());
+  NextBlockID = 0;
+}
+
+size_t Function::getInstructionCount() const {
+  size_t Count = 0;
+  for (const auto &BB : AllBlocks)
+    Count += BB.size();
+  return Count;
+}
+
 void Function::setInsertPoint(BasicBlock *B) {
-  assert(std::find_if(AllBlocks.begin(), AllBlocks.end(),
-                      [B](const auto &Ptr) { return B == Ptr.get(); }) !=
-             AllBlocks.end() &&
+  assert(B->getParent() == this &&
          "Given BasicBlock does not belong to this Function");
 
   InsertPoint = B;
 }
 
 BasicBlock *Function::makeNewBlock() {
-  AllBlocks.push_back(makeValue<BasicBlock>());
-  auto *Ret = AllBlocks.back().get();
-  if (Ret->getName().empty())
-    Ret->assignName(fmt::format("BB_{}", NextBBID++));
+  auto *Ret = makeValue<BasicBlock>();
+  Ret->Parent = this;
+  AllBlocks.push_back(Ret);
+  return Ret;
+}
+
+BasicBlock *Function::makeNewBlockAfter(BasicBlock *Pos) {
+  assert(Pos->getParent() == this &&
+         "Given BasicBlock does not belong to this Function");
+
+  auto *Ret = makeValue<BasicBlock>();
+  Ret->Parent = this;
+  AllBlocks.insert(std::next(AllBlocks.getIterator(Pos)), Ret);
   return Ret;
 }
 
+void Function::eraseBlock(BasicBlock *BB) {
+  assert(BB->getParent() == this &&
+         "Given BasicBlock does not belong to this Function");
+  if (InsertPoint == BB)
+    InsertPoint = nullptr;
+  AllBlocks.remove(BB);
+  BB->~BasicBlock();
+}
+
 Constant *Function::makeConstant(int64_t Val) {
-  AllConstants.push_back(makeValue<Constant>(Val));
-  return AllConstants.back().get();
+  auto [It, Inserted] = ConstantPool.try_emplace(Val, nullptr);
+  if (Inserted) {
+    AllConstants.push_back(makeValue<Constant>(Val));
+    It->second = AllConstants.back();
+  }
+  return It->second;
+}
+
+PhiInst *Function::makePhi(BasicBlock *BB) {
+  auto *Phi = makeValue<PhiInst>();
+  BB->insert(BB->begin(), Phi);
+  return Phi;
 }
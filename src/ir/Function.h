@@ -2,77 +2,136 @@
 #define TOY_LANG_IR_FUNCTION_H
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "ir/Argument.h"
 #include "ir/BasicBlock.h"
 #include "ir/Constant.h"
-#include "ir/IRVisitor.h"
 #include "ir/Instruction.h"
 #include "ir/Value.h"
+#include "support/Arena.h"
+#include "support/IntrusiveList.h"
+#include "support/Symbol.h"
 
+class PhiInst;
+
+/// Function - A signature, and maybe a body. The blocks, instructions and
+/// constants of the body are allocated in an arena of the function, and go
+/// away together when the body is released.
 class Function {
 public:
   /// We support only 1 type yet, so there is no need to passing a vector.
-  Function(std::string Name, const std::vector<std::string> &Params);
-
-  void accept(IRVisitor &V) { V.visit(*this); }
+  Function(Symbol Name, const std::vector<Symbol> &Params);
+  ~Function();
 
   bool hasReturnValue();
-  std::string &getName() { return Name; }
+  Symbol getName() const { return Name; }
   std::vector<std::unique_ptr<Parameter>> &getArgs() { return Arguments; }
 
   BasicBlock *makeEntryBlock() {
     assert(AllBlocks.empty() && "EntryBlock exists");
-    makeNewBlock();
-    return AllBlocks.front().get();
+    return makeNewBlock();
   }
 
   BasicBlock *getEntryBlock() const {
     if (AllBlocks.empty())
       return nullptr;
 
-    return AllBlocks.front().get();
+    return &AllBlocks.front();
   }
 
-  std::vector<std::unique_ptr<BasicBlock>> &getBlocks() { return AllBlocks; }
-  std::vector<std::unique_ptr<Constant>> &getConstants() {
-    return AllConstants;
-  }
+  /// The blocks in layout order.
+  IntrusiveList<BasicBlock> &getBlocks() { return AllBlocks; }
+  std::span<Constant *const> getConstants() const { return AllConstants; }
+
+  /// Free the body once it has been lowered. Only the signature is kept, so
+  /// the function still resolves calls but looks like an external one.
+  void releaseBody();
+
+  /// An available-externally function has a copy of a body that is defined
+  /// in another module, read from that module's summary. The optimizer may
+  /// inline or evaluate it, but no code is emitted for it.
+  bool isAvailableExternally() const { return AvailableExternally; }
+  void setAvailableExternally(bool Value) { AvailableExternally = Value; }
+
+  /// A pure function has no effect other than its return value, and the
+  /// bodies of everything it calls are known.
+  bool isPure() const { return Pure; }
+  void setPure(bool Value) { Pure = Value; }
+
+  /// Number of instructions in the body.
+  size_t getInstructionCount() const;
+
+  /// Bounds on the IDs of the values and of the blocks of the function, for
+  /// sizing side tables. IDs are handed out in order and never reused, so
+  /// erased values leave gaps.
+  unsigned getNumValueIDs() const { return NextValueID; }
+  unsigned getNumBlockIDs() const { return NextBlockID; }
 
   void setInsertPoint(BasicBlock *B);
   BasicBlock *getCurrInsertPoint() const { return InsertPoint; }
 
   BasicBlock *makeNewBlock();
+  /// Make a block that is laid out right after \p Pos.
+  BasicBlock *makeNewBlockAfter(BasicBlock *Pos);
+  /// Unlink \p BB and destroy it together with its instructions.
+  void eraseBlock(BasicBlock *BB);
+  /// Return the Constant for \p Val. There is one per distinct value, so
+  /// constants are equal exactly when they are the same object.
   Constant *makeConstant(int64_t Val);
 
+  /// Make a phi without incoming values at the top of \p BB.
+  PhiInst *makePhi(BasicBlock *BB);
+
   template <typename T, typename... ArgTs>
   Instruction *emit(ArgTs &&...Args) {
-    auto Inst = makeValue<T>(std::forward<ArgTs>(Args)...);
-    auto *Ret = Inst.get();
-    InsertPoint->append(std::move(Inst));
-
-    if (Ret->hasResult() && Ret->getName().empty())
-      Ret->assignNameByNumber(NextValueID++);
-
+    auto *Ret = makeValue<T>(std::forward<ArgTs>(Args)...);
+    InsertPoint->append(Ret);
     return Ret;
   }
 
 private:
-  template <typename T, typename... Ts>
-  std::unique_ptr<T> makeValue(Ts &&...Args) {
-    return std::make_unique<T>(std::forward<Ts>(Args)...);
+  /// Allocate a value of the body in the arena and give it the next ID. It
+  /// is destroyed explicitly, since the arena never runs destructors.
+  template <typename T, typename... Ts> T *makeValue(Ts &&...Args) {
+    auto *V = new (Body.allocate(sizeof(T), alignof(T)))
+        T(std::forward<Ts>(Args)...);
+    if constexpr (std::is_same_v<T, BasicBlock>)
+      V->ID = NextBlockID++;
+    else
+      V->ID = NextValueID++;
+    return V;
   }
 
+  /// Destroy every value of the body and free their memory at once.
+  void destroyBody();
+
+  /// Most functions are small, and a module can have a great many of them,
+  /// so their arenas grow slowly.
+  static constexpr size_t BodySlabSize = 1024;
+  static constexpr unsigned BodySlabGrowthDelay = 4;
+
 private:
-  std::string Name;
+  Symbol Name;
+  /// The parameters outlive the body, so they are not in the arena.
   std::vector<std::unique_ptr<Parameter>> Arguments;
-  std::vector<std::unique_ptr<BasicBlock>> AllBlocks;
-  std::vector<std::unique_ptr<Constant>> AllConstants;
+  Arena Body{BodySlabSize, BodySlabGrowthDelay};
+  IntrusiveList<BasicBlock> AllBlocks;
+  /// The constants in the order they were first asked for, and an index of
+  /// them by value.
+  std::vector<Constant *> AllConstants;
+  std::unordered_map<int64_t, Constant *> ConstantPool;
   BasicBlock *InsertPoint = nullptr;
-  size_t NextValueID = 0;
-  size_t NextBBID = 0;
+  unsigned NextValueID = 0;
+  unsigned NextBlockID = 0;
+  bool AvailableExternally = false;
+  bool Pure = false;
 };
 
 #endif // !TOY_LANG_IR_FUNCTION_H
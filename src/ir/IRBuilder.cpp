@@ -0,0 +1,85 @@
+#include "ir/IRBuilder.h"
+
+#include <utility>
+
+Value *IRBuilder::simplify(ArithmeticInst::Opcode Opc, Value *LHS,
+                           Value *RHS) {
+  using Opcode = ArithmeticInst::Opcode;
+
+  auto *LHSC = dyn_cast<Constant>(LHS);
+  auto *RHSC = dyn_cast<Constant>(RHS);
+
+  if (LHSC != nullptr && RHSC != nullptr) {
+    // Wrap around like the machine does.
+    auto L = static_cast<uint64_t>(LHSC->getVal());
+    auto R = static_cast<uint64_t>(RHSC->getVal());
+    switch (Opc) {
+    case Opcode::Add: return getConstant(static_cast<int64_t>(L + R));
+    case Opcode::Sub: return getConstant(static_cast<int64_t>(L - R));
+    case Opcode::Mul: return getConstant(static_cast<int64_t>(L * R));
+    }
+  }
+
+  auto Is = [](Constant *C, int64_t Val) {
+    return C != nullptr && C->getVal() == Val;
+  };
+
+  switch (Opc) {
+  case Opcode::Add:
+    if (Is(RHSC, 0))
+      return LHS;
+    if (Is(LHSC, 0))
+      return RHS;
+    break;
+  case Opcode::Sub:
+    if (Is(RHSC, 0))
+      return LHS;
+    if (LHS == RHS)
+      return getConstant(0);
+    break;
+  case Opcode::Mul:
+    if (Is(RHSC, 1))
+      return LHS;
+    if (Is(LHSC, 1))
+      return RHS;
+    if (Is(RHSC, 0) || Is(LHSC, 0))
+      return getConstant(0);
+    break;
+  }
+  return nullptr;
+}
+
+Value *IRBuilder::createArithmetic(ArithmeticInst::Opcode Opc, Value *LHS,
+                                   Value *RHS) {
+  if (auto *Simplified = simplify(Opc, LHS, RHS))
+    return Simplified;
+
+  if (auto *BB = Fn.getCurrInsertPoint(); BB != ValueBlock) {
+    Values.clear();
+    ValueBlock = BB;
+  }
+
+  // The operands of a commutative operation are looked up in a fixed order.
+  // The instruction itself keeps them as written.
+  Key K{Opc, LHS, RHS};
+  if (Opc != ArithmeticInst::Opcode::Sub && std::less<>()(RHS, LHS))
+    std::swap(K.LHS, K.RHS);
+
+  auto [It, Inserted] = Values.try_emplace(K, nullptr);
+  if (Inserted)
+    It->second = Fn.emit<ArithmeticInst>(Opc, LHS, RHS);
+  return It->second;
+}
+
+Value *IRBuilder::createCompare(CompareInst::Predicate Pred, Value *LHS,
+                                Value *RHS) {
+  auto *LHSC = dyn_cast<Constant>(LHS);
+  auto *RHSC = dyn_cast<Constant>(RHS);
+  if (LHSC != nullptr && RHSC != nullptr)
+    return getConstant(
+        CompareInst::evaluate(Pred, LHSC->getVal(), RHSC->getVal()));
+  // A value is equal to itself.
+  if (LHS == RHS)
+    return getConstant(CompareInst::evaluate(Pred, 0, 0));
+  return Fn.emit<CompareInst>(Pred, LHS, RHS);
+}
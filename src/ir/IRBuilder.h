@@ -0,0 +1,57 @@
+#ifndef TOY_LANG_IR_IR_BUILDER_H
+#define TOY_LANG_IR_IR_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "ir/BasicBlock.h"
+#include "ir/Constant.h"
+#include "ir/Function.h"
+#include "ir/Instruction.h"
+#include "ir/Value.h"
+
+/// IRBuilder - Emits arithmetic at the insert point of a function, but only
+/// when it has to. An instruction over constants is folded to a constant, one
+/// that an identity such as x+0, x*1 or x*0 makes redundant is replaced by its
+/// result, and one that repeats an instruction emitted earlier in the same
+/// block reuses that instruction's result. Comparisons are only folded.
+class IRBuilder {
+public:
+  IRBuilder(Function &Fn) : Fn(Fn) {}
+
+  Constant *getConstant(int64_t Val) { return Fn.makeConstant(Val); }
+
+  Value *createArithmetic(ArithmeticInst::Opcode Opc, Value *LHS, Value *RHS);
+  Value *createCompare(CompareInst::Predicate Pred, Value *LHS, Value *RHS);
+
+private:
+  /// The result of \p Opc on \p LHS and \p RHS if it is known without
+  /// emitting anything, or null.
+  Value *simplify(ArithmeticInst::Opcode Opc, Value *LHS, Value *RHS);
+
+  struct Key {
+    ArithmeticInst::Opcode Opc;
+    Value *LHS, *RHS;
+
+    friend bool operator==(const Key &, const Key &) = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &K) const {
+      auto H = std::hash<Value *>();
+      return (H(K.LHS) * 31 + H(K.RHS)) * 31 + static_cast<size_t>(K.Opc);
+    }
+  };
+
+  Function &Fn;
+
+  /// The instructions emitted into ValueBlock so far. The table only ever
+  /// describes the block being emitted into, since an instruction in another
+  /// block need not have been executed.
+  std::unordered_map<Key, Value *, KeyHash> Values;
+  BasicBlock *ValueBlock = nullptr;
+};
+
+#endif // !TOY_LANG_IR_IR_BUILDER_H
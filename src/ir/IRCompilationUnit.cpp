@@ -1,19 +1,24 @@
 #include "IRCompilationUnit.h"
+
+#include <mutex>
+
 #include "ir/Function.h"
 
-Function *IRCompilationUnit::lookupFunction(const std::string &Name) {
+Function *IRCompilationUnit::lookupFunction(Symbol Name) {
+  std::shared_lock Lock(Mutex);
   auto Iter = FunctionTable.find(Name);
   return (Iter == FunctionTable.end()) ? nullptr : Iter->second;
 }
 
 Function *
-IRCompilationUnit::makeNewFunction(std::string Name,
-                                   const std::vector<std::string> &Params) {
+IRCompilationUnit::makeNewFunction(Symbol Name,
+                                   const std::vector<Symbol> &Params) {
+  std::unique_lock Lock(Mutex);
   auto [Iter, success] = FunctionTable.emplace(Name, nullptr);
   if (!success)
     return nullptr;
 
-  auto NewFn = std::make_unique<Function>(std::move(Name), Params);
+  auto NewFn = std::make_unique<Function>(Name, Params);
 
   Iter->second = NewFn.get();
   AllFunctions.emplace_back(std::move(NewFn));
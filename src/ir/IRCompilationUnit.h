@@ -3,24 +3,27 @@
 
 #include <map>
 #include <memory>
+#include <shared_mutex>
+#include <vector>
 
 #include "ir/Function.h"
-#include "ir/IRVisitor.h"
+#include "support/Symbol.h"
 
+/// IRCompilationUnit - The functions of a module, in the order they were
+/// first declared. Looking functions up and adding them is safe from several
+/// threads at once; iterating over them is not, while any are being added.
 class IRCompilationUnit {
 public:
-  void accept(IRVisitor &V) { V.visit(*this); }
-
   auto begin() const { return AllFunctions.begin(); }
   auto end() const { return AllFunctions.end(); }
 
-  Function *lookupFunction(const std::string &Name);
-  Function *makeNewFunction(std::string Name,
-                            const std::vector<std::string> &Params);
+  Function *lookupFunction(Symbol Name);
+  Function *makeNewFunction(Symbol Name, const std::vector<Symbol> &Params);
 
 private:
   std::vector<std::unique_ptr<Function>> AllFunctions;
-  std::map<std::string, Function *> FunctionTable;
+  std::map<Symbol, Function *> FunctionTable;
+  std::shared_mutex Mutex;
 };
 
 #endif // !TOY_LANG_IR_COMILATION_UNIT_H
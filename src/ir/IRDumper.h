@@ -1,6 +1,9 @@
 #ifndef TOY_LANG_IR_IR_DUMPER_H
 #define TOY_LANG_IR_IR_DUMPER_H
 
+#include <string>
+#include <vector>
+
 #include "fmt/format.h"
 
 #include "ir/AllocaInst.h"
@@ -8,42 +11,61 @@
 #include "ir/CallInst.h"
 #include "ir/IRCompilationUnit.h"
 #include "ir/IRVisitor.h"
+#include "ir/PhiInst.h"
 
-class BriefFormatter : public IRVisitor {
+/// BriefFormatter - Names values as operands. Values keep only the names
+/// they have in the source, so the others are numbered here: blocks by their
+/// IDs, and the instructions of a function in the order they are printed.
+class BriefFormatter {
 public:
   std::string operator()(Value &V) {
-    Result.clear();
-
-    V.accept(*this);
-    if (Result.empty())
-      return std::string(V.getName());
-
-    return std::move(Result);
+    if (auto *C = dyn_cast<Constant>(&V))
+      return fmt::format("${}", C->getVal());
+    if (auto *BB = dyn_cast<BasicBlock>(&V))
+      return fmt::format("BB_{}", BB->getID());
+    if (!V.getName().empty())
+      return std::string(V.getName().str());
+    return fmt::format("%{}", Slots[V.getID()]);
   }
 
-  void visit(Constant &C) { Result = fmt::format("${}", C.getVal()); }
+  /// Number the unnamed results of \p Fn.
+  void numberValues(Function &Fn) {
+    Slots.assign(Fn.getNumValueIDs(), 0);
+    unsigned NextSlot = 0;
+    for (auto &BB : Fn.getBlocks())
+      for (auto &Inst : BB)
+        if (Inst.hasResult() && Inst.getName().empty())
+          Slots[Inst.getID()] = NextSlot++;
+  }
 
 private:
-  std::string Result;
+  /// The number of each unnamed result, indexed by value ID.
+  std::vector<unsigned> Slots;
 };
 
-class IRDumper : public IRVisitor {
+class IRDumper : public IRVisitor<IRDumper> {
 public:
   IRDumper(std::FILE *OS, IRCompilationUnit &IRUnit) : OS(OS) {
-    IRUnit.accept(*this);
+    visit(IRUnit);
   }
 
-  void visit(IRCompilationUnit &IRUnit) override {
+  IRDumper(std::FILE *OS, Function &Fn) : OS(OS) { visit(Fn); }
+
+  using IRVisitor::visit;
+
+  void visit(IRCompilationUnit &IRUnit) {
     for (auto &Fn : IRUnit) {
-      Fn->accept(*this);
+      visit(*Fn);
     }
   }
 
-  void visit(Function &Fn) override {
-    if (Fn.getEntryBlock())
-      fmt::print(OS, "define @{}(", Fn.getName());
-    else
+  void visit(Function &Fn) {
+    if (!Fn.getEntryBlock())
       fmt::print(OS, "extern @{}(", Fn.getName());
+    else if (Fn.isAvailableExternally())
+      fmt::print(OS, "import @{}(", Fn.getName());
+    else
+      fmt::print(OS, "define @{}(", Fn.getName());
 
     for (size_t I = 0; I < Fn.getArgs().size(); ++I) {
       if (I != 0)
@@ -59,33 +81,34 @@ public:
 
     fmt::print(" {{\n");
 
+    Brief.numberValues(Fn);
     for (auto &BB : Fn.getBlocks()) {
-      BB->accept(*this);
+      visit(BB);
     }
     fmt::print("}}\n");
   }
 
-  void visit(BasicBlock &BB) override {
-    fmt::print(OS, "{}:\n", BB.getName());
+  void visit(BasicBlock &BB) {
+    fmt::print(OS, "{}:\n", Brief(BB));
     for (auto &Inst : BB) {
-      Inst->accept(*this);
+      visit(Inst);
     }
   }
 
-  void visit(AllocaInst &Inst) override {
-    fmt::print(OS, "    {} = alloca\n", Inst.getName());
+  void visit(AllocaInst &Inst) {
+    fmt::print(OS, "    {} = alloca\n", Brief(Inst));
   }
 
-  void visit(StoreInst &Inst) override {
+  void visit(StoreInst &Inst) {
     fmt::print(OS, "    store {}, {}\n", Brief(*Inst.getVal()),
                Brief(*Inst.getPtr()));
   }
 
-  void visit(LoadInst &Inst) override {
-    fmt::print(OS, "    {} = load {}\n", Inst.getName(), Brief(*Inst.getPtr()));
+  void visit(LoadInst &Inst) {
+    fmt::print(OS, "    {} = load {}\n", Brief(Inst), Brief(*Inst.getPtr()));
   }
 
-  void visit(ArithmeticInst &Inst) override {
+  void visit(ArithmeticInst &Inst) {
     std::string_view Opc;
     switch (Inst.getOpc()) {
     case ArithmeticInst::Opcode::Add: Opc = "add"; break;
@@ -93,21 +116,40 @@ public:
     case ArithmeticInst::Opcode::Mul: Opc = "mul"; break;
     }
 
-    fmt::print(OS, "    {} = {} {}, {}\n", Inst.getName(), Opc,
+    fmt::print(OS, "    {} = {} {}, {}\n", Brief(Inst), Opc,
                Brief(*Inst.getLHS()), Brief(*Inst.getRHS()));
   }
 
-  void visit(JumpInst &Inst) override {
+  void visit(CompareInst &Inst) {
+    std::string_view Pred;
+    switch (Inst.getPred()) {
+    case CompareInst::Predicate::EQ: Pred = "eq"; break;
+    case CompareInst::Predicate::NE: Pred = "ne"; break;
+    case CompareInst::Predicate::SLT: Pred = "slt"; break;
+    case CompareInst::Predicate::SLE: Pred = "sle"; break;
+    case CompareInst::Predicate::SGT: Pred = "sgt"; break;
+    case CompareInst::Predicate::SGE: Pred = "sge"; break;
+    case CompareInst::Predicate::ULT: Pred = "ult"; break;
+    case CompareInst::Predicate::ULE: Pred = "ule"; break;
+    case CompareInst::Predicate::UGT: Pred = "ugt"; break;
+    case CompareInst::Predicate::UGE: Pred = "uge"; break;
+    }
+
+    fmt::print(OS, "    {} = cmp {} {}, {}\n", Brief(Inst), Pred,
+               Brief(*Inst.getLHS()), Brief(*Inst.getRHS()));
+  }
+
+  void visit(JumpInst &Inst) {
     fmt::print(OS, "    jump {}\n", Brief(*Inst.getDest()));
   }
 
-  void visit(CJumpInst &Inst) override {
+  void visit(CJumpInst &Inst) {
     fmt::print(OS, "    cjump {}, {}, {}\n", Brief(*Inst.getCond()),
                Brief(*Inst.getTrueBB()), Brief(*Inst.getFalseBB()));
   }
 
-  void visit(CallInst &Inst) override {
-    fmt::print(OS, "    {} = call @{}(", Inst.getName(),
+  void visit(CallInst &Inst) {
+    fmt::print(OS, "    {} = call @{}(", Brief(Inst),
                Inst.getCallee()->getName());
     for (size_t I = 0; I < Inst.getArguments().size(); ++I) {
       if (I != 0)
@@ -117,7 +159,16 @@ public:
     fmt::print(OS, ")\n");
   }
 
-  void visit(ReturnInst &Inst) override {
+  void visit(PhiInst &Inst) {
+    fmt::print(OS, "    {} = phi", Brief(Inst));
+    for (size_t I = 0; I < Inst.getNumIncoming(); ++I)
+      fmt::print(OS, "{} [{}, {}]", I == 0 ? "" : ",",
+                 Brief(*Inst.getIncomingValue(I)),
+                 Brief(*Inst.getIncomingBlock(I)));
+    fmt::print(OS, "\n");
+  }
+
+  void visit(ReturnInst &Inst) {
     fmt::print(OS, "    return");
     if (auto *Val = Inst.getVal())
       fmt::print(OS, " {}", Brief(*Val));
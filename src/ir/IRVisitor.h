@@ -1,39 +1,61 @@
 #ifndef TOY_LANG_IR_IR_VISITOR_H
 #define TOY_LANG_IR_IR_VISITOR_H
 
-class IRCompilationUnit;
-class Function;
-class Parameter;
-class BasicBlock;
-class Constant;
+#include <cassert>
 
-class AllocaInst;
-class StoreInst;
-class LoadInst;
-class ArithmeticInst;
-class JumpInst;
-class CJumpInst;
-class CallInst;
-class ReturnInst;
+#include "ir/AllocaInst.h"
+#include "ir/Argument.h"
+#include "ir/BasicBlock.h"
+#include "ir/BranchInst.h"
+#include "ir/CallInst.h"
+#include "ir/Constant.h"
+#include "ir/Instruction.h"
+#include "ir/PhiInst.h"
+#include "ir/Value.h"
 
-class IRVisitor {
+/// IRVisitor - Calls the visit() overload of SubClass for the kind of a
+/// value. The dispatch is a switch on the kind, so the overloads are called
+/// directly and may be inlined. A subclass overrides the overloads it cares
+/// about, and brings the others in with `using IRVisitor::visit;`; those do
+/// nothing and return RetT().
+template <typename SubClass, typename RetT = void> class IRVisitor {
 public:
-  virtual ~IRVisitor() = default;
+  RetT visit(Value &V) {
+    auto &Self = static_cast<SubClass &>(*this);
+    switch (V.getKind()) {
+    case ValueKind::Parameter: return Self.visit(cast<Parameter>(V));
+    case ValueKind::Constant: return Self.visit(cast<Constant>(V));
+    case ValueKind::BasicBlock: return Self.visit(cast<BasicBlock>(V));
+    case ValueKind::Alloca: return Self.visit(cast<AllocaInst>(V));
+    case ValueKind::Store: return Self.visit(cast<StoreInst>(V));
+    case ValueKind::Load: return Self.visit(cast<LoadInst>(V));
+    case ValueKind::Arithmetic: return Self.visit(cast<ArithmeticInst>(V));
+    case ValueKind::Compare: return Self.visit(cast<CompareInst>(V));
+    case ValueKind::Call: return Self.visit(cast<CallInst>(V));
+    case ValueKind::Phi: return Self.visit(cast<PhiInst>(V));
+    case ValueKind::Jump: return Self.visit(cast<JumpInst>(V));
+    case ValueKind::CJump: return Self.visit(cast<CJumpInst>(V));
+    case ValueKind::Return: return Self.visit(cast<ReturnInst>(V));
+    case ValueKind::Variable: break;
+    }
+    assert(false && "Visiting a value that is not part of the IR");
+    return RetT();
+  }
 
-  virtual void visit(IRCompilationUnit & /* IRUnit */) {}
-  virtual void visit(Function & /* Fn */) {}
-  virtual void visit(Parameter & /* Param */) {}
-  virtual void visit(BasicBlock & /* BB */) {}
-  virtual void visit(Constant & /* Inst */) {}
+  RetT visit(Parameter & /* Param */) { return RetT(); }
+  RetT visit(Constant & /* C */) { return RetT(); }
+  RetT visit(BasicBlock & /* BB */) { return RetT(); }
 
-  virtual void visit(AllocaInst & /* Inst */) {}
-  virtual void visit(StoreInst & /* Inst */) {}
-  virtual void visit(LoadInst & /* Inst */) {}
-  virtual void visit(ArithmeticInst & /* Inst */) {}
-  virtual void visit(JumpInst & /* Inst */) {}
-  virtual void visit(CJumpInst & /* Inst */) {}
-  virtual void visit(CallInst & /* Inst */) {}
-  virtual void visit(ReturnInst & /* Inst */) {}
+  RetT visit(AllocaInst & /* Inst */) { return RetT(); }
+  RetT visit(StoreInst & /* Inst */) { return RetT(); }
+  RetT visit(LoadInst & /* Inst */) { return RetT(); }
+  RetT visit(ArithmeticInst & /* Inst */) { return RetT(); }
+  RetT visit(CompareInst & /* Inst */) { return RetT(); }
+  RetT visit(CallInst & /* Inst */) { return RetT(); }
+  RetT visit(PhiInst & /* Inst */) { return RetT(); }
+  RetT visit(JumpInst & /* Inst */) { return RetT(); }
+  RetT visit(CJumpInst & /* Inst */) { return RetT(); }
+  RetT visit(ReturnInst & /* Inst */) { return RetT(); }
 };
 
 #endif // !TOY_LANG_IR_IR_VISITOR_H
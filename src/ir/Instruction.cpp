@@ -0,0 +1,14 @@
+#include "ir/Instruction.h"
+
+#include <cassert>
+
+#include "ir/BasicBlock.h"
+
+void Instruction::removeFromParent() { Parent->remove(this); }
+
+void Instruction::eraseFromParent() { Parent->erase(this); }
+
+void Instruction::destroy() {
+  assert(Parent == nullptr && "Destroying an instruction in a block");
+  this->~Instruction();
+}
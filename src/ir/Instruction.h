@@ -2,45 +2,127 @@
 #define TOY_LANG_IR_INSTRUCTION_H
 
 #include <array>
+#include <cstdint>
+#include <span>
 
+#include "ir/Use.h"
 #include "ir/Value.h"
+#include "support/IntrusiveList.h"
 
-class Instruction : public Value {
+class BasicBlock;
+
+/// Instruction - A value computed by one step of a block. Instructions are
+/// allocated in the arena of their function, and are on the instruction list
+/// of at most one block.
+class Instruction : public Value, public IntrusiveListNode<Instruction> {
 public:
-  Instruction(std::string Name = "") : Value(std::move(Name)) {}
+  Instruction(ValueKind Kind, Symbol Name = {}) : Value(Kind, Name) {}
+
+  static bool classof(const Value *V) {
+    return V->getKind() >= ValueKind::FirstInst &&
+           V->getKind() <= ValueKind::LastInst;
+  }
+
+  /// The block the instruction is in, or null if it is in none.
+  BasicBlock *getParent() const { return Parent; }
+
+  /// Unlink the instruction from its block, keeping it alive.
+  void removeFromParent();
+
+  /// Unlink the instruction from its block and destroy it.
+  void eraseFromParent();
+
+  /// Destroy an instruction that is in no block. Its memory belongs to the
+  /// arena of the function and is freed with the rest of the body.
+  void destroy();
+
+  /// Whether the instruction ends its block. Only the first terminator of a
+  /// block is ever reached.
+  bool isTerminator() const {
+    return getKind() >= ValueKind::FirstTerminator;
+  }
+
+  /// Whether the instruction computes a value that others may use.
+  bool hasResult() const {
+    switch (getKind()) {
+    case ValueKind::Alloca:
+    case ValueKind::Load:
+    case ValueKind::Arithmetic:
+    case ValueKind::Compare:
+    case ValueKind::Call:
+    case ValueKind::Phi: return true;
+    default: return false;
+    }
+  }
 
-  virtual void accept(IRVisitor &V) = 0;
+  /// Whether running the instruction matters beyond its result, so that it
+  /// has to stay even if the result is unused. Even a pure callee might not
+  /// return.
+  bool mayHaveSideEffects() const {
+    return isTerminator() || getKind() == ValueKind::Store ||
+           getKind() == ValueKind::Call;
+  }
+
+  /// The values this instruction uses. Branch targets are not included.
+  virtual std::span<Use> operands() = 0;
+
+  /// The blocks a terminator may branch to.
+  virtual std::span<BasicBlock *const> successors() { return {}; }
+
+  /// Make every operand that is \p From refer to \p To instead.
+  void replaceUsesOfWith(Value *From, Value *To) {
+    for (auto &Operand : operands())
+      if (Operand == From)
+        Operand = To;
+  }
+
+  /// Stop using any value, as when the instruction is removed for good.
+  void dropAllReferences() {
+    for (auto &Operand : operands())
+      Operand = nullptr;
+  }
+
+private:
+  friend class BasicBlock;
+
+  BasicBlock *Parent = nullptr;
 };
 
 class StoreInst : public Instruction {
 public:
-  StoreInst(Value *Ptr, Value *Val, std::string Name = "")
-      : Instruction(std::move(Name)),
-        Ptr(Ptr),
-        Val(Val) {}
+  StoreInst(Value *Ptr, Value *Val, Symbol Name = {})
+      : Instruction(ValueKind::Store, Name),
+        Operands{Use(Ptr, this), Use(Val, this)} {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Store;
+  }
 
-  Value *getPtr() { return Ptr; }
-  Value *getVal() { return Val; }
+  std::span<Use> operands() override { return Operands; }
+
+  Value *getPtr() { return Operands[0]; }
+  Value *getVal() { return Operands[1]; }
 
 private:
-  Value *Ptr;
-  Value *Val;
+  std::array<Use, 2> Operands;
 };
 
 class LoadInst : public Instruction {
 public:
-  LoadInst(Value *Ptr, std::string Name = "") : Instruction(Name), Ptr(Ptr) {}
+  LoadInst(Value *Ptr, Symbol Name = {})
+      : Instruction(ValueKind::Load, Name),
+        Ptr(Ptr, this) {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Load;
+  }
 
-  bool hasResult() override { return true; }
+  std::span<Use> operands() override { return {&Ptr, 1}; }
 
   Value *getPtr() { return Ptr; }
 
 private:
-  Value *Ptr;
+  Use Ptr;
 };
 
 class ArithmeticInst : public Instruction {
@@ -51,14 +133,16 @@ public:
     Mul,
   };
 
-  ArithmeticInst(Opcode Opc, Value *LHS, Value *RHS, std::string Name = "")
-      : Instruction(Name),
+  ArithmeticInst(Opcode Opc, Value *LHS, Value *RHS, Symbol Name = {})
+      : Instruction(ValueKind::Arithmetic, Name),
         Opc(Opc),
-        Operands{LHS, RHS} {}
+        Operands{Use(LHS, this), Use(RHS, this)} {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Arithmetic;
+  }
 
-  bool hasResult() override { return true; }
+  std::span<Use> operands() override { return Operands; }
 
   Value *getLHS() { return Operands[0]; }
   Value *getRHS() { return Operands[1]; }
@@ -66,24 +150,116 @@ public:
 
 private:
   Opcode Opc;
-  std::array<Value *, 2> Operands;
+  std::array<Use, 2> Operands;
+};
+
+/// CompareInst - Compares two integers, giving 1 if the predicate holds and 0
+/// otherwise. The signed predicates read the operands as two's complement,
+/// and the unsigned ones as unsigned numbers.
+class CompareInst : public Instruction {
+public:
+  enum class Predicate {
+    EQ,
+    NE,
+    SLT,
+    SLE,
+    SGT,
+    SGE,
+    ULT,
+    ULE,
+    UGT,
+    UGE,
+  };
+
+  CompareInst(Predicate Pred, Value *LHS, Value *RHS, Symbol Name = {})
+      : Instruction(ValueKind::Compare, Name),
+        Pred(Pred),
+        Operands{Use(LHS, this), Use(RHS, this)} {}
+
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Compare;
+  }
+
+  std::span<Use> operands() override { return Operands; }
+
+  Value *getLHS() { return Operands[0]; }
+  Value *getRHS() { return Operands[1]; }
+  Predicate getPred() { return Pred; }
+
+  /// Whether \p Pred holds for \p LHS and \p RHS.
+  static bool evaluate(Predicate Pred, int64_t LHS, int64_t RHS) {
+    auto ULHS = static_cast<uint64_t>(LHS);
+    auto URHS = static_cast<uint64_t>(RHS);
+    switch (Pred) {
+    case Predicate::EQ: return LHS == RHS;
+    case Predicate::NE: return LHS != RHS;
+    case Predicate::SLT: return LHS < RHS;
+    case Predicate::SLE: return LHS <= RHS;
+    case Predicate::SGT: return LHS > RHS;
+    case Predicate::SGE: return LHS >= RHS;
+    case Predicate::ULT: return ULHS < URHS;
+    case Predicate::ULE: return ULHS <= URHS;
+    case Predicate::UGT: return ULHS > URHS;
+    case Predicate::UGE: return ULHS >= URHS;
+    }
+    return false;
+  }
+
+  /// The predicate that holds exactly when \p Pred does not.
+  static Predicate getInversePredicate(Predicate Pred) {
+    switch (Pred) {
+    case Predicate::EQ: return Predicate::NE;
+    case Predicate::NE: return Predicate::EQ;
+    case Predicate::SLT: return Predicate::SGE;
+    case Predicate::SLE: return Predicate::SGT;
+    case Predicate::SGT: return Predicate::SLE;
+    case Predicate::SGE: return Predicate::SLT;
+    case Predicate::ULT: return Predicate::UGE;
+    case Predicate::ULE: return Predicate::UGT;
+    case Predicate::UGT: return Predicate::ULE;
+    case Predicate::UGE: return Predicate::ULT;
+    }
+    return Pred;
+  }
+
+  /// The predicate that gives the same result with the operands swapped.
+  static Predicate getSwappedPredicate(Predicate Pred) {
+    switch (Pred) {
+    case Predicate::EQ:
+    case Predicate::NE: return Pred;
+    case Predicate::SLT: return Predicate::SGT;
+    case Predicate::SLE: return Predicate::SGE;
+    case Predicate::SGT: return Predicate::SLT;
+    case Predicate::SGE: return Predicate::SLE;
+    case Predicate::ULT: return Predicate::UGT;
+    case Predicate::ULE: return Predicate::UGE;
+    case Predicate::UGT: return Predicate::ULT;
+    case Predicate::UGE: return Predicate::ULE;
+    }
+    return Pred;
+  }
+
+private:
+  Predicate Pred;
+  std::array<Use, 2> Operands;
 };
 
 class ReturnInst : public Instruction {
 public:
-  ReturnInst(Value *Ret, std::string Name = "")
-      : Instruction(std::move(Name)),
-        Ret(Ret) {}
+  ReturnInst(Value *Ret, Symbol Name = {})
+      : Instruction(ValueKind::Return, Name),
+        Ret(Ret, this) {}
 
-  void accept(IRVisitor &V) override { V.visit(*this); }
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Return;
+  }
 
-  bool isTerminator() override { return true; }
-  bool hasResult() override { return true; }
+  std::span<Use> operands() override { return {&Ret, 1}; }
 
   Value *getVal() { return Ret; }
 
 private:
-  Value *Ret;
+  Use Ret;
 };
 
 #endif // !TOY_LANG_IR_INSTRUCTION_H
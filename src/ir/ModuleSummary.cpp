@@ -0,0 +1,615 @@
+#include "ir/ModuleSummary.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "fmt/format.h"
+
+#include "ir/AllocaInst.h"
+#include "ir/BranchInst.h"
+#include "ir/CallInst.h"
+#include "ir/Function.h"
+#include "ir/IRVisitor.h"
+#include "ir/Instruction.h"
+#include "ir/PhiInst.h"
+
+namespace {
+
+/// Bump whenever the encoding below changes.
+constexpr uint32_t FormatVersion = 3;
+
+constexpr char Magic[8] = {'T', 'O', 'Y', 'S', 'U', 'M', '\n', '\0'};
+
+/// A summary is this header followed by NumWords words, NumNames + 1 offsets
+/// into the name bytes, and the name bytes. Names are stored as local IDs
+/// into the name table.
+///
+/// The words hold NumFunctions prototypes, each encoded as
+///
+///   name, flags, number of parameters, parameter names...
+///
+/// followed by the body of every function whose flags have HasBody:
+///
+///   number of blocks, number of constants, constants as (low, high) words,
+///   and for each block the number of instructions and the instructions.
+///
+/// An instruction is an Opcode and its operands. A value operand indexes the
+/// values of the function, which are the parameters, then the constants,
+/// then every instruction in order. Blocks and callees are referred to by
+/// their index among the blocks and prototypes. A phi is its number of
+/// incoming values followed by (block, value) pairs, and is the only
+/// instruction whose operands may come later.
+struct Header {
+  char Magic[8];
+  uint32_t FormatVersion;
+  uint32_t NumFunctions;
+  uint64_t NumWords;
+  uint64_t NumNames;
+  uint64_t NameBytes;
+};
+
+enum Flags : uint32_t {
+  HasBody = 1 << 0,
+  Pure = 1 << 1,
+};
+
+enum Opcode : uint32_t {
+  OpAlloca,
+  OpLoad,
+  OpStore,
+  OpAdd,
+  OpSub,
+  OpMul,
+  OpCmp,
+  OpJump,
+  OpCJump,
+  OpCall,
+  OpReturn,
+  OpPhi,
+};
+
+/// Local IDs for the names a summary uses, in order of appearance.
+class NameTable {
+public:
+  uint32_t get(Symbol Name) {
+    auto [It, Inserted] =
+        IDs.try_emplace(Name, static_cast<uint32_t>(Names.size()));
+    if (Inserted)
+      Names.push_back(Name);
+    return It->second;
+  }
+
+  uint32_t get(std::string_view Name) { return get(Symbol::intern(Name)); }
+
+  const std::vector<Symbol> &getNames() const { return Names; }
+
+private:
+  std::unordered_map<Symbol, uint32_t> IDs;
+  std::vector<Symbol> Names;
+};
+
+/// Encodes the body of one function. Bodies that cannot be encoded, because
+/// they use a value before defining it outside a phi or call an unknown
+/// function, are rejected.
+class BodyEncoder : public IRVisitor<BodyEncoder> {
+public:
+  BodyEncoder(const std::unordered_map<Function *, uint32_t> &FnIndex,
+              NameTable &Names)
+      : FnIndex(FnIndex),
+        Names(Names) {}
+
+  using IRVisitor::visit;
+
+  /// Encode the body of \p Fn into \p Out, and collect the functions it
+  /// calls into \p Callees. Returns false if it cannot be encoded.
+  bool encode(Function &Fn, std::vector<uint32_t> &Out,
+              std::vector<Function *> &Callees) {
+    Words = &Out;
+    this->Callees = &Callees;
+    Valid = true;
+    ValueIndex.assign(Fn.getNumValueIDs(), NoIndex);
+    BlockIndex.assign(Fn.getNumBlockIDs(), NoIndex);
+    NumValues = 0;
+    PhiOperands.clear();
+
+    for (auto &Param : Fn.getArgs())
+      addValue(Param.get());
+    uint32_t NumBlocks = 0;
+    for (auto &BB : Fn.getBlocks())
+      BlockIndex[BB.getID()] = NumBlocks++;
+
+    auto Constants = Fn.getConstants();
+    Out.push_back(static_cast<uint32_t>(Fn.getBlocks().size()));
+    Out.push_back(static_cast<uint32_t>(Constants.size()));
+    for (auto *C : Constants) {
+      auto Bits = static_cast<uint64_t>(C->getVal());
+      Out.push_back(static_cast<uint32_t>(Bits));
+      Out.push_back(static_cast<uint32_t>(Bits >> 32));
+      addValue(C);
+    }
+
+    for (auto &BB : Fn.getBlocks()) {
+      Out.push_back(static_cast<uint32_t>(BB.size()));
+      for (auto &Inst : BB) {
+        visit(Inst);
+        addValue(&Inst);
+      }
+    }
+
+    for (auto [Pos, V] : PhiOperands) {
+      if (ValueIndex[V->getID()] == NoIndex)
+        return false;
+      Out[Pos] = ValueIndex[V->getID()];
+    }
+    return Valid;
+  }
+
+  void visit(AllocaInst &Inst) {
+    emit(OpAlloca);
+    Words->push_back(Names.get(Inst.getName()));
+  }
+
+  void visit(StoreInst &Inst) {
+    emit(OpStore);
+    operand(Inst.getPtr());
+    operand(Inst.getVal());
+  }
+
+  void visit(LoadInst &Inst) {
+    emit(OpLoad);
+    operand(Inst.getPtr());
+  }
+
+  void visit(ArithmeticInst &Inst) {
+    switch (Inst.getOpc()) {
+    case ArithmeticInst::Opcode::Add: emit(OpAdd); break;
+    case ArithmeticInst::Opcode::Sub: emit(OpSub); break;
+    case ArithmeticInst::Opcode::Mul: emit(OpMul); break;
+    }
+    operand(Inst.getLHS());
+    operand(Inst.getRHS());
+  }
+
+  void visit(CompareInst &Inst) {
+    emit(OpCmp);
+    Words->push_back(static_cast<uint32_t>(Inst.getPred()));
+    operand(Inst.getLHS());
+    operand(Inst.getRHS());
+  }
+
+  void visit(JumpInst &Inst) {
+    emit(OpJump);
+    block(Inst.getDest());
+  }
+
+  void visit(CJumpInst &Inst) {
+    emit(OpCJump);
+    operand(Inst.getCond());
+    block(Inst.getTrueBB());
+    block(Inst.getFalseBB());
+  }
+
+  void visit(CallInst &Inst) {
+    emit(OpCall);
+    auto It = FnIndex.find(Inst.getCallee());
+    if (It == FnIndex.end()) {
+      Valid = false;
+      return;
+    }
+    Words->push_back(It->second);
+    Callees->push_back(Inst.getCallee());
+
+    auto Args = Inst.getArguments();
+    Words->push_back(static_cast<uint32_t>(Args.size()));
+    for (Value *Arg : Args)
+      operand(Arg);
+  }
+
+  void visit(ReturnInst &Inst) {
+    emit(OpReturn);
+    operand(Inst.getVal());
+  }
+
+  void visit(PhiInst &Inst) {
+    emit(OpPhi);
+    Words->push_back(static_cast<uint32_t>(Inst.getNumIncoming()));
+    for (size_t I = 0; I < Inst.getNumIncoming(); ++I) {
+      block(Inst.getIncomingBlock(I));
+      // Filled in once every value has an index.
+      PhiOperands.emplace_back(Words->size(), Inst.getIncomingValue(I));
+      Words->push_back(0);
+    }
+  }
+
+private:
+  void emit(Opcode Op) { Words->push_back(Op); }
+
+  void addValue(Value *V) { ValueIndex[V->getID()] = NumValues++; }
+
+  void operand(Value *V) {
+    if (ValueIndex[V->getID()] == NoIndex) {
+      Valid = false;
+      return;
+    }
+    Words->push_back(ValueIndex[V->getID()]);
+  }
+
+  void block(BasicBlock *BB) { Words->push_back(BlockIndex[BB->getID()]); }
+
+  const std::unordered_map<Function *, uint32_t> &FnIndex;
+  NameTable &Names;
+
+  std::vector<uint32_t> *Words = nullptr;
+  std::vector<Function *> *Callees = nullptr;
+  bool Valid = true;
+
+  /// The index of each value and block in the summary, by ID, or NoIndex
+  /// for a value that is not defined yet.
+  static constexpr uint32_t NoIndex = ~uint32_t(0);
+  std::vector<uint32_t> ValueIndex;
+  std::vector<uint32_t> BlockIndex;
+  uint32_t NumValues = 0;
+  /// Where the words for the values of phis go, and those values.
+  std::vector<std::pair<size_t, Value *>> PhiOperands;
+};
+
+/// Reads words from a summary. Reading past the end yields zeros and marks
+/// the summary invalid.
+class WordReader {
+public:
+  WordReader(const std::vector<uint32_t> &Words) : Words(Words) {}
+
+  uint32_t next() {
+    if (Pos == Words.size()) {
+      Valid = false;
+      return 0;
+    }
+    return Words[Pos++];
+  }
+
+  /// Read an index that must be below \p Bound.
+  uint32_t nextIndex(size_t Bound) {
+    uint32_t Index = next();
+    if (Index >= Bound) {
+      Valid = false;
+      return 0;
+    }
+    return Index;
+  }
+
+  /// Read a count of items that take at least a word each.
+  uint32_t nextCount() { return nextIndex(Words.size() - Pos + 1); }
+
+  bool isValid() const { return Valid; }
+
+private:
+  const std::vector<uint32_t> &Words;
+  size_t Pos = 0;
+  bool Valid = true;
+};
+
+/// Rebuild a body encoded by BodyEncoder in \p Fn, which has none yet.
+bool decodeBody(WordReader &R, Function &Fn,
+                const std::vector<Function *> &Protos,
+                const std::vector<Symbol> &Names) {
+  uint32_t NumBlocks = R.nextCount();
+  uint32_t NumConstants = R.nextCount();
+  if (!R.isValid() || NumBlocks == 0)
+    return false;
+
+  std::vector<BasicBlock *> Blocks{Fn.makeEntryBlock()};
+  for (uint32_t I = 1; I < NumBlocks; ++I)
+    Blocks.push_back(Fn.makeNewBlock());
+
+  std::vector<Value *> Values;
+  for (auto &Param : Fn.getArgs())
+    Values.push_back(Param.get());
+  for (uint32_t I = 0; I < NumConstants; ++I) {
+    uint64_t Low = R.next();
+    uint64_t High = R.next();
+    Values.push_back(Fn.makeConstant(static_cast<int64_t>(High << 32 | Low)));
+  }
+
+  // After an error these return null and the decoding stops at the end of
+  // the instruction.
+  auto Operand = [&]() -> Value * {
+    auto Index = R.nextIndex(Values.size());
+    return R.isValid() ? Values[Index] : nullptr;
+  };
+  auto Block = [&]() { return Blocks[R.nextIndex(Blocks.size())]; };
+  auto Name = [&]() {
+    auto Index = R.nextIndex(Names.size());
+    return R.isValid() ? Names[Index] : Symbol();
+  };
+
+  // The values of phis, which may come later, as (phi, block, value index).
+  struct PhiOperand {
+    PhiInst *Phi;
+    BasicBlock *BB;
+    uint32_t Index;
+  };
+  std::vector<PhiOperand> PhiOperands;
+
+  for (auto *BB : Blocks) {
+    Fn.setInsertPoint(BB);
+    uint32_t NumInsts = R.nextCount();
+    for (uint32_t I = 0; I < NumInsts && R.isValid(); ++I) {
+      Value *Result = nullptr;
+      uint32_t Op = R.next();
+      switch (Op) {
+      case OpAlloca: Result = Fn.emit<AllocaInst>(Name()); break;
+      case OpLoad: Result = Fn.emit<LoadInst>(Operand()); break;
+      case OpStore: {
+        auto *Ptr = Operand();
+        Result = Fn.emit<StoreInst>(Ptr, Operand());
+        break;
+      }
+      case OpAdd:
+      case OpSub:
+      case OpMul: {
+        auto Opc = Op == OpAdd   ? ArithmeticInst::Opcode::Add
+                   : Op == OpSub ? ArithmeticInst::Opcode::Sub
+                                 : ArithmeticInst::Opcode::Mul;
+        auto *LHS = Operand();
+        Result = Fn.emit<ArithmeticInst>(Opc, LHS, Operand());
+        break;
+      }
+      case OpCmp: {
+        using Predicate = CompareInst::Predicate;
+        auto Pred = static_cast<Predicate>(
+            R.nextIndex(static_cast<size_t>(Predicate::UGE) + 1));
+        auto *LHS = Operand();
+        Result = Fn.emit<CompareInst>(Pred, LHS, Operand());
+        break;
+      }
+      case OpJump: Result = Fn.emit<JumpInst>(Block()); break;
+      case OpCJump: {
+        auto *Cond = Operand();
+        auto *TrueBB = Block();
+        Result = Fn.emit<CJumpInst>(Cond, TrueBB, Block());
+        break;
+      }
+      case OpCall: {
+        auto *Callee = Protos[R.nextIndex(Protos.size())];
+        std::vector<Value *> Args(R.nextCount());
+        for (auto &Arg : Args)
+          Arg = Operand();
+        Result = Fn.emit<CallInst>(Callee, std::move(Args));
+        break;
+      }
+      case OpReturn: Result = Fn.emit<ReturnInst>(Operand()); break;
+      case OpPhi: {
+        // Phis must come first in their block.
+        if (I != 0 && !isa<PhiInst>(BB->getLastInst()))
+          return false;
+        auto *Phi = cast<PhiInst>(Fn.emit<PhiInst>());
+        uint32_t NumIncoming = R.nextCount();
+        for (uint32_t J = 0; J < NumIncoming && R.isValid(); ++J) {
+          auto *From = Block();
+          PhiOperands.push_back({Phi, From, R.next()});
+        }
+        Result = Phi;
+        break;
+      }
+      default: return false;
+      }
+      Values.push_back(Result);
+    }
+  }
+
+  for (auto [Phi, From, Index] : PhiOperands) {
+    if (Index >= Values.size())
+      return false;
+    Phi->addIncoming(Values[Index], From);
+  }
+  return R.isValid();
+}
+
+/// Whether \p Fn is defined by this module, rather than declared or
+/// imported.
+bool isDefinedHere(Function &Fn) {
+  return Fn.getEntryBlock() != nullptr && !Fn.isAvailableExternally();
+}
+
+} // namespace
+
+bool ModuleSummary::write(const std::string &Path, IRCompilationUnit &IRUnit) {
+  std::vector<Function *> Functions;
+  std::unordered_map<Function *, uint32_t> FnIndex;
+  for (auto &Fn : IRUnit) {
+    FnIndex.try_emplace(Fn.get(), static_cast<uint32_t>(Functions.size()));
+    Functions.push_back(Fn.get());
+  }
+
+  // Encode every definition that is small enough to be saved at all.
+  NameTable Names;
+  BodyEncoder Encoder(FnIndex, Names);
+  std::vector<std::vector<uint32_t>> Bodies(Functions.size());
+  std::vector<std::vector<Function *>> Callees(Functions.size());
+  std::vector<bool> Encoded(Functions.size(), false);
+  for (size_t I = 0; I < Functions.size(); ++I) {
+    auto &Fn = *Functions[I];
+    if (isDefinedHere(Fn) && Fn.getInstructionCount() <= MaxPureSize)
+      Encoded[I] = Encoder.encode(Fn, Bodies[I], Callees[I]);
+  }
+
+  // A function is pure if everything it calls is pure and saved as well;
+  // assume that of every candidate and drop the ones that call anything else
+  // until nothing changes. Without globals, a call is the only side effect.
+  std::vector<bool> IsPure = Encoded;
+  for (bool Changed = true; Changed;) {
+    Changed = false;
+    for (size_t I = 0; I < Functions.size(); ++I) {
+      if (!IsPure[I])
+        continue;
+      for (auto *Callee : Callees[I]) {
+        if (!IsPure[FnIndex[Callee]]) {
+          IsPure[I] = false;
+          Changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<uint32_t> Words;
+  std::vector<bool> Saved(Functions.size(), false);
+  for (size_t I = 0; I < Functions.size(); ++I) {
+    auto &Fn = *Functions[I];
+    Saved[I] = IsPure[I] || (Encoded[I] && Fn.getInstructionCount() <=
+                                               MaxInlineSize);
+
+    Words.push_back(Names.get(Fn.getName()));
+    uint32_t FnFlags = 0;
+    if (Saved[I])
+      FnFlags |= HasBody;
+    if (IsPure[I])
+      FnFlags |= Pure;
+    Words.push_back(FnFlags);
+    Words.push_back(static_cast<uint32_t>(Fn.getArgs().size()));
+    for (auto &Param : Fn.getArgs())
+      Words.push_back(Names.get(Param->getName()));
+  }
+  for (size_t I = 0; I < Functions.size(); ++I)
+    if (Saved[I])
+      Words.insert(Words.end(), Bodies[I].begin(), Bodies[I].end());
+
+  std::vector<uint32_t> NameOffsets{0};
+  std::string NameBytes;
+  for (auto Name : Names.getNames()) {
+    NameBytes += Name.str();
+    NameOffsets.push_back(static_cast<uint32_t>(NameBytes.size()));
+  }
+
+  Header H = {};
+  std::memcpy(H.Magic, Magic, sizeof(Magic));
+  H.FormatVersion = FormatVersion;
+  H.NumFunctions = static_cast<uint32_t>(Functions.size());
+  H.NumWords = Words.size();
+  H.NumNames = Names.getNames().size();
+  H.NameBytes = NameBytes.size();
+
+  // Write to a private file and rename it into place, so that a module being
+  // compiled concurrently never imports half a summary.
+  auto TmpPath = fmt::format("{}.{}.tmp", Path, ::getpid());
+  std::FILE *File = std::fopen(TmpPath.c_str(), "wb");
+  if (File == nullptr)
+    return false;
+
+  bool Success =
+      std::fwrite(&H, sizeof(H), 1, File) == 1 &&
+      std::fwrite(Words.data(), sizeof(uint32_t), Words.size(), File) ==
+          Words.size() &&
+      std::fwrite(NameOffsets.data(), sizeof(uint32_t), NameOffsets.size(),
+                  File) == NameOffsets.size() &&
+      std::fwrite(NameBytes.data(), 1, NameBytes.size(), File) ==
+          NameBytes.size();
+  Success = std::fclose(File) == 0 && Success;
+
+  if (!Success || std::rename(TmpPath.c_str(), Path.c_str()) != 0) {
+    std::remove(TmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ModuleSummary::read(const std::string &Path, IRCompilationUnit &IRUnit) {
+  std::FILE *File = std::fopen(Path.c_str(), "rb");
+  if (File == nullptr)
+    return false;
+
+  Header H;
+  std::vector<uint32_t> Words;
+  std::vector<uint32_t> NameOffsets;
+  std::string NameBytes;
+  bool Valid = std::fread(&H, sizeof(H), 1, File) == 1 &&
+               std::memcmp(H.Magic, Magic, sizeof(Magic)) == 0 &&
+               H.FormatVersion == FormatVersion;
+  if (Valid) {
+    // Bound the sizes by the file, so that a corrupt header cannot make us
+    // allocate more than that.
+    long Size = std::fseek(File, 0, SEEK_END) == 0 ? std::ftell(File) : -1;
+    Valid = Size >= 0 &&
+            sizeof(Header) + H.NumWords * sizeof(uint32_t) +
+                    (H.NumNames + 1) * sizeof(uint32_t) + H.NameBytes ==
+                uint64_t(Size) &&
+            std::fseek(File, sizeof(Header), SEEK_SET) == 0;
+  }
+  if (Valid) {
+    Words.resize(H.NumWords);
+    NameOffsets.resize(H.NumNames + 1);
+    NameBytes.resize(H.NameBytes);
+    Valid = std::fread(Words.data(), sizeof(uint32_t), Words.size(), File) ==
+                Words.size() &&
+            std::fread(NameOffsets.data(), sizeof(uint32_t),
+                       NameOffsets.size(), File) == NameOffsets.size() &&
+            std::fread(NameBytes.data(), 1, NameBytes.size(), File) ==
+                NameBytes.size();
+  }
+  std::fclose(File);
+
+  Valid = Valid && NameOffsets.front() == 0 &&
+          NameOffsets.back() == H.NameBytes &&
+          std::is_sorted(NameOffsets.begin(), NameOffsets.end());
+  if (!Valid)
+    return false;
+
+  std::vector<Symbol> Names;
+  Names.reserve(H.NumNames);
+  for (size_t I = 0; I < H.NumNames; ++I)
+    Names.push_back(Symbol::intern(std::string_view(NameBytes).substr(
+        NameOffsets[I], NameOffsets[I + 1] - NameOffsets[I])));
+
+  // Declare every function first, so that bodies can call any of them.
+  WordReader R(Words);
+  std::vector<Function *> Protos;
+  std::vector<uint32_t> FnFlags;
+  std::vector<std::vector<Symbol>> FnParams;
+  for (uint32_t I = 0; I < H.NumFunctions && R.isValid(); ++I) {
+    auto NameIndex = R.nextIndex(Names.size());
+    FnFlags.push_back(R.next());
+    auto &Params = FnParams.emplace_back(R.nextCount());
+    for (auto &Param : Params) {
+      auto ParamIndex = R.nextIndex(Names.size());
+      Param = R.isValid() ? Names[ParamIndex] : Symbol();
+    }
+    if (!R.isValid())
+      return false;
+
+    Symbol Name = Names[NameIndex];
+    auto *Fn = IRUnit.lookupFunction(Name);
+    if (Fn == nullptr)
+      Fn = IRUnit.makeNewFunction(Name, Params);
+    Protos.push_back(Fn);
+  }
+
+  for (size_t I = 0; I < Protos.size(); ++I) {
+    if ((FnFlags[I] & HasBody) == 0)
+      continue;
+
+    // A body only goes to a bodiless declaration with the same parameters.
+    // Any other is decoded into a scratch function, to step over it.
+    auto *Fn = Protos[I];
+    bool Attach = Fn->getEntryBlock() == nullptr &&
+                  Fn->getArgs().size() == FnParams[I].size();
+    if (!Attach) {
+      Function Scratch(Fn->getName(), FnParams[I]);
+      if (!decodeBody(R, Scratch, Protos, Names))
+        return false;
+      continue;
+    }
+
+    if (!decodeBody(R, *Fn, Protos, Names)) {
+      Fn->releaseBody();
+      return false;
+    }
+    Fn->setAvailableExternally(true);
+    Fn->setPure((FnFlags[I] & Pure) != 0);
+  }
+  return R.isValid();
+}
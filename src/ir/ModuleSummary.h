@@ -0,0 +1,35 @@
+#ifndef TOY_LANG_IR_MODULE_SUMMARY_H
+#define TOY_LANG_IR_MODULE_SUMMARY_H
+
+#include <cstddef>
+#include <string>
+
+#include "ir/IRCompilationUnit.h"
+
+/// ModuleSummary - The binary interface of a compiled module, which other
+/// modules read on 'import' instead of parsing its source.
+///
+/// A summary lists the prototype of every function the module declares, and
+/// the IR of the definitions that are worth optimizing across files: those
+/// small enough to inline, and pure ones that calls with constant arguments
+/// can be evaluated into. Reading it declares those functions in the
+/// importing unit, and attaches the saved bodies as available-externally
+/// definitions.
+class ModuleSummary {
+public:
+  /// Bodies of at most this many instructions are saved.
+  static constexpr size_t MaxInlineSize = 32;
+
+  /// Bodies of pure functions are saved up to this many instructions.
+  static constexpr size_t MaxPureSize = 256;
+
+  /// Save the summary of \p IRUnit to \p Path. Returns false on failure.
+  static bool write(const std::string &Path, IRCompilationUnit &IRUnit);
+
+  /// Declare the functions of the summary at \p Path in \p IRUnit. A saved
+  /// body is attached to a function unless it already has one. Returns false
+  /// if there is no valid summary at \p Path.
+  static bool read(const std::string &Path, IRCompilationUnit &IRUnit);
+};
+
+#endif // !TOY_LANG_IR_MODULE_SUMMARY_H
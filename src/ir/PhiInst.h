@@ -0,0 +1,55 @@
+#ifndef TOY_LANG_IR_PHI_INST_H
+#define TOY_LANG_IR_PHI_INST_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ir/BasicBlock.h"
+#include "ir/Instruction.h"
+
+/// PhiInst - Takes the value of the incoming entry for the block control came
+/// from. Phis are at the top of their block, and all of them take their
+/// values at once, on entry to the block.
+class PhiInst : public Instruction {
+public:
+  PhiInst(Symbol Name = {}) : Instruction(ValueKind::Phi, Name) {}
+
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Phi;
+  }
+
+  std::span<Use> operands() override { return IncomingValues; }
+
+  void addIncoming(Value *V, BasicBlock *BB) {
+    IncomingValues.emplace_back(V, this);
+    IncomingBlocks.push_back(BB);
+  }
+
+  size_t getNumIncoming() const { return IncomingValues.size(); }
+  Value *getIncomingValue(size_t I) { return IncomingValues[I]; }
+  void setIncomingValue(size_t I, Value *V) { IncomingValues[I] = V; }
+  BasicBlock *getIncomingBlock(size_t I) { return IncomingBlocks[I]; }
+  void setIncomingBlock(size_t I, BasicBlock *BB) { IncomingBlocks[I] = BB; }
+
+  /// Remove incoming entry \p I. The last entry takes its place.
+  void removeIncoming(size_t I) {
+    IncomingValues[I] = IncomingValues.back().get();
+    IncomingBlocks[I] = IncomingBlocks.back();
+    IncomingValues.pop_back();
+    IncomingBlocks.pop_back();
+  }
+
+  /// The value for control coming from \p BB, or null if there is none.
+  Value *getIncomingValueForBlock(BasicBlock *BB) {
+    for (size_t I = 0; I < IncomingBlocks.size(); ++I)
+      if (IncomingBlocks[I] == BB)
+        return IncomingValues[I];
+    return nullptr;
+  }
+
+private:
+  std::vector<Use> IncomingValues;
+  std::vector<BasicBlock *> IncomingBlocks;
+};
+
+#endif // !TOY_LANG_IR_PHI_INST_H
@@ -0,0 +1,86 @@
+#ifndef TOY_LANG_IR_USE_H
+#define TOY_LANG_IR_USE_H
+
+#include "ir/Value.h"
+
+class Instruction;
+
+/// Use - An operand of an instruction. Besides the value it refers to, it is
+/// a node in the list of uses of that value, so that the users of a value can
+/// be found, and an operand changed or dropped, without scanning anything.
+///
+/// A Use may be moved, as when the vector holding it grows, and then takes
+/// over the place of the old one in the list. It leaves the list when it is
+/// destroyed.
+class Use {
+public:
+  Use(Value *Val, Instruction *User) : User(User) { set(Val); }
+
+  Use(Use &&Other) noexcept : Val(Other.Val), User(Other.User) {
+    if (Val == nullptr)
+      return;
+    Next = Other.Next;
+    Prev = Other.Prev;
+    *Prev = this;
+    if (Next != nullptr)
+      Next->Prev = &Next;
+    Other.Val = nullptr;
+  }
+
+  Use(const Use &) = delete;
+  Use &operator=(const Use &) = delete;
+
+  ~Use() { removeFromList(); }
+
+  Value *get() const { return Val; }
+  operator Value *() const { return Val; }
+
+  /// Refer to \p V instead, which may be null.
+  void set(Value *V) {
+    removeFromList();
+    Val = V;
+    addToList();
+  }
+
+  Use &operator=(Value *V) {
+    set(V);
+    return *this;
+  }
+
+  Instruction *getUser() const { return User; }
+
+  /// The next use of the same value.
+  Use *getNext() const { return Next; }
+
+private:
+  friend class Value;
+
+  void addToList() {
+    if (Val == nullptr)
+      return;
+    Next = Val->UseList;
+    Prev = &Val->UseList;
+    if (Next != nullptr)
+      Next->Prev = &Next;
+    Val->UseList = this;
+  }
+
+  void removeFromList() {
+    if (Val == nullptr)
+      return;
+    *Prev = Next;
+    if (Next != nullptr)
+      Next->Prev = Prev;
+    Next = nullptr;
+    Prev = nullptr;
+  }
+
+  Value *Val = nullptr;
+  Instruction *User;
+  Use *Next = nullptr;
+  /// The link that points to this use: the Next of the previous use, or the
+  /// head of the value's list.
+  Use **Prev = nullptr;
+};
+
+#endif // !TOY_LANG_IR_USE_H
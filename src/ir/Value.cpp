@@ -1,11 +1,20 @@
 #include "Value.h"
 
-#include "fmt/format.h"
+#include <cassert>
 
-Value::Value(std::string Name) : Name(std::move(Name)) {}
+#include "ir/Use.h"
 
-Value::~Value() {}
+Value::~Value() {
+  while (UseList != nullptr)
+    UseList->set(nullptr);
+}
+
+bool Value::hasOneUse() const {
+  return UseList != nullptr && UseList->getNext() == nullptr;
+}
 
-void Value::assignNameByNumber(int64_t ID) {
-  Name = fmt::format("%{}", ID);
+void Value::replaceAllUsesWith(Value *V) {
+  assert(V != this && "Replacing a value with itself");
+  while (UseList != nullptr)
+    UseList->set(V);
 }
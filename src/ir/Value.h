@@ -2,35 +2,76 @@
 #define TOY_LANG_IR_VALUE_H
 
 #include <cstdint>
-#include <string>
 
-#include "ir/IRVisitor.h"
+#include "support/Casting.h"
+#include "support/Symbol.h"
+
+class Use;
+
+/// ValueKind - What a Value is, for isa<>, cast<> and dyn_cast<> and for
+/// switching over the kinds of instructions. The instructions come last,
+/// with the terminators at the end, so that each group is a range.
+enum class ValueKind : uint8_t {
+  Parameter,
+  Constant,
+  BasicBlock,
+  /// An irgen::LocalVariable, which stands for a variable while a function
+  /// is lowered and never appears in the IR.
+  Variable,
+
+  Alloca,
+  Store,
+  Load,
+  Arithmetic,
+  Compare,
+  Call,
+  Phi,
+  Jump,
+  CJump,
+  Return,
+
+  FirstInst = Alloca,
+  FirstTerminator = Jump,
+  LastInst = Return,
+};
 
 class Value {
 public:
-  // Value(int64_t ID);
-  Value() = default;
-  Value(std::string Name);
+  Value(ValueKind Kind, Symbol Name = {}) : Kind(Kind), Name(Name) {}
   Value(const Value &) = delete;
   Value &operator=(const Value &) = delete;
 
-  Value(Value &&) = default;
-  Value &operator=(Value &&) = default;
-
+  /// Drops every use of the value that is left, so that the users may be
+  /// destroyed after it.
   virtual ~Value() = 0;
 
-  virtual void accept(IRVisitor &V) = 0;
+  ValueKind getKind() const { return Kind; }
+
+  /// The name the value has in the source, such as that of a parameter.
+  /// Other values are only given names when the IR is printed.
+  Symbol getName() const { return Name; }
 
-  virtual bool hasResult() { return false; }
-  virtual bool isLValue() { return false; }
-  virtual bool isTerminator() { return false; }
+  /// A number that is unique among the values, or among the blocks, of the
+  /// function the value belongs to. The numbers are dense, so side tables
+  /// can be vectors indexed by them; see Function::getNumValueIDs().
+  unsigned getID() const { return ID; }
 
-  void assignName(std::string Name) { this->Name = Name; }
-  void assignNameByNumber(int64_t Num);
-  std::string_view getName() const { return Name; }
+  /// The uses of this value, linked through Use::getNext().
+  Use *getFirstUse() const { return UseList; }
+  bool use_empty() const { return UseList == nullptr; }
+  bool hasOneUse() const;
+
+  /// Make every use of this value use \p V instead.
+  void replaceAllUsesWith(Value *V);
 
 private:
-  std::string Name;
+  friend class Use;
+  friend class Function;
+
+  ValueKind Kind;
+  Symbol Name;
+  unsigned ID = 0;
+  Use *UseList = nullptr;
 };
 
 #endif // !TOY_LANG_IR_VALUE_H
@@ -0,0 +1,180 @@
+#include "irgen/IRGenerator.h"
+#include "parser/FlatAST.h"
+
+namespace irgen {
+
+namespace {
+
+/// Lowers the body of one function of a FlatAST. It visits subtrees in the
+/// same order as FunctionVisitor and ExprVisitor, and LoweringContext emits
+/// the code, so the result is identical.
+class FlatFunctionLowering {
+public:
+  using Kind = FlatAST::Kind;
+  using NodeRef = FlatAST::NodeRef;
+
+  FlatFunctionLowering(const FlatAST &Tree, IRCompilationUnit &IRUnit,
+                       Function &Fn)
+      : Tree(Tree),
+        Ctx(IRUnit, Fn) {}
+
+  void lowerFunction(const FlatAST::Node &FnNode) {
+    const auto &Proto = Tree[FlatAST::child(FnNode.A)];
+    auto Guard = Ctx.getScope().openNewScope();
+    Ctx.bindParams(Tree.getParams(Proto));
+
+    lowerStmt(FlatAST::child(FnNode.B));
+    Ctx.finish();
+  }
+
+private:
+  void lowerStmt(NodeRef Ref) {
+    const auto &N = Tree[Ref];
+    switch (N.K) {
+    case Kind::Block: {
+      auto ScopeGuard = Ctx.getScope().openNewScope();
+      for (auto Stmt : Tree.getList(N))
+        lowerStmt(Stmt);
+      break;
+    }
+    case Kind::If: {
+      auto Else = FlatAST::child(N.C);
+      auto Blocks =
+          Ctx.beginIf(lowerExpr(FlatAST::child(N.A)), static_cast<bool>(Else));
+      lowerStmt(FlatAST::child(N.B));
+      if (Else) {
+        Ctx.beginElse(Blocks);
+        lowerStmt(Else);
+      }
+      Ctx.endIf(Blocks);
+      break;
+    }
+    case Kind::While: {
+      auto Blocks = Ctx.beginWhile();
+      Ctx.beginWhileBody(Blocks, lowerExpr(FlatAST::child(N.A)));
+      lowerStmt(FlatAST::child(N.B));
+      Ctx.endWhile(Blocks);
+      break;
+    }
+    case Kind::Var: {
+      auto *LocalVar = Ctx.lowerVarDecl(FlatAST::symbol(N.A));
+      if (auto Init = FlatAST::child(N.C))
+        Ctx.lowerVarInit(LocalVar, lowerExpr(Init));
+      break;
+    }
+    case Kind::Return: {
+      auto Val = FlatAST::child(N.A);
+      Ctx.lowerReturn(Val ? lowerExpr(Val) : nullptr);
+      break;
+    }
+    case Kind::ExprStmt: lowerExpr(FlatAST::child(N.A)); break;
+    default: assert(false && "Not a statement");
+    }
+  }
+
+  /// Lower an expression in post-order with explicit stacks, like
+  /// ExprLowering.
+  Value *lowerExpr(NodeRef Root) {
+    Frames.push_back({Root, 0});
+    while (!Frames.empty()) {
+      auto [Ref, NextOperand] = Frames.back();
+      const auto &N = Tree[Ref];
+      NodeRef Operand = nullptr;
+      Value *Result = nullptr;
+
+      switch (N.K) {
+      case Kind::Number: Result = Ctx.lowerNumber(FlatAST::getNumber(N)); break;
+      case Kind::Variable:
+        Result = Ctx.lowerVariable(FlatAST::symbol(N.A));
+        break;
+      case Kind::Unary:
+        if (NextOperand == 0) {
+          Operand = FlatAST::child(N.A);
+          break;
+        }
+        Result = Ctx.lowerUnary(N.Op, Values.back());
+        Values.pop_back();
+        break;
+      case Kind::Binary: {
+        if (NextOperand < 2) {
+          Operand = FlatAST::child(NextOperand == 0 ? N.A : N.B);
+          break;
+        }
+        auto *RHS = Values.back();
+        Values.pop_back();
+        Result = Ctx.lowerBinary(N.Op, Values.back(), RHS);
+        Values.pop_back();
+        break;
+      }
+      case Kind::Call: {
+        auto Args = Tree.getList(N);
+        if (NextOperand != 0)
+          Values.back() = Ctx.rvalue(Values.back());
+        if (NextOperand < Args.size()) {
+          Operand = Args[NextOperand];
+          break;
+        }
+        auto First = Values.end() - static_cast<ptrdiff_t>(Args.size());
+        std::vector<Value *> ArgValues(First, Values.end());
+        Values.erase(First, Values.end());
+        Result = Ctx.lowerCall(FlatAST::symbol(N.A), std::move(ArgValues));
+        break;
+      }
+      default: assert(false && "Not an expression");
+      }
+
+      if (Operand) {
+        ++Frames.back().NextOperand;
+        Frames.push_back({Operand, 0});
+      } else {
+        Frames.pop_back();
+        Values.push_back(Result);
+      }
+    }
+
+    auto *Result = Values.back();
+    Values.pop_back();
+    return Result;
+  }
+
+  struct Frame {
+    NodeRef Ref;
+    size_t NextOperand;
+  };
+
+  const FlatAST &Tree;
+  LoweringContext Ctx;
+  std::vector<Frame> Frames;
+  std::vector<Value *> Values;
+};
+
+} // namespace
+
+void IRGenerator::lower(const FlatAST &Tree) {
+  std::vector<Function *> Fns;
+  std::vector<const FlatAST::Node *> Bodies;
+  for (auto Decl : Tree.getDecls()) {
+    const auto &N = Tree[Decl];
+    if (N.K == FlatAST::Kind::Import) {
+      importModule(FlatAST::symbol(N.A));
+      continue;
+    }
+
+    if (N.K != FlatAST::Kind::Function) {
+      declareFunction(FlatAST::symbol(N.A), Tree.getParams(N));
+      continue;
+    }
+
+    const auto &Proto = Tree[FlatAST::child(N.A)];
+    Fns.push_back(
+        defineFunction(FlatAST::symbol(Proto.A), Tree.getParams(Proto)));
+    Bodies.push_back(&N);
+  }
+
+  lowerBodies(Fns, [&](size_t I) {
+    FlatFunctionLowering Lowering(Tree, IRUnit, *Fns[I]);
+    Lowering.lowerFunction(*Bodies[I]);
+  });
+}
+
+} // namespace irgen
@@ -1,207 +1,558 @@
 #include "irgen/IRGenerator.h"
-#include "ir/AllocaInst.h"
+
+#include <unordered_set>
+
 #include "ir/BranchInst.h"
 #include "ir/CallInst.h"
 #include "ir/Instruction.h"
+#include "ir/ModuleSummary.h"
 #include "parser/AST.h"
+#include "parser/Error.h"
+#include "support/ThreadPool.h"
 
 namespace irgen {
 
-Function *IRGenerator::makeFunction(PrototypeAST &ProtoAST) {
-  std::vector<std::string> Params;
-  for (const auto &Param : ProtoAST.getParams())
-    Params.push_back(Param.first);
-  return IRUnit.makeNewFunction(ProtoAST.getName(), Params);
+//===----------------------------------------------------------------------===//
+// NestedScope
+//===----------------------------------------------------------------------===//
+
+void NestedScope::popScope(size_t Mark) {
+  while (UndoLog.size() > Mark) {
+    auto [Name, Binding] = UndoLog.back();
+    UndoLog.pop_back();
+    Table[findSlot(Name)].Binding = Binding;
+  }
+}
+
+void NestedScope::update(Symbol Name, Value *Value) {
+  assert(!Name.empty() && "Binding the empty name");
+  auto *Slot = &Table[findSlot(Name)];
+  if (Slot->Name.empty()) {
+    if (2 * (NumNames + 1) > Table.size()) {
+      grow();
+      Slot = &Table[findSlot(Name)];
+    }
+    Slot->Name = Name;
+    ++NumNames;
+  }
+  UndoLog.emplace_back(Name, Slot->Binding);
+  Slot->Binding = Value;
 }
 
-void IRGenerator::visit(PrototypeAST &ProtoAST) {
-  auto *Fn = IRUnit.lookupFunction(ProtoAST.getName());
-  if (!Fn)
-    makeFunction(ProtoAST);
+void NestedScope::grow() {
+  std::vector<Entry> Old(Table.size() * 2);
+  std::swap(Table, Old);
+  for (const auto &E : Old)
+    if (!E.Name.empty())
+      Table[findSlot(E.Name)] = E;
 }
 
-void IRGenerator::visit(FunctionAST &FnAST) {
-  auto *Fn = IRUnit.lookupFunction(FnAST.getProto().getName());
-  if (!Fn)
-    Fn = makeFunction(FnAST.getProto());
+//===----------------------------------------------------------------------===//
+// LoweringContext
+//===----------------------------------------------------------------------===//
 
-  Fn->setInsertPoint(Fn->makeEntryBlock());
+void LoweringContext::bindParams(
+    std::span<const std::pair<Symbol, Symbol>> Params) {
+  const auto &ParamsValue = Fn.getArgs();
+  assert(Params.size() == ParamsValue.size());
+
+  // Nothing branches back to the entry block.
+  auto *Entry = Fn.getEntryBlock();
+  SSA.sealBlock(Entry);
+
+  for (size_t I = 0; I < Params.size(); ++I) {
+    auto *Var = SSA.makeVariable(Params[I].first);
+    SSA.writeVariable(Var, Entry, ParamsValue[I].get());
+    NS.update(Params[I].first, Var);
+  }
+}
+
+Value *LoweringContext::rvalue(Value *V) {
+  if (auto *Var = dyn_cast<LocalVariable>(V))
+    return SSA.readVariable(Var, Fn.getCurrInsertPoint());
+  return V;
+}
+
+void LoweringContext::assign(Value *Var, Value *Val) {
+  assert(isa<LocalVariable>(Var) &&
+         "Assigning to something that is not a variable");
+  if (auto *LV = dyn_cast<LocalVariable>(Var))
+    SSA.writeVariable(LV, Fn.getCurrInsertPoint(), rvalue(Val));
+}
+
+void LoweringContext::jump(BasicBlock *Dest) {
+  SSA.addEdge(Fn.getCurrInsertPoint(), Dest);
+  Fn.emit<JumpInst>(Dest);
+}
+
+Value *LoweringContext::lowerNumber(int64_t Val) {
+  return Builder.getConstant(Val);
+}
 
-  FunctionVisitor FnVisitor(IRUnit, NS, *Fn);
-  FnAST.accept(FnVisitor);
+Value *LoweringContext::lowerVariable(Symbol Name) {
+  return NS.lookup(Name);
 }
 
-void IRGenerator::visit(CompilationUnit &Unit) {
-  for (const auto &Decls : Unit.getDecls()) {
-    Decls->accept(*this);
+Value *LoweringContext::lowerUnary(char Opcode, Value *Operand) {
+  switch (Opcode) {
+  case '-':
+    return Builder.createArithmetic(ArithmeticInst::Opcode::Sub,
+                                    Builder.getConstant(0), rvalue(Operand));
+  default: assert(false && "Unknown unary operator");
   }
+  return nullptr;
 }
 
-void FunctionVisitor::visit(BlockStmtAST &Block) {
-  // Open a new scope
-  auto ScopeGuard = NS.openNewScope();
-  for (const auto &Stmt : Block.getStmts())
-    Stmt->accept(*this);
+Value *LoweringContext::lowerBinary(char Opcode, Value *LHS, Value *RHS) {
+  if (Opcode != '=')
+    LHS = rvalue(LHS);
+  RHS = rvalue(RHS);
+
+  switch (Opcode) {
+  case '+':
+    return Builder.createArithmetic(ArithmeticInst::Opcode::Add, LHS, RHS);
+  case '-':
+    return Builder.createArithmetic(ArithmeticInst::Opcode::Sub, LHS, RHS);
+  case '*':
+    return Builder.createArithmetic(ArithmeticInst::Opcode::Mul, LHS, RHS);
+  case '<':
+    return Builder.createCompare(CompareInst::Predicate::SLT, LHS, RHS);
+  case '>':
+    return Builder.createCompare(CompareInst::Predicate::SGT, LHS, RHS);
+  case '=': assign(LHS, RHS); return RHS;
+  default: assert(false && "Unknown binary operator");
+  }
+  return nullptr;
 }
 
-FunctionVisitor::FunctionVisitor(IRCompilationUnit &IRUnit, NestedScope &NS,
-                                 Function &Fn)
-    : IRUnit(IRUnit),
-      NS(NS),
-      Fn(Fn) {}
+Value *LoweringContext::lowerCall(Symbol Callee, std::vector<Value *> Args) {
+  return Fn.emit<CallInst>(IRUnit.lookupFunction(Callee), std::move(Args));
+}
 
-void FunctionVisitor::visit(IfStmtAST &If) {
-  ExprVisitor CondVisitor(IRUnit, NS, Fn);
-  If.getCond().accept(CondVisitor);
-  auto *Cond = CondVisitor.getResult();
+Value *LoweringContext::lowerVarDecl(Symbol Name) {
+  auto *Var = SSA.makeVariable(Name);
+  NS.update(Name, Var);
+  return Var;
+}
 
+void LoweringContext::lowerVarInit(Value *Var, Value *Init) {
+  assign(Var, Init);
+}
+
+void LoweringContext::lowerReturn(Value *Val) {
+  Fn.emit<ReturnInst>(Val ? rvalue(Val) : Builder.getConstant(0));
+}
+
+LoweringContext::IfBlocks LoweringContext::beginIf(Value *Cond, bool HasElse) {
+  Cond = rvalue(Cond);
   auto *ThenBB = Fn.makeNewBlock();
   auto *ElseBB = Fn.makeNewBlock();
   auto *FinalBB = Fn.makeNewBlock();
-  if (If.getElse()) {
+  auto *CondBB = Fn.getCurrInsertPoint();
+  if (HasElse) {
     Fn.emit<CJumpInst>(Cond, ThenBB, ElseBB);
+    SSA.addEdge(CondBB, ElseBB);
   } else {
     Fn.emit<CJumpInst>(Cond, ThenBB, FinalBB);
+    SSA.addEdge(CondBB, FinalBB);
   }
+  SSA.addEdge(CondBB, ThenBB);
+  SSA.sealBlock(ThenBB);
+  SSA.sealBlock(ElseBB);
 
   Fn.setInsertPoint(ThenBB);
-  If.getThen().accept(*this);
-  Fn.emit<JumpInst>(FinalBB);
+  return {ThenBB, ElseBB, FinalBB};
+}
 
-  if (auto *Else = If.getElse()) {
-    Fn.setInsertPoint(ElseBB);
-    Else->accept(*this);
-    Fn.emit<JumpInst>(FinalBB);
-  }
+void LoweringContext::beginElse(const IfBlocks &Blocks) {
+  jump(Blocks.Final);
+  Fn.setInsertPoint(Blocks.Else);
+}
 
-  Fn.setInsertPoint(FinalBB);
+void LoweringContext::endIf(const IfBlocks &Blocks) {
+  jump(Blocks.Final);
+  SSA.sealBlock(Blocks.Final);
+  Fn.setInsertPoint(Blocks.Final);
 }
 
-void FunctionVisitor::visit(WhileStmtAST &While) {
+LoweringContext::WhileBlocks LoweringContext::beginWhile() {
   auto *CondBB = Fn.makeNewBlock();
   auto *LoopBB = Fn.makeNewBlock();
   auto *FinalBB = Fn.makeNewBlock();
 
-  Fn.emit<JumpInst>(CondBB);
+  // The condition block stays unsealed until the back edge from the end of
+  // the body is known.
+  jump(CondBB);
   Fn.setInsertPoint(CondBB);
+  return {CondBB, LoopBB, FinalBB};
+}
 
-  ExprVisitor CondVisitor(IRUnit, NS, Fn);
+void LoweringContext::beginWhileBody(const WhileBlocks &Blocks, Value *Cond) {
+  Fn.emit<CJumpInst>(rvalue(Cond), Blocks.Loop, Blocks.Final);
+  SSA.addEdge(Blocks.Cond, Blocks.Loop);
+  SSA.addEdge(Blocks.Cond, Blocks.Final);
+  SSA.sealBlock(Blocks.Loop);
+  SSA.sealBlock(Blocks.Final);
+  Fn.setInsertPoint(Blocks.Loop);
+}
+
+void LoweringContext::endWhile(const WhileBlocks &Blocks) {
+  jump(Blocks.Cond);
+  SSA.sealBlock(Blocks.Cond);
+  Fn.setInsertPoint(Blocks.Final);
+}
+
+//===----------------------------------------------------------------------===//
+// IRGenerator
+//===----------------------------------------------------------------------===//
+
+Function *IRGenerator::declareFunction(
+    Symbol Name, std::span<const std::pair<Symbol, Symbol>> Params) {
+  if (auto *Fn = IRUnit.lookupFunction(Name))
+    return Fn;
+
+  std::vector<Symbol> ParamNames;
+  for (const auto &Param : Params)
+    ParamNames.push_back(Param.first);
+  return IRUnit.makeNewFunction(Name, ParamNames);
+}
+
+Function *IRGenerator::defineFunction(
+    Symbol Name, std::span<const std::pair<Symbol, Symbol>> Params) {
+  auto *Fn = declareFunction(Name, Params);
+  if (Fn->isAvailableExternally()) {
+    Fn->releaseBody();
+    Fn->setAvailableExternally(false);
+    Fn->setPure(false);
+  }
+
+  Fn->setInsertPoint(Fn->makeEntryBlock());
+  return Fn;
+}
+
+void IRGenerator::importModule(Symbol Name) {
+  if (!Imported.insert(Name).second)
+    return;
+
+  for (const auto &Dir : ImportPaths)
+    if (ModuleSummary::read(fmt::format("{}/{}.tsum", Dir, Name), IRUnit))
+      return;
+
+  printError("cannot import module '{}': no valid {}.tsum in the import path",
+             Name, Name);
+  ++NumErrors;
+}
+
+Function *IRGenerator::lowerFunction(FunctionAST &FnAST) {
+  auto &Proto = FnAST.getProto();
+  auto *Fn = defineFunction(Proto.getName(), Proto.getParams());
+  lowerBody(*Fn, FnAST);
+  return Fn;
+}
+
+void IRGenerator::lowerBody(Function &Fn, FunctionAST &FnAST) {
+  if (D == Dispatch::Static) {
+    FunctionLowering Lowering(IRUnit, Fn);
+    Lowering.visit(FnAST);
+  } else {
+    FunctionVisitor FnVisitor(IRUnit, Fn);
+    FnAST.accept(FnVisitor);
+  }
+}
+
+void IRGenerator::lowerBodies(std::span<Function *const> Fns,
+                              const std::function<void(size_t)> &LowerBody) {
+  // A function defined twice would have both bodies lowered into it at once,
+  // so such a unit is lowered serially.
+  std::unordered_set<Function *> Distinct(Fns.begin(), Fns.end());
+  if (NumThreads == 1 || Fns.size() <= 1 || Distinct.size() != Fns.size()) {
+    for (size_t I = 0; I < Fns.size(); ++I)
+      LowerBody(I);
+    return;
+  }
+
+  // Every function has been declared by now, so the bodies only read the
+  // unit, and each of them is lowered into its own Function.
+  ThreadPool Pool(NumThreads);
+  for (size_t I = 0; I < Fns.size(); ++I)
+    Pool.async([&LowerBody, I] { LowerBody(I); });
+  Pool.wait();
+}
+
+Function *IRGenerator::lower(TopLevelDeclarationAST &Decl) {
+  if (Decl.getKind() == ASTKind::Function) {
+    auto &FnAST = static_cast<FunctionAST &>(Decl);
+    // Nothing calls a body that was never materialized.
+    if (!FnAST.hasBody())
+      return nullptr;
+    return lowerFunction(FnAST);
+  }
+
+  if (Decl.getKind() == ASTKind::Import) {
+    importModule(static_cast<ImportAST &>(Decl).getModuleName());
+    return nullptr;
+  }
+
+  auto &Proto = static_cast<PrototypeAST &>(Decl);
+  return declareFunction(Proto.getName(), Proto.getParams());
+}
+
+void IRGenerator::lower(CompilationUnit &Unit) {
+  std::vector<Function *> Fns;
+  std::vector<FunctionAST *> Bodies;
+  for (auto *Decl : Unit.getDecls()) {
+    if (Decl->getKind() != ASTKind::Function) {
+      lower(*Decl);
+      continue;
+    }
+
+    auto &FnAST = static_cast<FunctionAST &>(*Decl);
+    if (!FnAST.hasBody())
+      continue;
+    auto &Proto = FnAST.getProto();
+    Fns.push_back(defineFunction(Proto.getName(), Proto.getParams()));
+    Bodies.push_back(&FnAST);
+  }
+
+  lowerBodies(Fns, [&](size_t I) { lowerBody(*Fns[I], *Bodies[I]); });
+}
+
+//===----------------------------------------------------------------------===//
+// FunctionLowering
+//===----------------------------------------------------------------------===//
+
+void FunctionLowering::visit(BlockStmtAST &Block) {
+  auto ScopeGuard = Ctx.getScope().openNewScope();
+  for (auto *Stmt : Block.getStmts())
+    walk(*Stmt);
+}
+
+void FunctionLowering::visit(IfStmtAST &If) {
+  auto Blocks = Ctx.beginIf(Exprs.lower(If.getCond()), If.getElse());
+  walk(If.getThen());
+
+  if (auto *Else = If.getElse()) {
+    Ctx.beginElse(Blocks);
+    walk(*Else);
+  }
+
+  Ctx.endIf(Blocks);
+}
+
+void FunctionLowering::visit(WhileStmtAST &While) {
+  auto Blocks = Ctx.beginWhile();
+  Ctx.beginWhileBody(Blocks, Exprs.lower(While.getCond()));
+
+  walk(While.getBody());
+  Ctx.endWhile(Blocks);
+}
+
+void FunctionLowering::visit(VarStmtAST &Var) {
+  auto *LocalVar = Ctx.lowerVarDecl(Var.getVarName());
+  if (auto *Init = Var.getInit())
+    Ctx.lowerVarInit(LocalVar, Exprs.lower(*Init));
+}
+
+void FunctionLowering::visit(ReturnStmtAST &Return) {
+  auto *Expr = Return.getExpr();
+  Ctx.lowerReturn(Expr ? Exprs.lower(*Expr) : nullptr);
+}
+
+void FunctionLowering::visit(ExprStmtAST &ExprStmt) {
+  Exprs.lower(ExprStmt.getExpr());
+}
+
+void FunctionLowering::visit(FunctionAST &FnAST) {
+  auto Guard = Ctx.getScope().openNewScope();
+  Ctx.bindParams(FnAST.getProto().getParams());
+
+  walk(FnAST.getBody());
+  Ctx.finish();
+}
+
+//===----------------------------------------------------------------------===//
+// ExprLowering
+//===----------------------------------------------------------------------===//
+
+Value *ExprLowering::lower(ExprAST &Root) {
+  size_t FrameBase = Frames.size();
+  Frames.push_back({&Root, 0});
+
+  // A node stays on Frames until all of its operands have been lowered, in
+  // order, with their values on top of Values; then it is lowered itself.
+  while (Frames.size() > FrameBase) {
+    auto [E, NextOperand] = Frames.back();
+    ExprAST *Operand = nullptr;
+    Value *Result = nullptr;
+
+    switch (E->getKind()) {
+    case ASTKind::Number:
+      Result = Ctx.lowerNumber(static_cast<NumberExprAST *>(E)->getVal());
+      break;
+    case ASTKind::Variable:
+      Result =
+          Ctx.lowerVariable(static_cast<VariableExprAST *>(E)->getName());
+      break;
+    case ASTKind::Unary: {
+      auto *Unary = static_cast<UnaryExprAST *>(E);
+      if (NextOperand == 0) {
+        Operand = &Unary->getOperand();
+        break;
+      }
+      Result = Ctx.lowerUnary(Unary->getOpcode(), Values.back());
+      Values.pop_back();
+      break;
+    }
+    case ASTKind::Binary: {
+      auto *Binary = static_cast<BinaryExprAST *>(E);
+      if (NextOperand < 2) {
+        Operand = NextOperand == 0 ? &Binary->getLHS() : &Binary->getRHS();
+        break;
+      }
+      auto *RHS = Values.back();
+      Values.pop_back();
+      Result = Ctx.lowerBinary(Binary->getOpcode(), Values.back(), RHS);
+      Values.pop_back();
+      break;
+    }
+    case ASTKind::Call: {
+      auto *Call = static_cast<CallExprAST *>(E);
+      auto Args = Call->getArgs();
+      // Load each argument right after it has been lowered.
+      if (NextOperand != 0)
+        Values.back() = Ctx.rvalue(Values.back());
+      if (NextOperand < Args.size()) {
+        Operand = Args[NextOperand];
+        break;
+      }
+      auto First = Values.end() - static_cast<ptrdiff_t>(Args.size());
+      std::vector<Value *> ArgValues(First, Values.end());
+      Values.erase(First, Values.end());
+      Result = Ctx.lowerCall(Call->getCallee(), std::move(ArgValues));
+      break;
+    }
+    default: assert(false && "Not an expression");
+    }
+
+    if (Operand != nullptr) {
+      ++Frames.back().NextOperand;
+      Frames.push_back({Operand, 0});
+    } else {
+      Frames.pop_back();
+      Values.push_back(Result);
+    }
+  }
+
+  auto *Result = Values.back();
+  Values.pop_back();
+  return Result;
+}
+
+//===----------------------------------------------------------------------===//
+// FunctionVisitor and ExprVisitor
+//
+// The same lowering with virtual double dispatch, for Dispatch::Virtual.
+//===----------------------------------------------------------------------===//
+
+void FunctionVisitor::visit(BlockStmtAST &Block) {
+  // Open a new scope
+  auto ScopeGuard = Ctx.getScope().openNewScope();
+  for (const auto &Stmt : Block.getStmts())
+    Stmt->accept(*this);
+}
+
+void FunctionVisitor::visit(IfStmtAST &If) {
+  ExprVisitor CondVisitor(Ctx);
+  If.getCond().accept(CondVisitor);
+
+  auto Blocks = Ctx.beginIf(CondVisitor.getResult(), If.getElse());
+  If.getThen().accept(*this);
+
+  if (auto *Else = If.getElse()) {
+    Ctx.beginElse(Blocks);
+    Else->accept(*this);
+  }
+
+  Ctx.endIf(Blocks);
+}
+
+void FunctionVisitor::visit(WhileStmtAST &While) {
+  auto Blocks = Ctx.beginWhile();
+
+  ExprVisitor CondVisitor(Ctx);
   While.getCond().accept(CondVisitor);
-  Fn.emit<CJumpInst>(CondVisitor.getResult(), LoopBB, FinalBB);
+  Ctx.beginWhileBody(Blocks, CondVisitor.getResult());
 
-  Fn.setInsertPoint(LoopBB);
   While.getBody().accept(*this);
-  Fn.emit<JumpInst>(CondBB);
-
-  Fn.setInsertPoint(FinalBB);
+  Ctx.endWhile(Blocks);
 }
 
 void FunctionVisitor::visit(VarStmtAST &Var) {
-  Instruction *Alloca = Fn.emit<AllocaInst>(std::string(Var.getVarName()));
-  NS.update(std::string(Var.getVarName()), Alloca);
+  auto *LocalVar = Ctx.lowerVarDecl(Var.getVarName());
 
   auto *Expr = Var.getInit();
   if (!Expr)
     return;
 
-  ExprVisitor V(IRUnit, NS, Fn);
+  ExprVisitor V(Ctx);
   Expr->accept(V);
-  Fn.emit<StoreInst>(Alloca, V.getResult());
+  Ctx.lowerVarInit(LocalVar, V.getResult());
 }
 
 void FunctionVisitor::visit(ReturnStmtAST &Return) {
   if (auto *Expr = Return.getExpr()) {
-    ExprVisitor V(IRUnit, NS, Fn);
+    ExprVisitor V(Ctx);
     Expr->accept(V);
-    Fn.emit<ReturnInst>(V.getResult());
+    Ctx.lowerReturn(V.getResult());
   } else {
-    Fn.emit<ReturnInst>(Fn.makeConstant(0));
+    Ctx.lowerReturn(nullptr);
   }
 }
 
 void FunctionVisitor::visit(ExprStmtAST &ExprStmt) {
-  ExprVisitor V(IRUnit, NS, Fn);
+  ExprVisitor V(Ctx);
   ExprStmt.getExpr().accept(V);
 }
 
 void FunctionVisitor::visit(FunctionAST &FnAST) {
-  const auto &Params = FnAST.getProto().getParams();
-  const auto &ParamsValue = Fn.getArgs();
-  assert(Params.size() == ParamsValue.size());
-
-  auto Guard = NS.openNewScope();
-  for (size_t I = 0; I < Params.size(); ++I)
-    NS.update(Params[I].first, ParamsValue[I].get());
+  auto Guard = Ctx.getScope().openNewScope();
+  Ctx.bindParams(FnAST.getProto().getParams());
 
   FnAST.getBody().accept(*this);
+  Ctx.finish();
 }
 
 void ExprVisitor::visit(NumberExprAST &NumAST) {
-  Result = Fn.makeConstant(NumAST.getVal());
+  Result = Ctx.lowerNumber(NumAST.getVal());
 }
 
 void ExprVisitor::visit(VariableExprAST &Var) {
-  Result = NS.lookup(Var.getName());
+  Result = Ctx.lowerVariable(Var.getName());
 }
 
 void ExprVisitor::visit(UnaryExprAST &Unary) {
-  ExprVisitor V(IRUnit, NS, Fn);
+  ExprVisitor V(Ctx);
   Unary.getOperand().accept(V);
-  auto *Operand = V.getResult();
-  switch (Unary.getOpcode()) {
-  case '-':
-    Result = Fn.emit<ArithmeticInst>(ArithmeticInst::Opcode::Sub,
-                                     Fn.makeConstant(0), Operand);
-    break;
-  default: assert(false && "Unknown unary operator");
-  }
+  Result = Ctx.lowerUnary(Unary.getOpcode(), V.getResult());
 }
 
 void ExprVisitor::visit(BinaryExprAST &Binary) {
-  ExprVisitor LHSVisitor(IRUnit, NS, Fn);
-  ExprVisitor RHSVisitor(IRUnit, NS, Fn);
+  ExprVisitor LHSVisitor(Ctx);
+  ExprVisitor RHSVisitor(Ctx);
   Binary.getLHS().accept(LHSVisitor);
   Binary.getRHS().accept(RHSVisitor);
-  auto *LHS = LHSVisitor.getResult();
-  auto *RHS = RHSVisitor.getResult();
-
-  if (Binary.getOpcode() != '=') {
-    if (LHS->isLValue())
-      LHS = Fn.emit<LoadInst>(LHS);
-  }
-  if (RHS->isLValue())
-    RHS = Fn.emit<LoadInst>(RHS);
-
-  switch (Binary.getOpcode()) {
-  case '+':
-    Result = Fn.emit<ArithmeticInst>(ArithmeticInst::Opcode::Add, LHS, RHS);
-    break;
-  case '-':
-    Result = Fn.emit<ArithmeticInst>(ArithmeticInst::Opcode::Sub, LHS, RHS);
-    break;
-  case '*':
-    Result = Fn.emit<ArithmeticInst>(ArithmeticInst::Opcode::Mul, LHS, RHS);
-    break;
-  case '=':
-    Fn.emit<StoreInst>(LHS, RHS);
-    Result = RHS;
-    break;
-  default: assert(false && "Unknown binary operator");
-  }
+  Result = Ctx.lowerBinary(Binary.getOpcode(), LHSVisitor.getResult(),
+                           RHSVisitor.getResult());
 }
 
 void ExprVisitor::visit(CallExprAST &Call) {
-  auto *Callee = IRUnit.lookupFunction(Call.getCallee());
   std::vector<Value *> Args;
   for (const auto &Arg : Call.getArgs()) {
-    ExprVisitor V(IRUnit, NS, Fn);
+    ExprVisitor V(Ctx);
     Arg->accept(V);
-    auto *Result = V.getResult();
-    if (Result->isLValue())
-      Result = Fn.emit<LoadInst>(Result);
-    Args.push_back(Result);
+    Args.push_back(Ctx.rvalue(V.getResult()));
   }
-  Fn.emit<CallInst>(Callee, std::move(Args));
+  Result = Ctx.lowerCall(Call.getCallee(), std::move(Args));
 }
 
 } // namespace irgen
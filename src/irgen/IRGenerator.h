@@ -1,89 +1,308 @@
 #ifndef TOY_LANG_IRGEN_IRGEN_H
 #define TOY_LANG_IRGEN_IRGEN_H
 
-#include <map>
-#include <ranges>
+#include <functional>
+#include <set>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "ir/Function.h"
+#include "ir/IRBuilder.h"
 #include "ir/IRCompilationUnit.h"
 #include "ir/Value.h"
+#include "irgen/SSABuilder.h"
 #include "parser/AST.h"
 #include "parser/ASTVisitor.h"
+#include "parser/ASTWalker.h"
+#include "parser/FlatAST.h"
+#include "support/Symbol.h"
 
 namespace irgen {
 
+/// NestedScope - The variables visible at the current point of a function.
+/// Rather than a table per scope, it keeps one open-addressing hash table from
+/// each name to its innermost binding. Binding a name pushes the binding it
+/// shadows onto an undo log, and closing a scope pops the log back to where
+/// it was when the scope was opened. A lookup therefore costs the same at any
+/// depth, and opening a scope allocates nothing.
 class NestedScope {
 public:
   class ScopeGuard {
   public:
-    ScopeGuard(NestedScope &Host) : Host(&Host) {}
+    ScopeGuard(NestedScope &Host, size_t Mark) : Host(&Host), Mark(Mark) {}
 
     ScopeGuard(const ScopeGuard &) = delete;
     ScopeGuard &operator=(const ScopeGuard &) = delete;
 
     ScopeGuard(ScopeGuard &&Other) noexcept {
       std::swap(this->Host, Other.Host);
+      std::swap(this->Mark, Other.Mark);
     }
     ScopeGuard &operator=(ScopeGuard &&Other) noexcept {
       std::swap(this->Host, Other.Host);
+      std::swap(this->Mark, Other.Mark);
       return *this;
     }
 
     ~ScopeGuard() {
       if (Host != nullptr)
-        Host->popScope();
+        Host->popScope(Mark);
     }
 
   private:
     NestedScope *Host = nullptr;
-    ;
+    size_t Mark = 0;
   };
 
-  NestedScope() { ScopeStack.emplace_back(); }
+  NestedScope() : Table(InitialCapacity) {}
 
   [[nodiscard]] ScopeGuard openNewScope() {
-    ScopeStack.emplace_back();
-    return ScopeGuard(*this);
+    return ScopeGuard(*this, UndoLog.size());
   }
 
-  void popScope() { ScopeStack.pop_back(); }
+  /// Restore the bindings that were shadowed since the undo log had \p Mark
+  /// entries.
+  void popScope(size_t Mark);
 
-  Value *lookup(const std::string &Name) const {
-    for (const auto &Iter : std::ranges::reverse_view(ScopeStack)) {
-      if (auto Result = Iter.find(Name); Result != Iter.end())
-        return Result->second;
-    }
-
-    return nullptr;
+  Value *lookup(Symbol Name) const {
+    return Table[findSlot(Name)].Binding;
   }
 
-  void update(std::string Name, Value *Value) {
-    ScopeStack.back()[std::move(Name)] = Value;
+  void update(Symbol Name, Value *Value);
+
+private:
+  /// A name that has been bound at some point. Closing the scope of its only
+  /// binding leaves the entry behind with a null Binding, so nothing is ever
+  /// erased and probing needs no tombstones.
+  struct Entry {
+    Symbol Name;
+    Value *Binding = nullptr;
+  };
+
+  static constexpr size_t InitialCapacity = 64;
+
+  /// The slot for \p Name, or the empty slot where it would go. The empty
+  /// Symbol marks empty slots, since no variable can have that name.
+  size_t findSlot(Symbol Name) const {
+    size_t Mask = Table.size() - 1;
+    // Symbol IDs are dense, and multiplying by an odd constant spreads them
+    // over the low bits.
+    size_t I = (Name.getID() * 0x9E3779B9u) & Mask;
+    while (Table[I].Name != Name && !Table[I].Name.empty())
+      I = (I + 1) & Mask;
+    return I;
   }
 
+  void grow();
+
+  /// Power-of-two sized, and kept at most half full.
+  std::vector<Entry> Table;
+  size_t NumNames = 0;
+  /// Each binding that was shadowed, and the name it belongs to.
+  std::vector<std::pair<Symbol, Value *>> UndoLog;
+};
+
+/// LoweringContext - The IR each kind of AST construct lowers to, for one
+/// function. The traversals of the pointer-based AST and of the FlatAST only
+/// decide the order in which subtrees are lowered, and leave the actual code
+/// to this class, so they always produce the same IR.
+///
+/// Variables are lvalues that SSABuilder resolves to the values they hold,
+/// so the IR is in SSA form from the start and never uses memory for them.
+/// Arithmetic is emitted through an IRBuilder, which folds it where it can.
+class LoweringContext {
+public:
+  LoweringContext(IRCompilationUnit &IRUnit, Function &Fn)
+      : IRUnit(IRUnit),
+        Fn(Fn),
+        Builder(Fn),
+        SSA(Fn) {}
+
+  NestedScope &getScope() { return NS; }
+
+  /// Make the parameters visible under their names. This starts the body.
+  void bindParams(std::span<const std::pair<Symbol, Symbol>> Params);
+
+  /// Finish the body once all of it has been lowered.
+  void finish() { SSA.finish(); }
+
+  /// Read the variable \p V if it is an lvalue.
+  Value *rvalue(Value *V);
+
+  Value *lowerNumber(int64_t Val);
+  Value *lowerVariable(Symbol Name);
+  Value *lowerUnary(char Opcode, Value *Operand);
+  Value *lowerBinary(char Opcode, Value *LHS, Value *RHS);
+  /// \p Args must already be rvalues.
+  Value *lowerCall(Symbol Callee, std::vector<Value *> Args);
+
+  /// Declare a variable in the innermost scope and return it.
+  Value *lowerVarDecl(Symbol Name);
+  void lowerVarInit(Value *Var, Value *Init);
+
+  /// \p Val is null for a bare 'return'.
+  void lowerReturn(Value *Val);
+
+  struct IfBlocks {
+    BasicBlock *Then, *Else, *Final;
+  };
+
+  /// Branch on \p Cond and continue in the then block.
+  IfBlocks beginIf(Value *Cond, bool HasElse);
+  /// Close the then block and continue in the else block.
+  void beginElse(const IfBlocks &Blocks);
+  /// Close the last branch and continue after the if.
+  void endIf(const IfBlocks &Blocks);
+
+  struct WhileBlocks {
+    BasicBlock *Cond, *Loop, *Final;
+  };
+
+  /// Continue in the block that evaluates the condition.
+  WhileBlocks beginWhile();
+  /// Branch on \p Cond and continue in the loop body.
+  void beginWhileBody(const WhileBlocks &Blocks, Value *Cond);
+  /// Close the body and continue after the loop.
+  void endWhile(const WhileBlocks &Blocks);
+
 private:
-  std::vector<std::map<std::string, Value *>> ScopeStack;
+  /// Branch to \p Dest from the current block.
+  void jump(BasicBlock *Dest);
+
+  void assign(Value *Var, Value *Val);
+
+  IRCompilationUnit &IRUnit;
+  Function &Fn;
+  /// Each function has its own scopes, so that functions can be lowered on
+  /// different threads.
+  NestedScope NS;
+  /// Arithmetic goes through the builder, so that the IR is already folded.
+  IRBuilder Builder;
+  SSABuilder SSA;
 };
 
-class IRGenerator : public ASTVisitor {
+class IRGenerator {
 public:
-  void visit(PrototypeAST &ProtoAST) override;
-  void visit(FunctionAST &FnAST) override;
-  void visit(CompilationUnit &Unit) override;
+  /// How function bodies of the pointer-based AST are traversed. Static uses
+  /// FunctionLowering; Virtual uses the older FunctionVisitor, which is kept
+  /// to measure the two against each other.
+  enum class Dispatch { Static, Virtual };
+
+  explicit IRGenerator(Dispatch D = Dispatch::Static) : D(D) {}
+
+  /// Lower the function bodies of a whole unit on \p NumThreads threads, or
+  /// one per hardware thread if it is 0. The IR is the same either way.
+  void setNumThreads(unsigned NumThreads) { this->NumThreads = NumThreads; }
+
+  /// Lower one top-level declaration and return the function it declares or
+  /// defines. A lazily parsed function that was never materialized is left
+  /// out, and yields null, as does an import.
+  Function *lower(TopLevelDeclarationAST &Decl);
+
+  /// Lower every declaration of \p Unit. All of them are declared first, so
+  /// that the bodies can then be lowered in parallel, and may call functions
+  /// that are defined after them.
+  void lower(CompilationUnit &Unit);
+
+  /// Lower every declaration of \p Tree, exactly as if it had been parsed
+  /// into a CompilationUnit.
+  void lower(const FlatAST &Tree);
 
   IRCompilationUnit &getIR() { return IRUnit; }
 
+  /// Add a directory to search for the summaries of imported modules. They
+  /// are searched in the order they were added.
+  void addImportPath(std::string Dir) { ImportPaths.push_back(std::move(Dir)); }
+
+  /// Whether any module has been imported.
+  bool hasImports() const { return !Imported.empty(); }
+
+  /// Number of imports that could not be resolved.
+  size_t getNumErrors() const { return NumErrors; }
+
 private:
-  Function *makeFunction(PrototypeAST &ProtoAST);
+  Function *
+  declareFunction(Symbol Name,
+                  std::span<const std::pair<Symbol, Symbol>> Params);
+
+  /// Declare a function and open its entry block. A definition in this
+  /// module replaces a body imported for the same name.
+  Function *
+  defineFunction(Symbol Name,
+                 std::span<const std::pair<Symbol, Symbol>> Params);
+
+  /// Declare the functions of module \p Name from its summary.
+  void importModule(Symbol Name);
+
+  Function *lowerFunction(FunctionAST &FnAST);
+  void lowerBody(Function &Fn, FunctionAST &FnAST);
+
+  /// Call \p LowerBody for each of the \p Fns, whose bodies are lowered by
+  /// it, on as many threads as were asked for.
+  void lowerBodies(std::span<Function *const> Fns,
+                   const std::function<void(size_t)> &LowerBody);
 
 private:
   IRCompilationUnit IRUnit;
-  NestedScope NS;
+  Dispatch D;
+  unsigned NumThreads = 1;
+
+  std::vector<std::string> ImportPaths;
+  std::set<Symbol> Imported;
+  size_t NumErrors = 0;
+};
+
+/// ExprLowering - Lowers expression trees. It walks them in post-order with
+/// explicit stacks instead of recursion, so there is no limit on how deeply
+/// expressions may nest.
+class ExprLowering {
+public:
+  ExprLowering(LoweringContext &Ctx) : Ctx(Ctx) {}
+
+  /// Lower \p E and return the Value it evaluates to.
+  Value *lower(ExprAST &E);
+
+private:
+  LoweringContext &Ctx;
+
+  /// A node and how many of its operands have been pushed so far.
+  struct Frame {
+    ExprAST *E;
+    size_t NextOperand;
+  };
+  std::vector<Frame> Frames;
+  /// Values of the lowered operands that are waiting for their parents.
+  std::vector<Value *> Values;
+};
+
+/// FunctionLowering - Lowers the body of one function with static dispatch.
+class FunctionLowering : public ASTWalker<FunctionLowering> {
+public:
+  FunctionLowering(IRCompilationUnit &IRUnit, Function &Fn)
+      : Ctx(IRUnit, Fn),
+        Exprs(Ctx) {}
+
+  void visit(BlockStmtAST &Block);
+  void visit(IfStmtAST &If);
+  void visit(WhileStmtAST &While);
+  void visit(VarStmtAST &Var);
+  void visit(ReturnStmtAST &Return);
+  void visit(ExprStmtAST &ExprStmt);
+  void visit(FunctionAST &FnAST);
+
+private:
+  LoweringContext Ctx;
+  ExprLowering Exprs;
 };
 
+/// FunctionVisitor - FunctionLowering with virtual double dispatch, used for
+/// Dispatch::Virtual.
 class FunctionVisitor : public ASTVisitor {
 public:
-  FunctionVisitor(IRCompilationUnit &IRUnit, NestedScope &NS, Function &Fn);
+  FunctionVisitor(IRCompilationUnit &IRUnit, Function &Fn)
+      : Ctx(IRUnit, Fn) {}
 
   void visit(BlockStmtAST &) override;
   void visit(IfStmtAST &) override;
@@ -94,17 +313,12 @@ public:
   void visit(FunctionAST &FnAST) override;
 
 private:
-  IRCompilationUnit &IRUnit;
-  NestedScope &NS;
-  Function &Fn;
+  LoweringContext Ctx;
 };
 
 class ExprVisitor : public ASTVisitor {
 public:
-  ExprVisitor(IRCompilationUnit &IRUnit, NestedScope &NS, Function &Fn)
-      : IRUnit(IRUnit),
-        NS(NS),
-        Fn(Fn) {}
+  ExprVisitor(LoweringContext &Ctx) : Ctx(Ctx) {}
 
   Value *getResult() { return Result; }
 
@@ -115,9 +329,7 @@ public:
   void visit(CallExprAST &Call) override;
 
 private:
-  IRCompilationUnit &IRUnit;
-  NestedScope &NS;
-  Function &Fn;
+  LoweringContext &Ctx;
   Value *Result = nullptr;
 };
 
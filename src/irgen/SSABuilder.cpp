@@ -0,0 +1,167 @@
+#include "irgen/SSABuilder.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace irgen {
+
+LocalVariable *SSABuilder::makeVariable(Symbol Name) {
+  Variables.push_back(std::make_unique<LocalVariable>(Name));
+  return Variables.back().get();
+}
+
+SSABuilder::~SSABuilder() {
+  for (auto *P : Removed)
+    P->destroy();
+}
+
+void SSABuilder::growBlocks() {
+  if (Blocks.size() < Fn.getNumBlockIDs())
+    Blocks.resize(Fn.getNumBlockIDs());
+}
+
+void SSABuilder::addEdge(BasicBlock *From, BasicBlock *To) {
+  growBlocks();
+  auto &State = Blocks[To->getID()];
+  assert(!State.Sealed && "Adding a predecessor to a sealed block");
+  State.Preds.push_back(From);
+}
+
+void SSABuilder::sealBlock(BasicBlock *BB) {
+  growBlocks();
+  auto &State = Blocks[BB->getID()];
+  assert(!State.Sealed && "Block sealed twice");
+  State.Sealed = true;
+
+  Pending.insert(Pending.end(), State.IncompletePhis.begin(),
+                 State.IncompletePhis.end());
+  State.IncompletePhis.clear();
+  completePhis();
+}
+
+void SSABuilder::writeVariable(LocalVariable *Var, BasicBlock *BB,
+                               Value *Val) {
+  Var->CurrentDef[BB] = Val;
+}
+
+Value *SSABuilder::readVariable(LocalVariable *Var, BasicBlock *BB) {
+  growBlocks();
+  auto *Val = lookup(Var, BB);
+  completePhis();
+  return resolve(Val);
+}
+
+Value *SSABuilder::lookup(LocalVariable *Var, BasicBlock *BB) {
+  // Walk up through blocks with a single predecessor until the definition
+  // or a join is found, and then remember the result in each of them.
+  std::vector<BasicBlock *> Path;
+  Value *Val = nullptr;
+  while (true) {
+    if (auto It = Var->CurrentDef.find(BB); It != Var->CurrentDef.end()) {
+      Val = It->second = resolve(It->second);
+      break;
+    }
+
+    auto &State = Blocks[BB->getID()];
+    if (!State.Sealed) {
+      auto *Phi = makePhi(BB);
+      State.IncompletePhis.emplace_back(Var, Phi);
+      Val = Phi;
+    } else if (State.Preds.empty()) {
+      Val = undef();
+    } else if (State.Preds.size() == 1) {
+      Path.push_back(BB);
+      BB = State.Preds.front();
+      continue;
+    } else {
+      // The phi is the definition while its operands are looked up, which
+      // ends the search when it comes around a loop.
+      auto *Phi = makePhi(BB);
+      Pending.emplace_back(Var, Phi);
+      Val = Phi;
+    }
+    writeVariable(Var, BB, Val);
+    break;
+  }
+
+  for (auto *Block : Path)
+    writeVariable(Var, Block, Val);
+  return Val;
+}
+
+PhiInst *SSABuilder::makePhi(BasicBlock *BB) {
+  auto *Phi = Fn.makePhi(BB);
+  if (CompletePhis.size() <= Phi->getID())
+    CompletePhis.resize(Fn.getNumValueIDs());
+  return Phi;
+}
+
+void SSABuilder::completePhis() {
+  while (!Pending.empty()) {
+    auto [Var, Phi] = Pending.back();
+    Pending.pop_back();
+
+    for (auto *Pred : Blocks[Phi->getParent()->getID()].Preds)
+      Phi->addIncoming(lookup(Var, Pred), Pred);
+    CompletePhis[Phi->getID()] = true;
+    tryRemoveTrivialPhi(Phi);
+  }
+}
+
+void SSABuilder::tryRemoveTrivialPhi(PhiInst *Phi) {
+  std::vector<PhiInst *> Worklist{Phi};
+  while (!Worklist.empty()) {
+    auto *P = Worklist.back();
+    Worklist.pop_back();
+    if (resolve(P) != P || !CompletePhis[P->getID()])
+      continue;
+
+    Value *Same = nullptr;
+    bool Trivial = true;
+    for (auto &Op : P->operands()) {
+      if (Op == Same || Op == P)
+        continue;
+      if (Same != nullptr) {
+        Trivial = false;
+        break;
+      }
+      Same = Op;
+    }
+    if (!Trivial)
+      continue;
+
+    // A phi that only merges itself is in a block no definition reaches.
+    if (Same == nullptr)
+      Same = undef();
+    if (Replaced.size() <= P->getID())
+      Replaced.resize(Fn.getNumValueIDs());
+    Replaced[P->getID()] = Same;
+
+    // The phis that use P will use Same instead, and may become trivial.
+    for (auto *U = P->getFirstUse(); U != nullptr; U = U->getNext())
+      if (auto *User = dyn_cast<PhiInst>(U->getUser()); User && User != P)
+        Worklist.push_back(User);
+    P->replaceAllUsesWith(Same);
+
+    P->removeFromParent();
+    P->dropAllReferences();
+    Removed.push_back(P);
+  }
+}
+
+Value *SSABuilder::resolve(Value *V) {
+  while (V->getID() < Replaced.size() && Replaced[V->getID()] != nullptr)
+    V = Replaced[V->getID()];
+  return V;
+}
+
+Value *SSABuilder::undef() { return Fn.makeConstant(0); }
+
+void SSABuilder::finish() {
+  assert(Pending.empty());
+  assert(std::all_of(Blocks.begin(), Blocks.end(),
+                     [](const auto &State) { return State.Sealed; }) &&
+         "Every block must be sealed");
+}
+
+} // namespace irgen
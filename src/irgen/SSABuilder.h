@@ -0,0 +1,122 @@
+#ifndef TOY_LANG_IRGEN_SSA_BUILDER_H
+#define TOY_LANG_IRGEN_SSA_BUILDER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ir/Function.h"
+#include "ir/PhiInst.h"
+#include "ir/Value.h"
+#include "support/Symbol.h"
+
+namespace irgen {
+
+/// LocalVariable - A parameter or local variable of the function being
+/// lowered. It is not part of the IR, but stands for the variable in the
+/// scope, as an lvalue, until it is read or assigned.
+class LocalVariable : public Value {
+public:
+  LocalVariable(Symbol Name) : Value(ValueKind::Variable, Name) {}
+
+  static bool classof(const Value *V) {
+    return V->getKind() == ValueKind::Variable;
+  }
+
+private:
+  friend class SSABuilder;
+
+  /// The value of the variable at the end of each block where it is known.
+  std::unordered_map<BasicBlock *, Value *> CurrentDef;
+};
+
+/// SSABuilder - Puts the variables of one function into SSA form while the
+/// function is being lowered, so that they never need memory. This follows
+/// Braun et al., "Simple and Efficient Construction of Static Single
+/// Assignment Form" (CC 2013).
+///
+/// Assigning a variable makes the value its current definition in the
+/// current block. Reading it looks for the definition in the block, and
+/// otherwise in the predecessors, with a phi where several of them meet. A
+/// block whose predecessors are not all known yet, like a loop header before
+/// the back edge has been lowered, is not sealed, and reading from it leaves
+/// an incomplete phi that sealing fills in. Phis that turn out to merge a
+/// single value are removed again. A variable that is read before it is
+/// assigned is 0.
+class SSABuilder {
+public:
+  SSABuilder(Function &Fn) : Fn(Fn) {}
+  ~SSABuilder();
+
+  LocalVariable *makeVariable(Symbol Name);
+
+  /// Record that control can go from \p From to \p To, which must not be
+  /// sealed yet.
+  void addEdge(BasicBlock *From, BasicBlock *To);
+
+  /// Declare that all the predecessors of \p BB have been added.
+  void sealBlock(BasicBlock *BB);
+
+  void writeVariable(LocalVariable *Var, BasicBlock *BB, Value *Val);
+  Value *readVariable(LocalVariable *Var, BasicBlock *BB);
+
+  /// Check that the function is complete. Every block must be sealed by
+  /// then.
+  void finish();
+
+private:
+  struct BlockState {
+    std::vector<BasicBlock *> Preds;
+    /// Phis made while the block was not sealed, for sealing to complete.
+    std::vector<std::pair<LocalVariable *, PhiInst *>> IncompletePhis;
+    bool Sealed = false;
+  };
+
+  /// Cover the blocks made since the last call in the table of blocks. Blocks
+  /// are only made between calls, so references into the table stay valid
+  /// while a call runs.
+  void growBlocks();
+
+  /// readVariable without completing the phis it makes.
+  Value *lookup(LocalVariable *Var, BasicBlock *BB);
+
+  PhiInst *makePhi(BasicBlock *BB);
+
+  /// Give the phis in Pending their operands, and remove those that turn out
+  /// to be trivial.
+  void completePhis();
+
+  /// Remove \p Phi if it merges only one value, and then the phis that use
+  /// it if that makes them trivial.
+  void tryRemoveTrivialPhi(PhiInst *Phi);
+
+  /// The value that \p V was replaced by, if it is a removed phi.
+  Value *resolve(Value *V);
+
+  Value *undef();
+
+  Function &Fn;
+  std::vector<std::unique_ptr<LocalVariable>> Variables;
+  /// The tables are indexed by the IDs of blocks and of values.
+  std::vector<BlockState> Blocks;
+  /// Whether each phi made here has been given its operands.
+  std::vector<bool> CompletePhis;
+
+  /// Phis that need their operands, and the variables they are for. They are
+  /// completed with a worklist rather than by recursion, since a read may
+  /// have to look through arbitrarily many blocks.
+  std::vector<std::pair<LocalVariable *, PhiInst *>> Pending;
+
+  /// What each removed phi was replaced by. The uses in instructions are
+  /// replaced right away, but a variable's current definitions may still
+  /// name a removed phi, so the removed phis are only destroyed along with
+  /// the builder.
+  std::vector<Value *> Replaced;
+  std::vector<PhiInst *> Removed;
+};
+
+} // namespace irgen
+
+#endif // !TOY_LANG_IRGEN_SSA_BUILDER_H
@@ -0,0 +1,194 @@
+#include "opt/CallFolder.h"
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "ir/AllocaInst.h"
+#include "ir/BranchInst.h"
+#include "ir/CallInst.h"
+#include "ir/IRVisitor.h"
+#include "ir/PhiInst.h"
+#include "opt/CallSites.h"
+
+namespace opt {
+
+namespace {
+
+/// Interpreter - Runs the IR of pure functions on constant arguments.
+///
+/// A frame maps every value of the running function, by ID, to an integer:
+/// the contents for an alloca, which is an lvalue, and the value for anything
+/// else. Blocks without a terminator fall through to the next one, as in the
+/// generated code.
+class Interpreter : public IRVisitor<Interpreter> {
+public:
+  using IRVisitor::visit;
+
+  /// Run \p Fn on \p Args. Returns nothing if \p Fn is not a pure function
+  /// with a body, or if the limits are exceeded.
+  std::optional<int64_t> call(Function &Fn, std::span<const int64_t> Args) {
+    if (Fn.getEntryBlock() == nullptr || !Fn.isPure() ||
+        Fn.getArgs().size() != Args.size() ||
+        Frames.size() == CallFolder::DepthLimit)
+      return std::nullopt;
+
+    Frames.emplace_back(Fn.getNumValueIDs());
+    for (size_t I = 0; I < Args.size(); ++I)
+      slot(Fn.getArgs()[I].get()) = Args[I];
+    for (auto *C : Fn.getConstants())
+      slot(C) = C->getVal();
+
+    std::optional<int64_t> Result;
+    BasicBlock *Prev = nullptr;
+    for (auto *BB = Fn.getEntryBlock(); BB != nullptr && !Failed && !Result;) {
+      auto Iter = enterBlock(*BB, Prev);
+      Next = nullptr;
+      for (; Iter != BB->end(); ++Iter) {
+        if (++Steps > CallFolder::StepLimit)
+          Failed = true;
+        if (!Failed)
+          visit(*Iter);
+        if (Failed || Next != nullptr || Returned) {
+          Result = Returned;
+          Returned.reset();
+          break;
+        }
+      }
+
+      Prev = BB;
+      BB = Next != nullptr ? Next : BB->getNextNode();
+    }
+
+    Frames.pop_back();
+    // Falling off the end of the function leaves Result empty.
+    if (Failed)
+      return std::nullopt;
+    return Result;
+  }
+
+  void visit(AllocaInst &Inst) { slot(&Inst) = 0; }
+
+  void visit(StoreInst &Inst) {
+    slot(Inst.getPtr()) = get(Inst.getVal());
+  }
+
+  void visit(LoadInst &Inst) {
+    slot(&Inst) = get(Inst.getPtr());
+  }
+
+  void visit(ArithmeticInst &Inst) {
+    // Wrap around like the machine does.
+    auto LHS = static_cast<uint64_t>(get(Inst.getLHS()));
+    auto RHS = static_cast<uint64_t>(get(Inst.getRHS()));
+    uint64_t Result = 0;
+    switch (Inst.getOpc()) {
+    case ArithmeticInst::Opcode::Add: Result = LHS + RHS; break;
+    case ArithmeticInst::Opcode::Sub: Result = LHS - RHS; break;
+    case ArithmeticInst::Opcode::Mul: Result = LHS * RHS; break;
+    }
+    slot(&Inst) = static_cast<int64_t>(Result);
+  }
+
+  void visit(CompareInst &Inst) {
+    slot(&Inst) = CompareInst::evaluate(Inst.getPred(), get(Inst.getLHS()),
+                                        get(Inst.getRHS()));
+  }
+
+  void visit(JumpInst &Inst) { Next = Inst.getDest(); }
+
+  void visit(CJumpInst &Inst) {
+    Next = get(Inst.getCond()) != 0 ? Inst.getTrueBB() : Inst.getFalseBB();
+  }
+
+  void visit(CallInst &Inst) {
+    std::vector<int64_t> Args;
+    for (Value *Arg : Inst.getArguments())
+      Args.push_back(get(Arg));
+    if (Failed || Inst.getCallee() == nullptr) {
+      Failed = true;
+      return;
+    }
+
+    auto Result = call(*Inst.getCallee(), Args);
+    if (!Result)
+      Failed = true;
+    else
+      slot(&Inst) = *Result;
+  }
+
+  void visit(ReturnInst &Inst) { Returned = get(Inst.getVal()); }
+
+private:
+  /// Give the phis at the top of \p BB their values for control coming from
+  /// \p Prev, all at once, and return the first instruction after them.
+  BasicBlock::iterator enterBlock(BasicBlock &BB, BasicBlock *Prev) {
+    auto Iter = BB.begin();
+    PhiValues.clear();
+    for (; Iter != BB.end() && isa<PhiInst>(*Iter); ++Iter) {
+      auto &Phi = cast<PhiInst>(*Iter);
+      auto *Val = Phi.getIncomingValueForBlock(Prev);
+      PhiValues.push_back(Val != nullptr ? get(Val) : 0);
+      Failed |= Val == nullptr;
+    }
+    auto Phi = BB.begin();
+    for (auto Val : PhiValues)
+      slot(&*Phi++) = Val;
+    return Iter;
+  }
+
+  std::optional<int64_t> &slot(Value *V) { return Frames.back()[V->getID()]; }
+
+  int64_t get(Value *V) {
+    auto &Slot = slot(V);
+    if (!Slot) {
+      Failed = true;
+      return 0;
+    }
+    return *Slot;
+  }
+
+  std::vector<std::vector<std::optional<int64_t>>> Frames;
+  std::vector<int64_t> PhiValues;
+  size_t Steps = 0;
+  bool Failed = false;
+
+  /// Where the current instruction transfers control, if anywhere.
+  BasicBlock *Next = nullptr;
+  std::optional<int64_t> Returned;
+};
+
+} // namespace
+
+PreservedAnalyses CallFolder::run(Function &Caller, AnalysisManager &) {
+  size_t NumFolded = 0;
+  for (auto [BB, Call] : collectCallSites(Caller)) {
+    auto *Callee = Call->getCallee();
+    if (Callee == nullptr || !Callee->isAvailableExternally() ||
+        !Callee->isPure())
+      continue;
+
+    std::vector<int64_t> Args;
+    for (Value *Arg : Call->getArguments()) {
+      auto *C = dyn_cast<Constant>(Arg);
+      if (C == nullptr)
+        break;
+      Args.push_back(C->getVal());
+    }
+    if (Args.size() != Call->getArguments().size())
+      continue;
+
+    auto Result = Interpreter().call(*Callee, Args);
+    if (!Result)
+      continue;
+
+    auto *Folded = Caller.makeConstant(*Result);
+    Call->replaceAllUsesWith(Folded);
+    BB->erase(Call);
+    ++NumFolded;
+  }
+  count("Calls folded", NumFolded);
+  return PreservedAnalyses::all();
+}
+
+} // namespace opt
@@ -0,0 +1,34 @@
+#ifndef TOY_LANG_OPT_CALL_FOLDER_H
+#define TOY_LANG_OPT_CALL_FOLDER_H
+
+#include <cstddef>
+
+#include "ir/Function.h"
+#include "opt/PassManager.h"
+
+namespace opt {
+
+/// CallFolder - Evaluates calls to imported pure functions whose arguments
+/// are all constants, and replaces each of them by its result.
+///
+/// The callee's IR is interpreted, so the result is the one the compiled
+/// code would compute, including wrap-around on overflow. A call that does
+/// not finish within a bounded number of steps is left alone.
+class CallFolder : public FunctionPass {
+public:
+  /// Instructions that evaluating one call may execute.
+  static constexpr size_t StepLimit = 1 << 16;
+
+  /// Nested calls that evaluating one call may make.
+  static constexpr size_t DepthLimit = 256;
+
+  std::string_view getName() const override { return "fold-calls"; }
+
+  /// Fold the eligible calls in \p Caller. Only calls are removed, so the
+  /// CFG and everything computed from it stay valid.
+  PreservedAnalyses run(Function &Caller, AnalysisManager &AM) override;
+};
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_CALL_FOLDER_H
@@ -0,0 +1,29 @@
+#ifndef TOY_LANG_OPT_CALL_SITES_H
+#define TOY_LANG_OPT_CALL_SITES_H
+
+#include <vector>
+
+#include "ir/CallInst.h"
+#include "ir/Function.h"
+
+namespace opt {
+
+/// CallSite - A call and the block that contains it.
+struct CallSite {
+  BasicBlock *BB;
+  CallInst *Call;
+};
+
+/// Every call in \p Fn, in the order of its blocks and instructions.
+inline std::vector<CallSite> collectCallSites(Function &Fn) {
+  std::vector<CallSite> Sites;
+  for (auto &BB : Fn.getBlocks())
+    for (auto &Inst : BB)
+      if (auto *Call = dyn_cast<CallInst>(&Inst))
+        Sites.push_back({&BB, Call});
+  return Sites;
+}
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_CALL_SITES_H
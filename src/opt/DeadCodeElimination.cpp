@@ -0,0 +1,39 @@
+#include "opt/DeadCodeElimination.h"
+
+#include <ranges>
+
+namespace opt {
+
+namespace {
+
+bool isTriviallyDead(Instruction &Inst) {
+  return Inst.use_empty() && !Inst.mayHaveSideEffects();
+}
+
+} // namespace
+
+PreservedAnalyses DeadCodeElimination::run(Function &Fn, AnalysisManager &) {
+  // Going backwards, the users of a value are usually deleted before the
+  // value is looked at. A value used by an earlier block, as in a loop, is
+  // only found dead on the next sweep.
+  size_t NumDeleted = 0;
+  for (bool Changed = true; Changed;) {
+    Changed = false;
+    for (auto &BB : std::ranges::reverse_view(Fn.getBlocks())) {
+      bool Found = false;
+      for (auto &Inst : std::ranges::reverse_view(BB))
+        if (isTriviallyDead(Inst)) {
+          Inst.dropAllReferences();
+          Found = true;
+        }
+      if (Found) {
+        NumDeleted += BB.eraseIf(isTriviallyDead);
+        Changed = true;
+      }
+    }
+  }
+  count("Instructions deleted", NumDeleted);
+  return PreservedAnalyses::all();
+}
+
+} // namespace opt
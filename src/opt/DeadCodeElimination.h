@@ -0,0 +1,25 @@
+#ifndef TOY_LANG_OPT_DEAD_CODE_ELIMINATION_H
+#define TOY_LANG_OPT_DEAD_CODE_ELIMINATION_H
+
+#include "ir/Function.h"
+#include "opt/PassManager.h"
+
+namespace opt {
+
+/// DeadCodeElimination - Deletes the instructions whose results are unused
+/// and that have no other effect, and then those that only they used.
+///
+/// Values that only use each other around a loop are left, since each of
+/// them still has a use.
+class DeadCodeElimination : public FunctionPass {
+public:
+  std::string_view getName() const override { return "dce"; }
+
+  /// Instructions are deleted, but no branches, so every analysis stays
+  /// valid.
+  PreservedAnalyses run(Function &Fn, AnalysisManager &AM) override;
+};
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_DEAD_CODE_ELIMINATION_H
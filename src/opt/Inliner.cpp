@@ -0,0 +1,227 @@
+#include "opt/Inliner.h"
+
+#include <cassert>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
+
+#include "ir/AllocaInst.h"
+#include "ir/BranchInst.h"
+#include "ir/CallInst.h"
+#include "ir/IRVisitor.h"
+#include "ir/PhiInst.h"
+#include "opt/CallSites.h"
+
+namespace opt {
+
+namespace {
+
+/// Emits a copy of each instruction it visits into the caller, at the
+/// caller's insert point, with operands mapped through VMap and branch
+/// targets through BlockMap. Both are indexed by the IDs in the callee.
+/// Returns become jumps to Cont.
+class InstCloner : public IRVisitor<InstCloner> {
+public:
+  InstCloner(Function &Caller, Symbol CalleeName, std::vector<Value *> &VMap,
+             const std::vector<BasicBlock *> &BlockMap, BasicBlock *Cont)
+      : Caller(Caller),
+        CalleeName(CalleeName),
+        VMap(VMap),
+        BlockMap(BlockMap),
+        Cont(Cont) {}
+
+  using IRVisitor::visit;
+
+  void visit(AllocaInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<AllocaInst>(
+        Symbol::intern(fmt::format("{}.{}", CalleeName, Inst.getName())));
+  }
+
+  void visit(StoreInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<StoreInst>(map(Inst.getPtr()),
+                                         map(Inst.getVal()));
+  }
+
+  void visit(LoadInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<LoadInst>(map(Inst.getPtr()));
+  }
+
+  void visit(ArithmeticInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<ArithmeticInst>(
+        Inst.getOpc(), map(Inst.getLHS()), map(Inst.getRHS()));
+  }
+
+  void visit(CompareInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<CompareInst>(
+        Inst.getPred(), map(Inst.getLHS()), map(Inst.getRHS()));
+  }
+
+  void visit(JumpInst &Inst) {
+    VMap[Inst.getID()] = Caller.emit<JumpInst>(map(Inst.getDest()));
+  }
+
+  void visit(CJumpInst &Inst) {
+    VMap[Inst.getID()] =
+        Caller.emit<CJumpInst>(map(Inst.getCond()), map(Inst.getTrueBB()),
+                               map(Inst.getFalseBB()));
+  }
+
+  void visit(CallInst &Inst) {
+    std::vector<Value *> Args;
+    for (Value *Arg : Inst.getArguments())
+      Args.push_back(map(Arg));
+    VMap[Inst.getID()] =
+        Caller.emit<CallInst>(Inst.getCallee(), std::move(Args));
+  }
+
+  void visit(ReturnInst &Inst) {
+    // Only the first return of a block is ever reached.
+    auto *BB = Caller.getCurrInsertPoint();
+    if (Results.empty() || Results.back().second != BB)
+      Results.emplace_back(map(Inst.getVal()), BB);
+    Caller.emit<JumpInst>(Cont);
+  }
+
+  void visit(PhiInst &Inst) {
+    // The incoming values may not have been copied yet.
+    auto *Phi = cast<PhiInst>(Caller.emit<PhiInst>());
+    Phis.emplace_back(&Inst, Phi);
+    VMap[Inst.getID()] = Phi;
+  }
+
+  /// Give the copied phis their incoming values, once everything has been
+  /// copied.
+  void completePhis() {
+    for (auto [From, To] : Phis)
+      for (size_t I = 0; I < From->getNumIncoming(); ++I)
+        To->addIncoming(map(From->getIncomingValue(I)),
+                        map(From->getIncomingBlock(I)));
+  }
+
+  /// The value of each return, and the block it leaves.
+  std::vector<std::pair<Value *, BasicBlock *>> Results;
+
+private:
+  Value *map(Value *V) {
+    assert(VMap[V->getID()] && "Operand used before it is defined");
+    return VMap[V->getID()];
+  }
+
+  BasicBlock *map(BasicBlock *BB) { return BlockMap[BB->getID()]; }
+
+  Function &Caller;
+  Symbol CalleeName;
+  std::vector<Value *> &VMap;
+  const std::vector<BasicBlock *> &BlockMap;
+  BasicBlock *Cont;
+  std::vector<std::pair<PhiInst *, PhiInst *>> Phis;
+};
+
+/// A block without a terminator falls through to the next one in layout
+/// order.
+bool isTerminated(BasicBlock &BB) {
+  return BB.size() != 0 && BB.getLastInst()->isTerminator();
+}
+
+bool shouldInline(Function &Caller, CallInst &Call) {
+  auto *Callee = Call.getCallee();
+  return Callee != nullptr && Callee != &Caller &&
+         Callee->isAvailableExternally() &&
+         Callee->getArgs().size() == Call.getArguments().size() &&
+         Callee->getInstructionCount() <= Inliner::Threshold;
+}
+
+void inlineCall(Function &Caller, const CallSite &Site) {
+  auto &BB = *Site.BB;
+  auto &Call = *Site.Call;
+  auto &Callee = *Call.getCallee();
+  auto Pos = BB.getIterator(&Call);
+
+  // The copied blocks, and then a block for whatever followed the call, are
+  // laid out right after the call's block. Values are then still defined
+  // before they are used in layout order, and a block without a terminator
+  // still falls through to the same code.
+  std::vector<BasicBlock *> BlockMap(Callee.getNumBlockIDs());
+  BasicBlock *Last = &BB;
+  for (auto &CalleeBB : Callee.getBlocks())
+    Last = BlockMap[CalleeBB.getID()] = Caller.makeNewBlockAfter(Last);
+  auto *Cont = Caller.makeNewBlockAfter(Last);
+  BB.splice(std::next(Pos), *Cont);
+
+  // The branches that ended the call's block now end Cont, so the phis they
+  // lead to come from there.
+  for (auto &Block : Caller.getBlocks())
+    for (auto &Inst : Block) {
+      if (!isa<PhiInst>(Inst))
+        break;
+      auto &Phi = cast<PhiInst>(Inst);
+      for (size_t I = 0; I < Phi.getNumIncoming(); ++I)
+        if (Phi.getIncomingBlock(I) == &BB)
+          Phi.setIncomingBlock(I, Cont);
+    }
+
+  // The parameters are the arguments.
+  std::vector<Value *> VMap(Callee.getNumValueIDs());
+  for (size_t I = 0; I < Callee.getArgs().size(); ++I)
+    VMap[Callee.getArgs()[I]->getID()] = Call.getArguments()[I];
+  for (auto *C : Callee.getConstants())
+    VMap[C->getID()] = Caller.makeConstant(C->getVal());
+  // Keep the call alive until its uses have been redirected.
+  BB.remove(&Call);
+
+  Caller.setInsertPoint(&BB);
+  Caller.emit<JumpInst>(BlockMap[Callee.getEntryBlock()->getID()]);
+
+  InstCloner Cloner(Caller, Callee.getName(), VMap, BlockMap, Cont);
+  for (auto &CalleeBB : Callee.getBlocks()) {
+    Caller.setInsertPoint(BlockMap[CalleeBB.getID()]);
+    for (auto &Inst : CalleeBB)
+      Cloner.visit(Inst);
+  }
+  Cloner.completePhis();
+
+  // Falling off the end of the callee returns 0.
+  if (!isTerminated(*Last)) {
+    Caller.setInsertPoint(Last);
+    Cloner.Results.emplace_back(Caller.makeConstant(0), Last);
+    Caller.emit<JumpInst>(Cont);
+  }
+
+  // With a single return, its block is the only way into Cont, and its value
+  // can be used directly.
+  Value *Result = nullptr;
+  if (Cloner.Results.empty()) {
+    // Cont is unreachable.
+    Result = Caller.makeConstant(0);
+  } else if (Cloner.Results.size() == 1) {
+    Result = Cloner.Results.front().first;
+  } else {
+    auto *Phi = Caller.makePhi(Cont);
+    for (auto [Val, From] : Cloner.Results)
+      Phi->addIncoming(Val, From);
+    Result = Phi;
+  }
+  Call.replaceAllUsesWith(Result);
+  Call.destroy();
+}
+
+} // namespace
+
+PreservedAnalyses Inliner::run(Function &Caller, AnalysisManager &) {
+  auto Sites = collectCallSites(Caller);
+  std::erase_if(Sites, [&](const CallSite &Site) {
+    return !shouldInline(Caller, *Site.Call);
+  });
+
+  // Go backwards, so that splitting a block at one call leaves the earlier
+  // calls of the block where they were.
+  for (const auto &Site : std::ranges::reverse_view(Sites))
+    inlineCall(Caller, Site);
+  count("Calls inlined", Sites.size());
+  return Sites.empty() ? PreservedAnalyses::all() : PreservedAnalyses::none();
+}
+
+} // namespace opt
@@ -0,0 +1,32 @@
+#ifndef TOY_LANG_OPT_INLINER_H
+#define TOY_LANG_OPT_INLINER_H
+
+#include <cstddef>
+
+#include "ir/Function.h"
+#include "ir/ModuleSummary.h"
+#include "opt/PassManager.h"
+
+namespace opt {
+
+/// Inliner - Replaces calls to imported functions with small bodies by a
+/// copy of the body.
+///
+/// The parameters of the copy are replaced by the arguments. Every return
+/// jumps to the code that followed the call, which takes the result from a
+/// phi over the returns. Only the calls that were in the caller beforehand
+/// are considered, so a recursive callee is inlined once at most.
+class Inliner : public FunctionPass {
+public:
+  /// Callees with at most this many instructions are inlined.
+  static constexpr size_t Threshold = ModuleSummary::MaxInlineSize;
+
+  std::string_view getName() const override { return "inline"; }
+
+  /// Inline the eligible calls in \p Caller.
+  PreservedAnalyses run(Function &Caller, AnalysisManager &AM) override;
+};
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_INLINER_H
@@ -0,0 +1,34 @@
+#include "opt/PassBuilder.h"
+
+#include <cassert>
+
+#include "opt/CallFolder.h"
+#include "opt/DeadCodeElimination.h"
+#include "opt/Inliner.h"
+#include "opt/UnreachableCodeElim.h"
+
+namespace opt {
+
+std::unique_ptr<FunctionPassManager> buildFunctionPipeline(unsigned Level) {
+  assert(Level <= MaxOptLevel && "Unknown optimization level");
+  auto FPM = std::make_unique<FunctionPassManager>();
+  if (Level >= 1) {
+    // Folding first leaves fewer calls to inline.
+    FPM->add(std::make_unique<CallFolder>());
+    FPM->add(std::make_unique<Inliner>());
+  }
+  if (Level >= 2) {
+    // What is unreachable has no uses to keep dead code alive.
+    FPM->add(std::make_unique<UnreachableCodeElim>());
+    FPM->add(std::make_unique<DeadCodeElimination>());
+  }
+  return FPM;
+}
+
+std::unique_ptr<ModulePassManager> buildModulePipeline(unsigned Level) {
+  auto MPM = std::make_unique<ModulePassManager>();
+  MPM->add(std::make_unique<FunctionPassAdaptor>(buildFunctionPipeline(Level)));
+  return MPM;
+}
+
+} // namespace opt
@@ -0,0 +1,27 @@
+#ifndef TOY_LANG_OPT_PASS_BUILDER_H
+#define TOY_LANG_OPT_PASS_BUILDER_H
+
+#include <memory>
+
+#include "opt/PassManager.h"
+
+namespace opt {
+
+/// The optimization level when -O is not given. It does what toyc did before
+/// it had levels.
+constexpr unsigned DefaultOptLevel = 1;
+constexpr unsigned MaxOptLevel = 2;
+
+/// The function passes of -O\p Level:
+///
+///   -O0  Nothing.
+///   -O1  Fold and inline calls to imported functions.
+///   -O2  Then delete unreachable and dead code.
+std::unique_ptr<FunctionPassManager> buildFunctionPipeline(unsigned Level);
+
+/// The passes of -O\p Level over a whole module.
+std::unique_ptr<ModulePassManager> buildModulePipeline(unsigned Level);
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_PASS_BUILDER_H
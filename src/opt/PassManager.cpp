@@ -0,0 +1,154 @@
+#include "opt/PassManager.h"
+
+#include <algorithm>
+
+#include "fmt/format.h"
+
+namespace opt {
+
+//===----------------------------------------------------------------------===//
+// AnalysisManager
+//===----------------------------------------------------------------------===//
+
+analysis::CFG &AnalysisManager::getCFG(Function &Fn) {
+  auto &R = Results[&Fn];
+  if (R.G == nullptr) {
+    PassTimings::Scope Timer(Timings, "cfg");
+    R.G = std::make_unique<analysis::CFG>(Fn);
+  }
+  return *R.G;
+}
+
+analysis::DominatorTree &AnalysisManager::getDominatorTree(Function &Fn) {
+  auto &G = getCFG(Fn);
+  auto &R = Results[&Fn];
+  if (R.DT == nullptr) {
+    PassTimings::Scope Timer(Timings, "domtree");
+    R.DT = std::make_unique<analysis::DominatorTree>(G);
+  }
+  return *R.DT;
+}
+
+const analysis::DominanceFrontier &
+AnalysisManager::getDominanceFrontier(Function &Fn) {
+  auto &DT = getDominatorTree(Fn);
+  auto &R = Results[&Fn];
+  if (R.DF == nullptr) {
+    PassTimings::Scope Timer(Timings, "domfrontier");
+    R.DF = std::make_unique<analysis::DominanceFrontier>(*R.G, DT);
+  }
+  return *R.DF;
+}
+
+const analysis::LoopInfo &AnalysisManager::getLoopInfo(Function &Fn) {
+  auto &DT = getDominatorTree(Fn);
+  auto &R = Results[&Fn];
+  if (R.LI == nullptr) {
+    PassTimings::Scope Timer(Timings, "loops");
+    R.LI = std::make_unique<analysis::LoopInfo>(*R.G, DT);
+  }
+  return *R.LI;
+}
+
+void AnalysisManager::invalidate(FunctionResults &R,
+                                 const PreservedAnalyses &PA) {
+  // The dominator tree refers to the CFG, and the others are built from both.
+  if (!PA.isPreserved(AnalysisKind::CFG))
+    R.G.reset();
+  if (R.G == nullptr || !PA.isPreserved(AnalysisKind::DominatorTree))
+    R.DT.reset();
+  if (R.DT == nullptr || !PA.isPreserved(AnalysisKind::DominanceFrontier))
+    R.DF.reset();
+  if (R.DT == nullptr || !PA.isPreserved(AnalysisKind::LoopInfo))
+    R.LI.reset();
+}
+
+void AnalysisManager::invalidate(Function &Fn, const PreservedAnalyses &PA) {
+  if (auto It = Results.find(&Fn); It != Results.end())
+    invalidate(It->second, PA);
+}
+
+void AnalysisManager::invalidate(const PreservedAnalyses &PA) {
+  for (auto &Entry : Results)
+    invalidate(Entry.second, PA);
+}
+
+//===----------------------------------------------------------------------===//
+// Passes
+//===----------------------------------------------------------------------===//
+
+void Pass::count(std::string_view Desc, size_t N) {
+  auto It = std::find_if(Counters.begin(), Counters.end(),
+                         [&](const auto &C) { return C.first == Desc; });
+  if (It == Counters.end())
+    Counters.emplace_back(Desc, N);
+  else
+    It->second += N;
+}
+
+void Pass::printStatistics(std::FILE *Out) const {
+  for (auto [Desc, N] : Counters)
+    if (N != 0)
+      fmt::print(Out, "{:>8} {} - {}\n", N, getName(), Desc);
+}
+
+PreservedAnalyses FunctionPassManager::run(Function &Fn, AnalysisManager &AM) {
+  auto PA = PreservedAnalyses::all();
+  for (auto &P : Passes) {
+    PreservedAnalyses PassPA;
+    {
+      PassTimings::Scope Timer(P->isPassManager() ? nullptr : AM.getTimings(),
+                               P->getName());
+      PassPA = P->run(Fn, AM);
+    }
+    AM.invalidate(Fn, PassPA);
+    PA.intersect(PassPA);
+  }
+  return PA;
+}
+
+void FunctionPassManager::printStatistics(std::FILE *Out) const {
+  for (auto &P : Passes)
+    P->printStatistics(Out);
+}
+
+PreservedAnalyses ModulePassManager::run(IRCompilationUnit &IR,
+                                         AnalysisManager &AM) {
+  auto PA = PreservedAnalyses::all();
+  for (auto &P : Passes) {
+    PreservedAnalyses PassPA;
+    {
+      PassTimings::Scope Timer(P->isPassManager() ? nullptr : AM.getTimings(),
+                               P->getName());
+      PassPA = P->run(IR, AM);
+    }
+    AM.invalidate(PassPA);
+    PA.intersect(PassPA);
+  }
+  return PA;
+}
+
+void ModulePassManager::printStatistics(std::FILE *Out) const {
+  for (auto &P : Passes)
+    P->printStatistics(Out);
+}
+
+PreservedAnalyses FunctionPassAdaptor::run(IRCompilationUnit &IR,
+                                           AnalysisManager &AM) {
+  for (auto &Fn : IR) {
+    if (Fn->getEntryBlock() == nullptr || Fn->isAvailableExternally())
+      continue;
+    P->run(*Fn, AM);
+    AM.clear(*Fn);
+  }
+  return PreservedAnalyses::all();
+}
+
+void printStatisticsReport(std::FILE *Out, const Pass &P) {
+  printReportHeading(Out, "... Statistics Collected ...");
+  fmt::print(Out, "\n");
+  P.printStatistics(Out);
+  fmt::print(Out, "\n");
+}
+
+} // namespace opt
@@ -0,0 +1,199 @@
+#ifndef TOY_LANG_OPT_PASS_MANAGER_H
+#define TOY_LANG_OPT_PASS_MANAGER_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis/CFG.h"
+#include "analysis/Dominators.h"
+#include "analysis/LoopInfo.h"
+#include "ir/Function.h"
+#include "ir/IRCompilationUnit.h"
+#include "opt/PassTimings.h"
+
+namespace opt {
+
+/// The analyses that AnalysisManager can compute and keep for a function.
+enum class AnalysisKind {
+  CFG,
+  DominatorTree,
+  DominanceFrontier,
+  LoopInfo,
+};
+
+/// PreservedAnalyses - The analyses that are still valid after a pass.
+class PreservedAnalyses {
+public:
+  static PreservedAnalyses all() {
+    PreservedAnalyses PA;
+    PA.Preserved.set();
+    return PA;
+  }
+  static PreservedAnalyses none() { return PreservedAnalyses(); }
+
+  PreservedAnalyses &preserve(AnalysisKind Kind) {
+    Preserved.set(static_cast<size_t>(Kind));
+    return *this;
+  }
+
+  bool isPreserved(AnalysisKind Kind) const {
+    return Preserved.test(static_cast<size_t>(Kind));
+  }
+
+  /// Keep only what \p Other preserves too.
+  void intersect(const PreservedAnalyses &Other) {
+    Preserved &= Other.Preserved;
+  }
+
+private:
+  /// One bit for each AnalysisKind.
+  std::bitset<4> Preserved;
+};
+
+/// AnalysisManager - Computes the analyses of a function when a pass first
+/// asks for them, and keeps them until a pass does not preserve them.
+///
+/// An analysis is only kept while the ones it is computed from are: a pass
+/// that does not preserve the CFG loses everything built on it.
+class AnalysisManager {
+public:
+  /// With \p Timings, analyses are timed apart from the passes that ask for
+  /// them.
+  explicit AnalysisManager(PassTimings *Timings = nullptr)
+      : Timings(Timings) {}
+
+  analysis::CFG &getCFG(Function &Fn);
+  analysis::DominatorTree &getDominatorTree(Function &Fn);
+  const analysis::DominanceFrontier &getDominanceFrontier(Function &Fn);
+  const analysis::LoopInfo &getLoopInfo(Function &Fn);
+
+  /// Drop the analyses of \p Fn that \p PA does not preserve.
+  void invalidate(Function &Fn, const PreservedAnalyses &PA);
+
+  /// Drop the analyses of every function that \p PA does not preserve.
+  void invalidate(const PreservedAnalyses &PA);
+
+  /// Drop every analysis of \p Fn, as when it is done with or freed.
+  void clear(Function &Fn) { Results.erase(&Fn); }
+
+  PassTimings *getTimings() const { return Timings; }
+
+private:
+  struct FunctionResults {
+    std::unique_ptr<analysis::CFG> G;
+    std::unique_ptr<analysis::DominatorTree> DT;
+    std::unique_ptr<analysis::DominanceFrontier> DF;
+    std::unique_ptr<analysis::LoopInfo> LI;
+  };
+
+  static void invalidate(FunctionResults &R, const PreservedAnalyses &PA);
+
+  std::unordered_map<Function *, FunctionResults> Results;
+  PassTimings *Timings;
+};
+
+/// Pass - What all passes have in common: a name, and statistics.
+class Pass {
+public:
+  virtual ~Pass() = default;
+
+  /// The name --time-passes and --stats report the pass under.
+  virtual std::string_view getName() const = 0;
+
+  /// Whether the pass only runs other passes, which are timed themselves.
+  virtual bool isPassManager() const { return false; }
+
+  /// Print the counters of the pass that are not 0, for --stats.
+  virtual void printStatistics(std::FILE *Out) const;
+
+protected:
+  /// Add \p N to the counter described by \p Desc.
+  void count(std::string_view Desc, size_t N = 1);
+
+private:
+  /// The counters in the order they were first counted.
+  std::vector<std::pair<std::string_view, size_t>> Counters;
+};
+
+/// FunctionPass - A pass that looks at or changes one function at a time.
+class FunctionPass : public Pass {
+public:
+  /// Run on \p Fn, and return the analyses of \p Fn that are still valid.
+  virtual PreservedAnalyses run(Function &Fn, AnalysisManager &AM) = 0;
+};
+
+/// ModulePass - A pass over all the functions of a module at once.
+class ModulePass : public Pass {
+public:
+  /// Run on \p IR, and return the analyses that are still valid for all of
+  /// its functions.
+  virtual PreservedAnalyses run(IRCompilationUnit &IR,
+                                AnalysisManager &AM) = 0;
+};
+
+/// FunctionPassManager - Runs a pipeline of function passes in order,
+/// dropping what each of them invalidates before the next one runs.
+class FunctionPassManager : public FunctionPass {
+public:
+  void add(std::unique_ptr<FunctionPass> P) { Passes.push_back(std::move(P)); }
+  bool empty() const { return Passes.empty(); }
+
+  std::string_view getName() const override { return "function-pipeline"; }
+  bool isPassManager() const override { return true; }
+  void printStatistics(std::FILE *Out) const override;
+
+  PreservedAnalyses run(Function &Fn, AnalysisManager &AM) override;
+
+private:
+  std::vector<std::unique_ptr<FunctionPass>> Passes;
+};
+
+/// ModulePassManager - Runs a pipeline of module passes in order.
+class ModulePassManager : public ModulePass {
+public:
+  void add(std::unique_ptr<ModulePass> P) { Passes.push_back(std::move(P)); }
+
+  std::string_view getName() const override { return "module-pipeline"; }
+  bool isPassManager() const override { return true; }
+  void printStatistics(std::FILE *Out) const override;
+
+  PreservedAnalyses run(IRCompilationUnit &IR, AnalysisManager &AM) override;
+
+private:
+  std::vector<std::unique_ptr<ModulePass>> Passes;
+};
+
+/// FunctionPassAdaptor - Runs function passes over every function of a
+/// module that has a body to compile. Available-externally bodies are left
+/// as they were imported. The analyses of a function are dropped once its
+/// passes are done, so only one function's are kept at a time.
+class FunctionPassAdaptor : public ModulePass {
+public:
+  explicit FunctionPassAdaptor(std::unique_ptr<FunctionPass> P)
+      : P(std::move(P)) {}
+
+  std::string_view getName() const override { return "function-adaptor"; }
+  bool isPassManager() const override { return true; }
+  void printStatistics(std::FILE *Out) const override {
+    P->printStatistics(Out);
+  }
+
+  PreservedAnalyses run(IRCompilationUnit &IR, AnalysisManager &AM) override;
+
+private:
+  std::unique_ptr<FunctionPass> P;
+};
+
+/// Print the statistics of \p P and the passes it runs to \p Out, under a
+/// heading.
+void printStatisticsReport(std::FILE *Out, const Pass &P);
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_PASS_MANAGER_H
@@ -0,0 +1,65 @@
+#include "opt/PassTimings.h"
+
+#include <algorithm>
+
+#include "fmt/format.h"
+
+namespace opt {
+
+void printReportHeading(std::FILE *Out, std::string_view Title) {
+  constexpr size_t Width = 79;
+  fmt::print(Out, "==={:-<{}}===\n", "", Width - 6);
+  fmt::print(Out, "{:>{}}\n", Title, (Width + Title.size()) / 2);
+  fmt::print(Out, "==={:-<{}}===\n", "", Width - 6);
+}
+
+PassTimings::Scope::Scope(PassTimings *Timings, std::string_view Name)
+    : Timings(Timings),
+      Name(Name) {
+  if (Timings == nullptr)
+    return;
+  Outer = std::exchange(Timings->Current, this);
+  Start = Clock::now();
+}
+
+PassTimings::Scope::~Scope() {
+  if (Timings == nullptr)
+    return;
+  Seconds Elapsed = Clock::now() - Start;
+  Timings->add(Name, Elapsed - Nested);
+  Timings->Current = Outer;
+  if (Outer != nullptr)
+    Outer->Nested += Elapsed;
+}
+
+void PassTimings::add(std::string_view Name, Seconds Time) {
+  auto It = std::find_if(Times.begin(), Times.end(), [&](const auto &Entry) {
+    return Entry.first == Name;
+  });
+  if (It == Times.end())
+    Times.emplace_back(std::string(Name), Time);
+  else
+    It->second += Time;
+}
+
+void PassTimings::print(std::FILE *Out) const {
+  auto Sorted = Times;
+  std::stable_sort(
+      Sorted.begin(), Sorted.end(),
+      [](const auto &A, const auto &B) { return A.second > B.second; });
+  Seconds Total{0};
+  for (auto &Entry : Sorted)
+    Total += Entry.second;
+  // Keep the percentages finite when nothing took measurable time.
+  double Whole = std::max(Total.count(), 1e-9);
+
+  printReportHeading(Out, "... Pass execution timing report ...");
+  fmt::print(Out, "  Total Execution Time: {:.4f} seconds\n\n", Total.count());
+  fmt::print(Out, "   ---Wall Time---  --- Name ---\n");
+  for (auto &[Name, Time] : Sorted)
+    fmt::print(Out, "   {:.4f} ({:5.1f}%)  {}\n", Time.count(),
+               Time.count() * 100 / Whole, Name);
+  fmt::print(Out, "   {:.4f} ({:5.1f}%)  Total\n\n", Total.count(), 100.0);
+}
+
+} // namespace opt
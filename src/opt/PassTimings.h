@@ -0,0 +1,61 @@
+#ifndef TOY_LANG_OPT_PASS_TIMINGS_H
+#define TOY_LANG_OPT_PASS_TIMINGS_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+/// PassTimings - The wall time spent in each pass, analysis and compiler
+/// stage, for --time-passes.
+///
+/// Time is measured by scopes. A scope that starts while another is running
+/// is not counted towards the outer one, so an analysis that a pass asks for
+/// is reported on its own rather than as part of the pass. Scopes must be
+/// opened and closed on one thread.
+class PassTimings {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Seconds = std::chrono::duration<double>;
+
+  /// Scope - Adds the time from its construction to its destruction to
+  /// \p Name. It does nothing if there is no PassTimings.
+  class Scope {
+  public:
+    Scope(PassTimings *Timings, std::string_view Name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    PassTimings *Timings;
+    std::string_view Name;
+    Scope *Outer = nullptr;
+    Clock::time_point Start;
+    /// Time spent in scopes nested in this one.
+    Seconds Nested{0};
+  };
+
+  /// Print the times, the largest first, to \p Out.
+  void print(std::FILE *Out) const;
+
+private:
+  void add(std::string_view Name, Seconds Time);
+
+  /// The times in the order the names were first seen.
+  std::vector<std::pair<std::string, Seconds>> Times;
+  Scope *Current = nullptr;
+};
+
+/// Print \p Title between two rules, as the reports of --time-passes and
+/// --stats begin.
+void printReportHeading(std::FILE *Out, std::string_view Title);
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_PASS_TIMINGS_H
@@ -0,0 +1,85 @@
+#include "opt/UnreachableCodeElim.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "ir/PhiInst.h"
+
+namespace opt {
+
+PreservedAnalyses UnreachableCodeElim::run(Function &Fn, AnalysisManager &AM) {
+  auto &G = AM.getCFG(Fn);
+  auto &DT = AM.getDominatorTree(Fn);
+
+  // A phi can have an entry for a block whose branch to it follows a return,
+  // or for an unreachable block, and neither of those is a predecessor.
+  for (unsigned N = 0; N < G.size(); ++N) {
+    if (!DT.isReachable(N))
+      continue;
+    auto Preds = G.preds(N);
+    for (auto &Inst : *G.getBlock(N)) {
+      if (!isa<PhiInst>(Inst))
+        break;
+      auto &Phi = cast<PhiInst>(Inst);
+      for (size_t I = Phi.getNumIncoming(); I-- > 0;) {
+        unsigned From = G.getNumber(Phi.getIncomingBlock(I));
+        if (!DT.isReachable(From) ||
+            std::find(Preds.begin(), Preds.end(), From) == Preds.end())
+          Phi.removeIncoming(I);
+      }
+    }
+  }
+
+  // Nothing that is reached uses the code that is not, except in ways that
+  // never run, so 0 does as well as anything for what is left.
+  Value *Undef = nullptr;
+  size_t NumInsts = 0;
+  auto Delete = [&](BasicBlock &BB, BasicBlock::iterator First) {
+    for (auto It = First; It != BB.end(); ++It) {
+      if (!It->use_empty()) {
+        if (Undef == nullptr)
+          Undef = Fn.makeConstant(0);
+        It->replaceAllUsesWith(Undef);
+      }
+      ++NumInsts;
+    }
+  };
+
+  std::vector<std::pair<BasicBlock *, BasicBlock::iterator>> Tails;
+  for (unsigned N = 0; N < G.size(); ++N) {
+    auto &BB = *G.getBlock(N);
+    if (!DT.isReachable(N)) {
+      Delete(BB, BB.begin());
+      continue;
+    }
+    auto Term = std::find_if(BB.begin(), BB.end(), [](auto &Inst) {
+      return Inst.isTerminator();
+    });
+    if (Term != BB.end() && std::next(Term) != BB.end()) {
+      Delete(BB, std::next(Term));
+      Tails.emplace_back(&BB, std::next(Term));
+    }
+  }
+
+  // Only delete once the uses are gone, so that no deleted value is left with
+  // users that are still there.
+  for (auto [BB, First] : Tails)
+    BB->erase(First, BB->end());
+
+  size_t NumBlocks = 0;
+  for (unsigned N = 0; N < G.size(); ++N)
+    if (!DT.isReachable(N)) {
+      Fn.eraseBlock(G.getBlock(N));
+      ++NumBlocks;
+    }
+  count("Unreachable blocks deleted", NumBlocks);
+  count("Unreachable instructions deleted", NumInsts);
+
+  // The edges out of the deleted code were never in the CFG, so it only
+  // changes if blocks go.
+  return NumBlocks == 0 ? PreservedAnalyses::all() : PreservedAnalyses::none();
+}
+
+} // namespace opt
@@ -0,0 +1,24 @@
+#ifndef TOY_LANG_OPT_UNREACHABLE_CODE_ELIM_H
+#define TOY_LANG_OPT_UNREACHABLE_CODE_ELIM_H
+
+#include "ir/Function.h"
+#include "opt/PassManager.h"
+
+namespace opt {
+
+/// UnreachableCodeElim - Deletes the code that control never reaches: the
+/// instructions after the first terminator of a block, which lowering leaves
+/// after a return, and the blocks that the entry block cannot reach.
+///
+/// Phis lose their entries for blocks that can no longer branch to them.
+/// Whatever is left using a deleted value uses 0 instead.
+class UnreachableCodeElim : public FunctionPass {
+public:
+  std::string_view getName() const override { return "unreachable-elim"; }
+
+  PreservedAnalyses run(Function &Fn, AnalysisManager &AM) override;
+};
+
+} // namespace opt
+
+#endif // !TOY_LANG_OPT_UNREACHABLE_CODE_ELIM_H
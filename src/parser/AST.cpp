@@ -46,8 +46,6 @@ void ExprStmtAST::accept(ASTVisitor &V) {
   V.visit(*this);
 }
 
-TopLevelDeclarationAST::~TopLevelDeclarationAST() {}
-
 void PrototypeAST::accept(ASTVisitor &V) {
   V.visit(*this);
 }
@@ -56,6 +54,10 @@ void FunctionAST::accept(ASTVisitor &V) {
   V.visit(*this);
 }
 
+void ImportAST::accept(ASTVisitor &V) {
+  V.visit(*this);
+}
+
 void CompilationUnit::accept(ASTVisitor &V) {
   V.visit(*this);
 }
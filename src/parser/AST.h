@@ -2,12 +2,24 @@
 
 #include <cassert>
 #include <cstdint>
-#include <memory>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "parser/ASTKind.h"
+#include "support/Arena.h"
+#include "support/Symbol.h"
+
 //===----------------------------------------------------------------------===//
 // Abstract Syntax Tree (aka Parse Tree)
+//
+// Every node and child array lives in the Arena of the CompilationUnit it was
+// parsed into, and nodes refer to each other through plain pointers. Nodes are
+// never destroyed one by one, so they must not own anything themselves.
+//
+// Each node also records its ASTKind, so that an ASTWalker can dispatch on it
+// with a switch instead of going through accept().
 //===----------------------------------------------------------------------===//
 
 class ASTVisitor;
@@ -15,11 +27,18 @@ class ASTVisitor;
 /// ExprAST - Base class for all expression nodes.
 class ExprAST {
 public:
-  virtual ~ExprAST() = default;
-
   //   virtual Value *codegen() = 0;
 
   virtual void accept(ASTVisitor &V) = 0;
+
+  ASTKind getKind() const { return Kind; }
+
+protected:
+  ExprAST(ASTKind Kind) : Kind(Kind) {}
+  ~ExprAST() = default;
+
+private:
+  const ASTKind Kind;
 };
 
 /// NumberExprAST - Expression class for numeric literals like "1.0".
@@ -27,7 +46,7 @@ class NumberExprAST : public ExprAST {
   int64_t Val;
 
 public:
-  NumberExprAST(int64_t Val) : Val(Val) {}
+  NumberExprAST(int64_t Val) : ExprAST(ASTKind::Number), Val(Val) {}
 
   // Value *codegen() override;
 
@@ -38,27 +57,28 @@ public:
 
 /// VariableExprAST - Expression class for referencing a variable, like "a".
 class VariableExprAST : public ExprAST {
-  std::string Name;
+  Symbol Name;
 
 public:
-  VariableExprAST(const std::string &Name) : Name(Name) {}
+  VariableExprAST(Symbol Name) : ExprAST(ASTKind::Variable), Name(Name) {}
 
   // Value *codegen() override;
 
   void accept(ASTVisitor &V) override;
 
-  const std::string &getName() const { return Name; }
+  Symbol getName() const { return Name; }
 };
 
 /// UnaryExprAST - Expression class for a unary operator.
 class UnaryExprAST : public ExprAST {
   char Opcode;
-  std::unique_ptr<ExprAST> Operand;
+  ExprAST *Operand;
 
 public:
-  UnaryExprAST(char Opcode, std::unique_ptr<ExprAST> Operand)
-      : Opcode(Opcode),
-        Operand(std::move(Operand)) {}
+  UnaryExprAST(char Opcode, ExprAST *Operand)
+      : ExprAST(ASTKind::Unary),
+        Opcode(Opcode),
+        Operand(Operand) {}
 
   // Value *codegen() override;
 
@@ -71,14 +91,14 @@ public:
 /// BinaryExprAST - Expression class for a binary operator.
 class BinaryExprAST : public ExprAST {
   char Op;
-  std::unique_ptr<ExprAST> LHS, RHS;
+  ExprAST *LHS, *RHS;
 
 public:
-  BinaryExprAST(char Op, std::unique_ptr<ExprAST> LHS,
-                std::unique_ptr<ExprAST> RHS)
-      : Op(Op),
-        LHS(std::move(LHS)),
-        RHS(std::move(RHS)) {}
+  BinaryExprAST(char Op, ExprAST *LHS, ExprAST *RHS)
+      : ExprAST(ASTKind::Binary),
+        Op(Op),
+        LHS(LHS),
+        RHS(RHS) {}
 
   // Value *codegen() override;
   void accept(ASTVisitor &V) override;
@@ -90,59 +110,68 @@ public:
 
 /// CallExprAST - Expression class for function calls.
 class CallExprAST : public ExprAST {
-  std::string Callee;
-  std::vector<std::unique_ptr<ExprAST>> Args;
+  Symbol Callee;
+  std::span<ExprAST *> Args;
 
 public:
-  CallExprAST(const std::string &Callee,
-              std::vector<std::unique_ptr<ExprAST>> Args)
-      : Callee(Callee),
-        Args(std::move(Args)) {}
+  CallExprAST(Symbol Callee, std::span<ExprAST *> Args)
+      : ExprAST(ASTKind::Call),
+        Callee(Callee),
+        Args(Args) {}
 
   // Value *codegen() override;
 
   void accept(ASTVisitor &V) override;
 
-  const std::string &getCallee() const { return Callee; }
-  const std::vector<std::unique_ptr<ExprAST>> &getArgs() const { return Args; }
+  Symbol getCallee() const { return Callee; }
+  std::span<ExprAST *const> getArgs() const { return Args; }
 };
 
 class StmtAST {
 public:
-  virtual ~StmtAST() = default;
-
   virtual void accept(ASTVisitor &V) = 0;
+
+  ASTKind getKind() const { return Kind; }
+
+protected:
+  StmtAST(ASTKind Kind) : Kind(Kind) {}
+  ~StmtAST() = default;
+
+private:
+  const ASTKind Kind;
 };
 
 class BlockStmtAST : public StmtAST {
 public:
-  BlockStmtAST(std::vector<std::unique_ptr<StmtAST>> Stmts)
-      : Stmts(std::move(Stmts)) {}
+  BlockStmtAST(std::span<StmtAST *> Stmts)
+      : StmtAST(ASTKind::Block),
+        Stmts(Stmts) {}
 
   void accept(ASTVisitor &V) override;
 
-  const auto &getStmts() const { return Stmts; }
+  std::span<StmtAST *const> getStmts() const { return Stmts; }
 
 private:
-  std::vector<std::unique_ptr<StmtAST>> Stmts;
+  std::span<StmtAST *> Stmts;
 };
 
 /// IfExprAST - Expression class for if/then/else.
 class IfStmtAST : public StmtAST {
-  std::unique_ptr<ExprAST> Cond;
-  std::unique_ptr<StmtAST> Then, Else;
+  ExprAST *Cond;
+  StmtAST *Then, *Else;
 
 public:
-  IfStmtAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<StmtAST> Then)
-      : Cond(std::move(Cond)),
-        Then(std::move(Then)),
+  IfStmtAST(ExprAST *Cond, StmtAST *Then)
+      : StmtAST(ASTKind::If),
+        Cond(Cond),
+        Then(Then),
         Else(nullptr) {}
 
-  IfStmtAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<StmtAST> Then,
-            std::unique_ptr<StmtAST> Else)
-      : Cond(std::move(Cond)),
-        Then(std::move(Then)),
-        Else(std::move(Else)) {}
+  IfStmtAST(ExprAST *Cond, StmtAST *Then, StmtAST *Else)
+      : StmtAST(ASTKind::If),
+        Cond(Cond),
+        Then(Then),
+        Else(Else) {}
 
   // Value *codegen() override;
 
@@ -150,14 +179,15 @@ public:
 
   ExprAST &getCond() const { return *Cond; }
   StmtAST &getThen() const { return *Then; }
-  StmtAST *getElse() const { return Else.get(); }
+  StmtAST *getElse() const { return Else; }
 };
 
 class WhileStmtAST : public StmtAST {
 public:
-  WhileStmtAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<StmtAST> Body)
-      : Cond(std::move(Cond)),
-        Body(std::move(Body)) {}
+  WhileStmtAST(ExprAST *Cond, StmtAST *Body)
+      : StmtAST(ASTKind::While),
+        Cond(Cond),
+        Body(Body) {}
 
   void accept(ASTVisitor &V) override;
 
@@ -165,83 +195,91 @@ public:
   StmtAST &getBody() const { return *Body; }
 
 private:
-  std::unique_ptr<ExprAST> Cond;
-  std::unique_ptr<StmtAST> Body;
+  ExprAST *Cond;
+  StmtAST *Body;
 };
 
 /// VarExprAST - Expression class for var/in
 class VarStmtAST : public StmtAST {
-  std::string VarName;
-  std::string VarType;
-  std::unique_ptr<ExprAST> Init;
+  Symbol VarName;
+  Symbol VarType;
+  ExprAST *Init;
 
 public:
-  VarStmtAST(std::string VarName, std::string VarType,
-             std::unique_ptr<ExprAST> Init)
-      : VarName(std::move(VarName)),
-        VarType(std::move(VarType)),
-        Init(std::move(Init)) {}
+  VarStmtAST(Symbol VarName, Symbol VarType, ExprAST *Init)
+      : StmtAST(ASTKind::Var),
+        VarName(VarName),
+        VarType(VarType),
+        Init(Init) {}
 
   // Value *codegen() override;
 
   void accept(ASTVisitor &V) override;
 
-  std::string_view getVarName() const { return VarName; }
-  std::string_view getVarType() const { return VarType; }
-  ExprAST *getInit() const { return Init.get(); }
+  Symbol getVarName() const { return VarName; }
+  Symbol getVarType() const { return VarType; }
+  ExprAST *getInit() const { return Init; }
 };
 
 class ReturnStmtAST : public StmtAST {
 public:
-  ReturnStmtAST() : Expr(nullptr) {}
-  ReturnStmtAST(std::unique_ptr<ExprAST> Expr) : Expr(std::move(Expr)) {}
+  ReturnStmtAST() : StmtAST(ASTKind::Return), Expr(nullptr) {}
+  ReturnStmtAST(ExprAST *Expr) : StmtAST(ASTKind::Return), Expr(Expr) {}
 
   void accept(ASTVisitor &V) override;
 
-  ExprAST *getExpr() const { return Expr.get(); }
+  ExprAST *getExpr() const { return Expr; }
 
 private:
-  std::unique_ptr<ExprAST> Expr;
+  ExprAST *Expr;
 };
 
 class ExprStmtAST : public StmtAST {
 public:
-  ExprStmtAST(std::unique_ptr<ExprAST> Expr) : Expr(std::move(Expr)) {}
+  ExprStmtAST(ExprAST *Expr) : StmtAST(ASTKind::ExprStmt), Expr(Expr) {}
 
   void accept(ASTVisitor &V) override;
 
   ExprAST &getExpr() const { return *Expr; }
 
 private:
-  std::unique_ptr<ExprAST> Expr;
+  ExprAST *Expr;
 };
 
 class TopLevelDeclarationAST {
 public:
-  virtual ~TopLevelDeclarationAST() = 0;
-
   virtual void accept(ASTVisitor &) = 0;
+
+  ASTKind getKind() const { return Kind; }
+
+protected:
+  TopLevelDeclarationAST(ASTKind Kind) : Kind(Kind) {}
+  ~TopLevelDeclarationAST() = default;
+
+private:
+  const ASTKind Kind;
 };
 
 /// PrototypeAST - This class represents the "prototype" for a function,
 /// which captures its name, and its argument names (thus implicitly the number
 /// of arguments the function takes), as well as if it is an operator.
 class PrototypeAST : public TopLevelDeclarationAST {
-  std::string ReturnType;
-  std::string Name;
-  std::vector<std::pair<std::string, std::string>> Params;
+  Symbol ReturnType;
+  Symbol Name;
+  std::span<std::pair<Symbol, Symbol>> Params;
 
 public:
-  PrototypeAST(std::string Name,
-               std::vector<std::pair<std::string, std::string>> Params)
-      : ReturnType("void"),
-        Name(std::move(Name)),
-        Params(std::move(Params)) {}
-  PrototypeAST(std::string ReturnType, std::string Name,
-               std::vector<std::pair<std::string, std::string>> Params)
-      : ReturnType(std::move(ReturnType)),
-        Name(std::move(Name)),
-        Params(std::move(Params)) {}
+  PrototypeAST(Symbol Name, std::span<std::pair<Symbol, Symbol>> Params)
+      : TopLevelDeclarationAST(ASTKind::Prototype),
+        ReturnType(Symbol::intern("void")),
+        Name(Name),
+        Params(Params) {}
+  PrototypeAST(Symbol ReturnType, Symbol Name,
+               std::span<std::pair<Symbol, Symbol>> Params)
+      : TopLevelDeclarationAST(ASTKind::Prototype),
+        ReturnType(ReturnType),
+        Name(Name),
+        Params(Params) {}
 
   // Function *codegen();
 
@@ -249,19 +287,33 @@ public:
 
   const auto &getReturnType() const { return ReturnType; }
   const auto &getName() const { return Name; }
-  const auto &getParams() const { return Params; }
+  std::span<const std::pair<Symbol, Symbol>> getParams() const {
+    return Params;
+  }
 };
 
 /// FunctionAST - This class represents a function definition itself.
 class FunctionAST : public TopLevelDeclarationAST {
-  std::unique_ptr<PrototypeAST> Proto;
-  std::unique_ptr<StmtAST> Body;
+  PrototypeAST *Proto;
+  StmtAST *Body;
+  /// Tokens of the body, for a function whose body is parsed lazily.
+  uint32_t BodyBegin = 0;
+  uint32_t BodyEnd = 0;
 
 public:
-  FunctionAST(std::unique_ptr<PrototypeAST> Proto,
-              std::unique_ptr<StmtAST> Body)
-      : Proto(std::move(Proto)),
-        Body(std::move(Body)) {}
+  FunctionAST(PrototypeAST *Proto, StmtAST *Body)
+      : TopLevelDeclarationAST(ASTKind::Function),
+        Proto(Proto),
+        Body(Body) {}
+
+  /// A function whose body, the tokens [BodyBegin, BodyEnd), has been skipped
+  /// and is only parsed once somebody asks for it; see BodyMaterializer.
+  FunctionAST(PrototypeAST *Proto, uint32_t BodyBegin, uint32_t BodyEnd)
+      : TopLevelDeclarationAST(ASTKind::Function),
+        Proto(Proto),
+        Body(nullptr),
+        BodyBegin(BodyBegin),
+        BodyEnd(BodyEnd) {}
 
   // Function *codegen();
 
@@ -269,28 +321,146 @@ public:
 
   PrototypeAST &getProto() const { return *Proto; }
   StmtAST &getBody() const { return *Body; }
+
+  /// False for a lazily parsed function that has not been materialized yet.
+  bool hasBody() const { return Body != nullptr; }
+
+  std::pair<size_t, size_t> getBodyTokens() const {
+    return {BodyBegin, BodyEnd};
+  }
+
+  void setBody(StmtAST *NewBody) { Body = NewBody; }
+};
+
+/// ImportAST - An 'import' of another module, which makes the functions in
+/// its module summary visible.
+class ImportAST : public TopLevelDeclarationAST {
+  Symbol ModuleName;
+
+public:
+  ImportAST(Symbol ModuleName)
+      : TopLevelDeclarationAST(ASTKind::Import),
+        ModuleName(ModuleName) {}
+
+  void accept(ASTVisitor &V) override;
+
+  Symbol getModuleName() const { return ModuleName; }
 };
 
 class CompilationUnit {
 public:
-  CompilationUnit() = default;
-  CompilationUnit(std::vector<std::unique_ptr<TopLevelDeclarationAST>> Decls)
-      : Decls(std::move(Decls)) {}
+  /// Allocator for every node of this unit.
+  Arena &getArena() { return Nodes; }
+
+  void addPrototype(PrototypeAST *Proto) { Decls.push_back(Proto); }
+
+  void addFunction(FunctionAST *Func) { Decls.push_back(Func); }
+
+  void addImport(ImportAST *Import) { Decls.push_back(Import); }
+
+  std::vector<TopLevelDeclarationAST *> &getDecls() { return Decls; }
+
+  /// Move every declaration of \p Other, and the memory holding it, to the
+  /// end of this unit.
+  void append(CompilationUnit &&Other) {
+    Decls.insert(Decls.end(), Other.Decls.begin(), Other.Decls.end());
+    Other.Decls.clear();
+    Nodes.adopt(std::move(Other.Nodes));
+  }
+
+  void accept(ASTVisitor &V);
+
+private:
+  Arena Nodes;
+  std::vector<TopLevelDeclarationAST *> Decls;
+};
+
+/// ASTBuilder - Lets the Parser build a CompilationUnit. The Parser is written
+/// against this interface, so that FlatASTBuilder can stand in for it.
+class ASTBuilder {
+public:
+  using UnitType = CompilationUnit;
+  using ExprRef = ExprAST *;
+  using StmtRef = StmtAST *;
+  using PrototypeRef = PrototypeAST *;
+  using FunctionRef = FunctionAST *;
+  using ImportRef = ImportAST *;
+
+  ASTBuilder() = default;
+  explicit ASTBuilder(CompilationUnit &Unit) : Unit(&Unit) {}
+
+  ExprRef makeNumber(int64_t Val) { return make<NumberExprAST>(Val); }
 
-  void addPrototype(std::unique_ptr<PrototypeAST> &&Proto) {
-    Decls.emplace_back(std::move(Proto));
+  ExprRef makeVariable(Symbol Name) { return make<VariableExprAST>(Name); }
+
+  ExprRef makeUnary(char Opcode, ExprRef Operand) {
+    return make<UnaryExprAST>(Opcode, Operand);
   }
 
-  void addFunction(std::unique_ptr<FunctionAST> &&Func) {
-    Decls.emplace_back(std::move(Func));
+  ExprRef makeBinary(char Op, ExprRef LHS, ExprRef RHS) {
+    return make<BinaryExprAST>(Op, LHS, RHS);
   }
 
-  std::vector<std::unique_ptr<TopLevelDeclarationAST>> &getDecls() {
-    return Decls;
+  ExprRef makeCall(Symbol Callee, std::span<const ExprRef> Args) {
+    return make<CallExprAST>(Callee, Unit->getArena().copy(Args));
   }
 
-  void accept(ASTVisitor &V);
+  StmtRef makeBlock(std::span<const StmtRef> Stmts) {
+    return make<BlockStmtAST>(Unit->getArena().copy(Stmts));
+  }
+
+  StmtRef makeIf(ExprRef Cond, StmtRef Then, StmtRef Else = nullptr) {
+    return make<IfStmtAST>(Cond, Then, Else);
+  }
+
+  StmtRef makeWhile(ExprRef Cond, StmtRef Body) {
+    return make<WhileStmtAST>(Cond, Body);
+  }
+
+  StmtRef makeVar(Symbol Name, Symbol Type, ExprRef Init) {
+    return make<VarStmtAST>(Name, Type, Init);
+  }
+
+  StmtRef makeReturn(ExprRef Val = nullptr) {
+    return make<ReturnStmtAST>(Val);
+  }
+
+  StmtRef makeExprStmt(ExprRef E) { return make<ExprStmtAST>(E); }
+
+  PrototypeRef
+  makePrototype(Symbol ReturnType, Symbol Name,
+                std::span<const std::pair<Symbol, Symbol>> Params) {
+    return make<PrototypeAST>(ReturnType, Name,
+                              Unit->getArena().copy(Params));
+  }
+
+  FunctionRef makeFunction(PrototypeRef Proto, StmtRef Body) {
+    return make<FunctionAST>(Proto, Body);
+  }
+
+  /// A function whose body spans the tokens [BodyBegin, BodyEnd) and has not
+  /// been parsed.
+  FunctionRef makeLazyFunction(PrototypeRef Proto, size_t BodyBegin,
+                               size_t BodyEnd) {
+    return make<FunctionAST>(Proto, static_cast<uint32_t>(BodyBegin),
+                             static_cast<uint32_t>(BodyEnd));
+  }
+
+  void addPrototype(PrototypeRef Proto) { Unit->addPrototype(Proto); }
+
+  ImportRef makeImport(Symbol ModuleName) {
+    return make<ImportAST>(ModuleName);
+  }
+
+  void addFunction(FunctionRef Func) { Unit->addFunction(Func); }
+
+  void addImport(ImportRef Import) { Unit->addImport(Import); }
 
 private:
-  std::vector<std::unique_ptr<TopLevelDeclarationAST>> Decls;
+  template <typename T, typename... ArgTs>
+  T *make(ArgTs &&...Args) {
+    return Unit->getArena().create<T>(std::forward<ArgTs>(Args)...);
+  }
+
+  CompilationUnit *Unit = nullptr;
 };
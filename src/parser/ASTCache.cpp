@@ -0,0 +1,335 @@
+#include "parser/ASTCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmt/format.h"
+
+namespace {
+
+/// Bump whenever the layout of an entry or of FlatAST::Node changes.
+constexpr uint32_t FormatVersion = 3;
+
+static_assert(sizeof(FlatAST::NodeRef) == sizeof(uint32_t));
+
+constexpr char Magic[8] = {'T', 'O', 'Y', 'A', 'S', 'T', '\n', '\0'};
+
+/// An entry is this header followed by the arrays it counts, in order: the
+/// nodes, the lists, the parameters as pairs of local name IDs, the decls,
+/// NumNames + 1 offsets into the name bytes, and the name bytes. Checksum is
+/// the hash of everything after the header.
+struct Header {
+  char Magic[8];
+  uint32_t FormatVersion;
+  uint32_t NodeSize;
+  uint64_t SourceSize;
+  uint64_t NumNodes;
+  uint64_t NumLists;
+  uint64_t NumParams;
+  uint64_t NumDecls;
+  uint64_t NumNames;
+  uint64_t NameBytes;
+  uint64_t Checksum;
+};
+
+/// A parameter as stored in an entry.
+struct LocalParam {
+  uint32_t Name;
+  uint32_t Type;
+};
+
+/// Call \p F on every operand field of \p N that holds a Symbol ID.
+template <typename FnT>
+void forEachNameField(FlatAST::Node &N, FnT F) {
+  switch (N.K) {
+  case ASTKind::Variable:
+  case ASTKind::Call:
+  case ASTKind::Prototype:
+  case ASTKind::Import: F(N.A); break;
+  case ASTKind::Var:
+    F(N.A);
+    F(N.B);
+    break;
+  default: break;
+  }
+}
+
+/// Copy \p Count elements of T from \p Cur into \p Out and advance \p Cur.
+template <typename T>
+void readArray(const char *&Cur, size_t Count, std::vector<T> &Out) {
+  Out.resize(Count);
+  std::memcpy(Out.data(), Cur, Count * sizeof(T));
+  Cur += Count * sizeof(T);
+}
+
+template <typename T>
+void appendArray(std::string &Out, const std::vector<T> &Items) {
+  Out.append(reinterpret_cast<const char *>(Items.data()),
+             Items.size() * sizeof(T));
+}
+
+/// What a child field may refer to.
+enum class Category { Invalid, Expr, Stmt, Decl };
+
+Category getCategory(ASTKind K) {
+  switch (K) {
+#define TOY_EXPR_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return Category::Expr;
+#define TOY_STMT_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return Category::Stmt;
+#define TOY_DECL_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return Category::Decl;
+#include "parser/ASTNodes.def"
+  }
+  return Category::Invalid;
+}
+
+} // namespace
+
+ASTCache::ASTCache(std::string Dir, const SourceBuffer &Buffer)
+    : SourceSize(Buffer.size()) {
+  ::mkdir(Dir.c_str(), 0777);
+
+  uint64_t Key = hash(TOY_VERSION);
+  Key = hash({reinterpret_cast<const char *>(&FormatVersion),
+              sizeof(FormatVersion)},
+             Key);
+  Key = hash(Buffer.getText(), Key);
+  Path = fmt::format("{}/{:016x}.ast", Dir, Key);
+}
+
+uint64_t ASTCache::hash(std::string_view Bytes, uint64_t Seed) {
+  constexpr uint64_t Prime = 0x100000001b3ULL;
+
+  // Mix in whole 8-byte words; a byte at a time would make hashing a large
+  // source cost more than loading its cached tree.
+  uint64_t Hash = Seed;
+  size_t I = 0;
+  for (; I + sizeof(uint64_t) <= Bytes.size(); I += sizeof(uint64_t)) {
+    uint64_t Word;
+    std::memcpy(&Word, Bytes.data() + I, sizeof(Word));
+    Hash = (Hash ^ Word) * Prime;
+  }
+  for (; I < Bytes.size(); ++I)
+    Hash = (Hash ^ static_cast<unsigned char>(Bytes[I])) * Prime;
+  return Hash;
+}
+
+bool ASTCache::load(FlatAST &Tree) {
+  int FD = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD < 0)
+    return false;
+
+  struct stat Stat;
+  void *Addr = MAP_FAILED;
+  size_t Size = 0;
+  if (::fstat(FD, &Stat) == 0 && Stat.st_size >= off_t(sizeof(Header))) {
+    Size = Stat.st_size;
+    Addr = ::mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+  }
+  ::close(FD);
+  if (Addr == MAP_FAILED)
+    return false;
+
+  const char *Cur = static_cast<const char *>(Addr);
+  Header H;
+  std::memcpy(&H, Cur, sizeof(H));
+  Cur += sizeof(H);
+
+  // Every count is at most the size of the file, so that the sum below
+  // cannot wrap around.
+  bool CountsFit = H.NumNodes <= Size && H.NumLists <= Size &&
+                   H.NumParams <= Size && H.NumDecls <= Size &&
+                   H.NumNames < Size && H.NameBytes <= Size;
+  uint64_t Expected = sizeof(Header) + H.NumNodes * sizeof(FlatAST::Node) +
+                      H.NumLists * sizeof(uint32_t) +
+                      H.NumParams * sizeof(LocalParam) +
+                      H.NumDecls * sizeof(uint32_t) +
+                      (H.NumNames + 1) * sizeof(uint32_t) + H.NameBytes;
+  if (std::memcmp(H.Magic, Magic, sizeof(Magic)) != 0 ||
+      H.FormatVersion != FormatVersion ||
+      H.NodeSize != sizeof(FlatAST::Node) || H.SourceSize != SourceSize ||
+      !CountsFit || Expected != Size ||
+      H.Checksum != hash({Cur, Size - sizeof(Header)})) {
+    ::munmap(Addr, Size);
+    return false;
+  }
+
+  readArray(Cur, H.NumNodes, Tree.Nodes);
+  readArray(Cur, H.NumLists, Tree.Lists);
+  std::vector<LocalParam> Params;
+  readArray(Cur, H.NumParams, Params);
+  readArray(Cur, H.NumDecls, Tree.Decls);
+  std::vector<uint32_t> NameOffsets;
+  readArray(Cur, H.NumNames + 1, NameOffsets);
+
+  bool Valid = NameOffsets.front() == 0 &&
+               NameOffsets.back() == H.NameBytes &&
+               std::is_sorted(NameOffsets.begin(), NameOffsets.end());
+
+  // Intern the names, then translate the local IDs of the entry into the
+  // Symbol IDs of this process.
+  std::vector<Symbol> Names;
+  Names.reserve(H.NumNames);
+  for (size_t I = 0; Valid && I < H.NumNames; ++I)
+    Names.push_back(Symbol::intern(std::string_view(
+        Cur + NameOffsets[I], NameOffsets[I + 1] - NameOffsets[I])));
+  ::munmap(Addr, Size);
+
+  auto Translate = [&](uint32_t Local) {
+    if (Local >= Names.size()) {
+      Valid = false;
+      return Symbol();
+    }
+    return Names[Local];
+  };
+  for (auto &N : Tree.Nodes)
+    forEachNameField(N, [&](uint32_t &Field) {
+      Field = Translate(Field).getID();
+    });
+  Tree.Params.reserve(Params.size());
+  for (auto [Name, Type] : Params)
+    Tree.Params.emplace_back(Translate(Name), Translate(Type));
+
+  if (!Valid || !isWellFormed(Tree)) {
+    Tree = FlatAST();
+    return false;
+  }
+  return true;
+}
+
+bool ASTCache::isWellFormed(const FlatAST &Tree) {
+  using Kind = FlatAST::Kind;
+  const uint32_t None = FlatAST::NodeRef().getIndex();
+
+  // Children come before their parents, which also rules out cycles.
+  uint32_t Parent = 0;
+  auto IsChild = [&](uint32_t Field, Category C) {
+    return Field < Parent && getCategory(Tree.Nodes[Field].K) == C;
+  };
+  auto IsOptionalChild = [&](uint32_t Field, Category C) {
+    return Field == None || IsChild(Field, C);
+  };
+  auto IsList = [&](const FlatAST::Node &N, Category C) {
+    if (uint64_t(N.B) + N.C > Tree.Lists.size())
+      return false;
+    return std::all_of(
+        Tree.Lists.begin() + N.B, Tree.Lists.begin() + N.B + N.C,
+        [&](FlatAST::NodeRef Ref) { return IsChild(Ref.getIndex(), C); });
+  };
+
+  for (; Parent < Tree.Nodes.size(); ++Parent) {
+    const auto &N = Tree.Nodes[Parent];
+    bool Valid = true;
+    switch (N.K) {
+    case Kind::Number:
+    case Kind::Variable:
+    case Kind::Import: break;
+    case Kind::Unary:
+    case Kind::ExprStmt: Valid = IsChild(N.A, Category::Expr); break;
+    case Kind::Binary:
+      Valid = IsChild(N.A, Category::Expr) && IsChild(N.B, Category::Expr);
+      break;
+    case Kind::Call: Valid = IsList(N, Category::Expr); break;
+    case Kind::Block: Valid = IsList(N, Category::Stmt); break;
+    case Kind::If:
+      Valid = IsChild(N.A, Category::Expr) && IsChild(N.B, Category::Stmt) &&
+              IsOptionalChild(N.C, Category::Stmt);
+      break;
+    case Kind::While:
+      Valid = IsChild(N.A, Category::Expr) && IsChild(N.B, Category::Stmt);
+      break;
+    case Kind::Var: Valid = IsOptionalChild(N.C, Category::Expr); break;
+    case Kind::Return: Valid = IsOptionalChild(N.A, Category::Expr); break;
+    case Kind::Prototype:
+      // The return type sits right before the parameters.
+      Valid = N.B != 0 && uint64_t(N.B) + N.C <= Tree.Params.size();
+      break;
+    case Kind::Function:
+      Valid = N.A < Parent && Tree.Nodes[N.A].K == Kind::Prototype &&
+              IsChild(N.B, Category::Stmt);
+      break;
+    default: Valid = false; break;
+    }
+    if (!Valid)
+      return false;
+  }
+
+  return std::all_of(Tree.Decls.begin(), Tree.Decls.end(),
+                     [&](FlatAST::NodeRef Ref) {
+                       return Ref.getIndex() < Tree.Nodes.size() &&
+                              getCategory(Tree[Ref].K) == Category::Decl;
+                     });
+}
+
+void ASTCache::store(const FlatAST &Tree) {
+  // Give every Symbol the tree uses a local ID, in order of appearance.
+  std::unordered_map<uint32_t, uint32_t> LocalIDs;
+  std::vector<Symbol> Names;
+  auto Local = [&](uint32_t ID) {
+    auto [It, Inserted] =
+        LocalIDs.try_emplace(ID, static_cast<uint32_t>(Names.size()));
+    if (Inserted)
+      Names.push_back(Symbol::fromID(ID));
+    return It->second;
+  };
+
+  std::vector<FlatAST::Node> Nodes = Tree.Nodes;
+  for (auto &N : Nodes)
+    forEachNameField(N, [&](uint32_t &Field) { Field = Local(Field); });
+  std::vector<LocalParam> Params;
+  Params.reserve(Tree.Params.size());
+  for (auto [Name, Type] : Tree.Params)
+    Params.push_back({Local(Name.getID()), Local(Type.getID())});
+
+  std::vector<uint32_t> NameOffsets{0};
+  std::string NameBytes;
+  for (auto Name : Names) {
+    NameBytes += Name.str();
+    NameOffsets.push_back(static_cast<uint32_t>(NameBytes.size()));
+  }
+
+  Header H = {};
+  std::memcpy(H.Magic, Magic, sizeof(Magic));
+  H.FormatVersion = FormatVersion;
+  H.NodeSize = sizeof(FlatAST::Node);
+  H.SourceSize = SourceSize;
+  H.NumNodes = Nodes.size();
+  H.NumLists = Tree.Lists.size();
+  H.NumParams = Params.size();
+  H.NumDecls = Tree.Decls.size();
+  H.NumNames = Names.size();
+  H.NameBytes = NameBytes.size();
+
+  std::string Payload;
+  appendArray(Payload, Nodes);
+  appendArray(Payload, Tree.Lists);
+  appendArray(Payload, Params);
+  appendArray(Payload, Tree.Decls);
+  appendArray(Payload, NameOffsets);
+  Payload += NameBytes;
+  H.Checksum = hash(Payload);
+
+  // Write to a private file and rename it into place, so that a concurrent
+  // compilation never sees half an entry.
+  auto TmpPath = fmt::format("{}.{}.tmp", Path, ::getpid());
+  std::FILE *File = std::fopen(TmpPath.c_str(), "wb");
+  if (File == nullptr)
+    return;
+
+  bool Success = std::fwrite(&H, sizeof(H), 1, File) == 1 &&
+                 std::fwrite(Payload.data(), 1, Payload.size(), File) ==
+                     Payload.size();
+  Success = std::fclose(File) == 0 && Success;
+
+  if (!Success || std::rename(TmpPath.c_str(), Path.c_str()) != 0)
+    std::remove(TmpPath.c_str());
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "parser/FlatAST.h"
+#include "parser/SourceBuffer.h"
+
+/// ASTCache - Parsed FlatASTs kept on disk, keyed by a hash of the source
+/// bytes and the compiler version, so that compiling an unchanged file again
+/// skips lexing and parsing altogether.
+///
+/// An entry holds the arrays of the tree as they are in memory, and its own
+/// table of the names it uses, because Symbol IDs only mean something within
+/// one process. Loading maps the file, interns the names and copies the arrays
+/// back, translating name fields on the way.
+class ASTCache {
+public:
+  /// The entry for \p Buffer in the directory \p Dir, which is created if
+  /// needed.
+  ASTCache(std::string Dir, const SourceBuffer &Buffer);
+
+  /// Fill the empty \p Tree with the cached tree. Returns false, leaving
+  /// \p Tree empty, if there is no usable entry: none, one for other bytes,
+  /// or one that is truncated, fails its checksum or does not describe a
+  /// well-formed tree.
+  bool load(FlatAST &Tree);
+
+  /// Save \p Tree as the parse of the buffer. Failure to write is not an
+  /// error; the next compilation will simply miss.
+  void store(const FlatAST &Tree);
+
+  const std::string &getEntryPath() const { return Path; }
+
+  /// FNV-1a style hash of \p Bytes, taken a word at a time, starting from
+  /// \p Seed.
+  static uint64_t hash(std::string_view Bytes,
+                       uint64_t Seed = 0xcbf29ce484222325ULL);
+
+private:
+  /// Whether every child, list range and decl of \p Tree is in bounds and
+  /// of a kind its parent can hold, so that walking it cannot go astray.
+  static bool isWellFormed(const FlatAST &Tree);
+
+  std::string Path;
+  size_t SourceSize;
+};
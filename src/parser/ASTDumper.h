@@ -2,96 +2,122 @@
 
 #include "fmt/format.h"
 
-#include "parser/ASTVisitor.h"
+#include "parser/ASTWalker.h"
+#include "parser/FlatAST.h"
 
-class ASTDumper : public ASTVisitor {
+class ASTDumper : public ASTWalker<ASTDumper> {
 public:
-  ASTDumper(std::FILE *OS, CompilationUnit &U) : OS(OS) { U.accept(*this); }
+  ASTDumper(std::FILE *OS, CompilationUnit &U) : OS(OS) {
+    for (auto *Decl : U.getDecls())
+      walk(*Decl);
+  }
+
+  /// Print \p Tree in exactly the format used for a CompilationUnit.
+  ASTDumper(std::FILE *OS, const FlatAST &Tree) : OS(OS) {
+    for (auto Decl : Tree.getDecls())
+      dump(Tree, Decl);
+  }
 
-  void visit(NumberExprAST &E) override { print("Number", E.getVal()); }
+  void visit(NumberExprAST &E) { print("Number", E.getVal()); }
 
-  void visit(VariableExprAST &E) override { print("Variable", E.getName()); }
+  void visit(VariableExprAST &E) { print("Variable", E.getName()); }
 
-  void visit(UnaryExprAST &E) override {
+  void visit(UnaryExprAST &E) {
     print("UnaryExpr", E.getOpcode());
     indent();
-    E.getOperand().accept(*this);
+    walk(E.getOperand());
     unindent();
   }
 
-  void visit(BinaryExprAST &E) override {
+  void visit(BinaryExprAST &E) {
     print("BinaryExpr", E.getOpcode());
     indent();
-    E.getLHS().accept(*this);
-    E.getRHS().accept(*this);
+    walk(E.getLHS());
+    walk(E.getRHS());
     unindent();
   }
 
-  void visit(CallExprAST &E) override {
+  void visit(CallExprAST &E) {
     print("CallExpr", E.getCallee());
     indent();
     for (const auto &Arg : E.getArgs())
-      Arg->accept(*this);
+      walk(*Arg);
     unindent();
   }
 
-  void visit(BlockStmtAST &S) override {
+  void visit(BlockStmtAST &S) {
     print("BlockStmt");
     indent();
     for (const auto &Stmt : S.getStmts())
-      Stmt->accept(*this);
+      walk(*Stmt);
     unindent();
   }
 
-  void visit(IfStmtAST &S) override {
+  void visit(IfStmtAST &S) {
     print("IfStmt");
     indent();
-    S.getCond().accept(*this);
-    S.getThen().accept(*this);
+    walk(S.getCond());
+    walk(S.getThen());
     if (auto *Else = S.getElse(); Else != nullptr)
-      Else->accept(*this);
+      walk(*Else);
     unindent();
   }
 
-  void visit(WhileStmtAST &S) override {
+  void visit(WhileStmtAST &S) {
     print("WhileStmt");
     indent();
-    S.getCond().accept(*this);
-    S.getBody().accept(*this);
+    walk(S.getCond());
+    walk(S.getBody());
     unindent();
   }
 
-  void visit(VarStmtAST &E) override {
+  void visit(VarStmtAST &E) {
     print("VarStmt");
     indent();
-    print(E.getVarName(), E.getVarType());
+    print(E.getVarName().str(), E.getVarType());
     if (auto *Init = E.getInit(); Init)
-      E.getInit()->accept(*this);
+      walk(*Init);
     unindent();
   }
 
-  void visit(ReturnStmtAST &S) override {
+  void visit(ReturnStmtAST &S) {
     print("ReturnStmt");
     auto *E = S.getExpr();
     if (!E)
       return;
 
     indent();
-    E->accept(*this);
+    walk(*E);
     unindent();
   }
 
-  void visit(ExprStmtAST &S) override {
+  void visit(ExprStmtAST &S) {
     print("ExprStmt");
     indent();
-    S.getExpr().accept(*this);
+    walk(S.getExpr());
+    unindent();
+  }
+
+  void visit(PrototypeAST &P) {
+    printPrototype(P.getParams(), P.getReturnType());
+  }
+
+  void visit(FunctionAST &Fn) {
+    print("Function");
+    indent();
+    walk(Fn.getProto());
+    if (Fn.hasBody())
+      walk(Fn.getBody());
     unindent();
   }
 
-  void visit(PrototypeAST &P) override {
+  void visit(ImportAST &I) { print("Import", I.getModuleName()); }
+
+protected:
+  void printPrototype(std::span<const std::pair<Symbol, Symbol>> Params,
+                      Symbol ReturnType) {
     std::string out;
 
-    const auto &Params = P.getParams();
     if (Params.empty())
       fmt::format_to(std::back_inserter(out), "()");
     else {
@@ -100,27 +126,73 @@ public:
         fmt::format_to(std::back_inserter(out), ", {}", Params[i].second);
       fmt::format_to(std::back_inserter(out), ")");
     }
-    fmt::format_to(std::back_inserter(out), " : {}", P.getReturnType());
+    fmt::format_to(std::back_inserter(out), " : {}", ReturnType);
     print("Prototype");
     indent();
     print(out);
     unindent();
   }
 
-  void visit(FunctionAST &Fn) override {
-    print("Function");
+  /// Print the subtree of \p Tree rooted at \p Ref.
+  void dump(const FlatAST &Tree, FlatAST::NodeRef Ref) {
+    using Kind = FlatAST::Kind;
+
+    const auto &N = Tree[Ref];
+    switch (N.K) {
+    case Kind::Number: print("Number", FlatAST::getNumber(N)); return;
+    case Kind::Variable: print("Variable", FlatAST::symbol(N.A)); return;
+    case Kind::Unary: print("UnaryExpr", N.Op); break;
+    case Kind::Binary: print("BinaryExpr", N.Op); break;
+    case Kind::Call: print("CallExpr", FlatAST::symbol(N.A)); break;
+    case Kind::Block: print("BlockStmt"); break;
+    case Kind::If: print("IfStmt"); break;
+    case Kind::While: print("WhileStmt"); break;
+    case Kind::Var: print("VarStmt"); break;
+    case Kind::Return:
+      print("ReturnStmt");
+      if (!FlatAST::child(N.A))
+        return;
+      break;
+    case Kind::ExprStmt: print("ExprStmt"); break;
+    case Kind::Prototype:
+      printPrototype(Tree.getParams(N), Tree.getReturnType(N));
+      return;
+    case Kind::Function: print("Function"); break;
+    case Kind::Import: print("Import", FlatAST::symbol(N.A)); return;
+    }
+
     indent();
-    Fn.getProto().accept(*this);
-    Fn.getBody().accept(*this);
+    switch (N.K) {
+    case Kind::Unary:
+    case Kind::Return:
+    case Kind::ExprStmt: dump(Tree, FlatAST::child(N.A)); break;
+    case Kind::Binary:
+    case Kind::While:
+    case Kind::Function:
+      dump(Tree, FlatAST::child(N.A));
+      dump(Tree, FlatAST::child(N.B));
+      break;
+    case Kind::If:
+      dump(Tree, FlatAST::child(N.A));
+      dump(Tree, FlatAST::child(N.B));
+      if (auto Else = FlatAST::child(N.C))
+        dump(Tree, Else);
+      break;
+    case Kind::Call:
+    case Kind::Block:
+      for (auto Child : Tree.getList(N))
+        dump(Tree, Child);
+      break;
+    case Kind::Var:
+      print(FlatAST::symbol(N.A).str(), FlatAST::symbol(N.B));
+      if (auto Init = FlatAST::child(N.C))
+        dump(Tree, Init);
+      break;
+    default: break;
+    }
     unindent();
   }
 
-  void visit(CompilationUnit &U) override {
-    for (const auto &Fn : U.getDecls())
-      Fn->accept(*this);
-  }
-
-protected:
   void indent() { ++Indent; }
 
   void unindent() { --Indent; }
@@ -128,12 +200,12 @@ protected:
   template <typename... T>
   void print(std::string_view name, T &&...Value) {
     printIndent();
-    fmt::println(OS, "{} ({})", name, std::forward<T>(Value)...);
+    fmt::print(OS, "{} ({})\n", name, std::forward<T>(Value)...);
   }
 
   void print(std::string_view name) {
     printIndent();
-    fmt::println(OS, "{}", name);
+    fmt::print(OS, "{}\n", name);
   }
 
   void printIndent() {
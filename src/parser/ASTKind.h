@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+/// ASTKind - Tag stored in every AST node, in both the pointer-based AST and
+/// the FlatAST, naming its concrete kind.
+enum class ASTKind : uint8_t {
+#define TOY_AST_NODE(Kind, Class) Kind,
+#include "parser/ASTNodes.def"
+};
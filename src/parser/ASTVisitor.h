@@ -18,5 +18,6 @@ public:
   virtual void visit(ExprStmtAST &) {}
   virtual void visit(PrototypeAST &) {}
   virtual void visit(FunctionAST &) {}
+  virtual void visit(ImportAST &) {}
   virtual void visit(CompilationUnit &) {}
 };
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cassert>
+
+#include "parser/AST.h"
+
+/// ASTWalker - Statically dispatched traversal of the pointer-based AST.
+///
+/// walk() switches on the kind tag of a node and calls the visit() overload
+/// of DerivedT for its concrete class directly, so there is no accept()
+/// round trip through two vtables and the calls can be inlined. Every visit()
+/// defaults to doing nothing and returning RetTy(); a DerivedT that does not
+/// override all of them must bring the defaults in with
+/// `using ASTWalker::visit`.
+template <typename DerivedT, typename RetTy = void>
+class ASTWalker {
+public:
+  RetTy walk(ExprAST &E) {
+    switch (E.getKind()) {
+#define TOY_EXPR_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return derived().visit(static_cast<Class &>(E));
+#include "parser/ASTNodes.def"
+    default: break;
+    }
+    assert(false && "Not an expression");
+    return RetTy();
+  }
+
+  RetTy walk(StmtAST &S) {
+    switch (S.getKind()) {
+#define TOY_STMT_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return derived().visit(static_cast<Class &>(S));
+#include "parser/ASTNodes.def"
+    default: break;
+    }
+    assert(false && "Not a statement");
+    return RetTy();
+  }
+
+  RetTy walk(TopLevelDeclarationAST &D) {
+    switch (D.getKind()) {
+#define TOY_DECL_NODE(Kind, Class)                                             \
+  case ASTKind::Kind: return derived().visit(static_cast<Class &>(D));
+#include "parser/ASTNodes.def"
+    default: break;
+    }
+    assert(false && "Not a top-level declaration");
+    return RetTy();
+  }
+
+#define TOY_AST_NODE(Kind, Class)                                              \
+  RetTy visit(Class &) { return RetTy(); }
+#include "parser/ASTNodes.def"
+
+private:
+  DerivedT &derived() { return *static_cast<DerivedT *>(this); }
+};
@@ -0,0 +1,137 @@
+#include "parser/BodyMaterializer.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include "parser/ASTWalker.h"
+
+namespace {
+
+/// Collects the callee of every call in a function body. Expressions are
+/// walked with a worklist, since they may nest arbitrarily deep.
+class CallCollector : public ASTWalker<CallCollector> {
+public:
+  explicit CallCollector(std::vector<Symbol> &Callees) : Callees(Callees) {}
+
+  using ASTWalker::visit;
+
+  void visit(BlockStmtAST &S) {
+    for (auto *Stmt : S.getStmts())
+      walk(*Stmt);
+  }
+
+  void visit(IfStmtAST &S) {
+    collect(S.getCond());
+    walk(S.getThen());
+    if (auto *Else = S.getElse())
+      walk(*Else);
+  }
+
+  void visit(WhileStmtAST &S) {
+    collect(S.getCond());
+    walk(S.getBody());
+  }
+
+  void visit(VarStmtAST &S) {
+    if (auto *Init = S.getInit())
+      collect(*Init);
+  }
+
+  void visit(ReturnStmtAST &S) {
+    if (auto *E = S.getExpr())
+      collect(*E);
+  }
+
+  void visit(ExprStmtAST &S) { collect(S.getExpr()); }
+
+private:
+  void collect(ExprAST &Root) {
+    Pending.push_back(&Root);
+    while (!Pending.empty()) {
+      auto *E = Pending.back();
+      Pending.pop_back();
+      switch (E->getKind()) {
+      case ASTKind::Unary:
+        Pending.push_back(&static_cast<UnaryExprAST *>(E)->getOperand());
+        break;
+      case ASTKind::Binary: {
+        auto *Binary = static_cast<BinaryExprAST *>(E);
+        Pending.push_back(&Binary->getLHS());
+        Pending.push_back(&Binary->getRHS());
+        break;
+      }
+      case ASTKind::Call: {
+        auto *Call = static_cast<CallExprAST *>(E);
+        Callees.push_back(Call->getCallee());
+        Pending.insert(Pending.end(), Call->getArgs().begin(),
+                       Call->getArgs().end());
+        break;
+      }
+      default: break;
+      }
+    }
+  }
+
+  std::vector<Symbol> &Callees;
+  std::vector<ExprAST *> Pending;
+};
+
+} // namespace
+
+BodyMaterializer::BodyMaterializer(const SourceBuffer &Buffer,
+                                   const TokenBuffer &Tokens,
+                                   CompilationUnit &Unit)
+    : Unit(Unit),
+      P(Buffer, Tokens) {
+  for (auto *Decl : Unit.getDecls()) {
+    if (Decl->getKind() != ASTKind::Function)
+      continue;
+    auto *Fn = static_cast<FunctionAST *>(Decl);
+    // Like IRGen, the first definition of a name wins.
+    Definitions.try_emplace(Fn->getProto().getName(), Fn);
+  }
+}
+
+bool BodyMaterializer::materialize(FunctionAST &Fn) {
+  if (Fn.hasBody())
+    return true;
+
+  auto [Begin, End] = Fn.getBodyTokens();
+  auto *Body = P.ParseLazyBody(Unit, Begin, End);
+  if (Body == nullptr)
+    return false;
+
+  Fn.setBody(Body);
+  ++NumMaterialized;
+  return true;
+}
+
+void BodyMaterializer::materializeReachable(std::span<const Symbol> Roots) {
+  std::vector<Symbol> Worklist;
+  for (auto Root : Roots) {
+    if (Definitions.contains(Root))
+      Worklist.push_back(Root);
+  }
+
+  if (Worklist.empty()) {
+    for (auto *Decl : Unit.getDecls()) {
+      if (Decl->getKind() == ASTKind::Function)
+        materialize(*static_cast<FunctionAST *>(Decl));
+    }
+    return;
+  }
+
+  std::unordered_set<FunctionAST *> Visited;
+  CallCollector Collector(Worklist);
+  while (!Worklist.empty()) {
+    auto It = Definitions.find(Worklist.back());
+    Worklist.pop_back();
+    // Externs and unknown callees have no body to parse.
+    if (It == Definitions.end() || !Visited.insert(It->second).second)
+      continue;
+
+    auto *Fn = It->second;
+    if (materialize(*Fn))
+      Collector.walk(Fn->getBody());
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <unordered_map>
+
+#include "parser/AST.h"
+#include "parser/Parser.h"
+#include "parser/SourceBuffer.h"
+#include "parser/TokenBuffer.h"
+#include "support/Symbol.h"
+
+/// BodyMaterializer - Parses the bodies of a unit that was parsed with lazy
+/// bodies, on demand. The tokens of the unit must stay alive.
+class BodyMaterializer {
+public:
+  BodyMaterializer(const SourceBuffer &Buffer, const TokenBuffer &Tokens,
+                   CompilationUnit &Unit);
+
+  /// Parse the body of \p Fn unless it already has one. Returns false if the
+  /// body does not parse.
+  bool materialize(FunctionAST &Fn);
+
+  /// Materialize every function that can be called, directly or not, from one
+  /// of \p Roots. If none of the roots is defined in the unit, everything is
+  /// materialized.
+  void materializeReachable(std::span<const Symbol> Roots);
+
+  /// Number of bodies parsed so far.
+  size_t getNumMaterialized() const { return NumMaterialized; }
+
+private:
+  CompilationUnit &Unit;
+  Parser P;
+  std::unordered_map<Symbol, FunctionAST *> Definitions;
+  size_t NumMaterialized = 0;
+};
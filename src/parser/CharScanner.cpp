@@ -0,0 +1,325 @@
+#include "parser/CharScanner.h"
+
+#include <cassert>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TOY_SCANNER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define TOY_SCANNER_NEON 1
+#endif
+
+#if TOY_SCANNER_X86
+#define TOY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace scanner {
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Character classes
+//
+// Each class knows how to test one byte, and how to produce a lane mask of the
+// bytes that belong to it for every vector width we support.
+//===----------------------------------------------------------------------===//
+
+#if TOY_SCANNER_X86
+/// Lanes of V whose unsigned value lies in [Lo, Hi].
+inline __m128i inRange(__m128i V, char Lo, char Hi) {
+  __m128i Shifted = _mm_sub_epi8(V, _mm_set1_epi8(Lo));
+  __m128i Limit = _mm_set1_epi8(static_cast<char>(Hi - Lo));
+  return _mm_cmpeq_epi8(_mm_min_epu8(Shifted, Limit), Shifted);
+}
+
+TOY_TARGET_AVX2 inline __m256i inRange(__m256i V, char Lo, char Hi) {
+  __m256i Shifted = _mm256_sub_epi8(V, _mm256_set1_epi8(Lo));
+  __m256i Limit = _mm256_set1_epi8(static_cast<char>(Hi - Lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(Shifted, Limit), Shifted);
+}
+#endif
+
+#if TOY_SCANNER_NEON
+inline uint8x16_t inRange(uint8x16_t V, uint8_t Lo, uint8_t Hi) {
+  return vcleq_u8(vsubq_u8(V, vdupq_n_u8(Lo)), vdupq_n_u8(Hi - Lo));
+}
+#endif
+
+struct Whitespace {
+  static bool scalar(unsigned char C) {
+    return C == ' ' || (C >= '\t' && C <= '\r');
+  }
+
+#if TOY_SCANNER_X86
+  static __m128i sse2(__m128i V) {
+    return _mm_or_si128(inRange(V, '\t', '\r'),
+                        _mm_cmpeq_epi8(V, _mm_set1_epi8(' ')));
+  }
+
+  TOY_TARGET_AVX2 static __m256i avx2(__m256i V) {
+    return _mm256_or_si256(inRange(V, '\t', '\r'),
+                           _mm256_cmpeq_epi8(V, _mm256_set1_epi8(' ')));
+  }
+#endif
+
+#if TOY_SCANNER_NEON
+  static uint8x16_t neon(uint8x16_t V) {
+    return vorrq_u8(inRange(V, '\t', '\r'), vceqq_u8(V, vdupq_n_u8(' ')));
+  }
+#endif
+};
+
+struct Identifier {
+  static bool scalar(unsigned char C) {
+    return (C >= '0' && C <= '9') || ((C | 0x20) >= 'a' && (C | 0x20) <= 'z') ||
+           C == '_';
+  }
+
+#if TOY_SCANNER_X86
+  static __m128i sse2(__m128i V) {
+    // Setting bit 5 folds upper case onto lower case.
+    __m128i Lower = _mm_or_si128(V, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(inRange(V, '0', '9'),
+                                     inRange(Lower, 'a', 'z')),
+                        _mm_cmpeq_epi8(V, _mm_set1_epi8('_')));
+  }
+
+  TOY_TARGET_AVX2 static __m256i avx2(__m256i V) {
+    __m256i Lower = _mm256_or_si256(V, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(inRange(V, '0', '9'),
+                                           inRange(Lower, 'a', 'z')),
+                           _mm256_cmpeq_epi8(V, _mm256_set1_epi8('_')));
+  }
+#endif
+
+#if TOY_SCANNER_NEON
+  static uint8x16_t neon(uint8x16_t V) {
+    uint8x16_t Lower = vorrq_u8(V, vdupq_n_u8(0x20));
+    return vorrq_u8(vorrq_u8(inRange(V, '0', '9'), inRange(Lower, 'a', 'z')),
+                    vceqq_u8(V, vdupq_n_u8('_')));
+  }
+#endif
+};
+
+struct Digit {
+  static bool scalar(unsigned char C) { return C >= '0' && C <= '9'; }
+
+#if TOY_SCANNER_X86
+  static __m128i sse2(__m128i V) { return inRange(V, '0', '9'); }
+
+  TOY_TARGET_AVX2 static __m256i avx2(__m256i V) {
+    return inRange(V, '0', '9');
+  }
+#endif
+
+#if TOY_SCANNER_NEON
+  static uint8x16_t neon(uint8x16_t V) { return inRange(V, '0', '9'); }
+#endif
+};
+
+struct NotLineEnd {
+  static bool scalar(unsigned char C) { return C != '\n' && C != '\r'; }
+
+#if TOY_SCANNER_X86
+  static __m128i sse2(__m128i V) {
+    __m128i LineEnd = _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')),
+                                   _mm_cmpeq_epi8(V, _mm_set1_epi8('\r')));
+    return _mm_xor_si128(LineEnd, _mm_set1_epi8(-1));
+  }
+
+  TOY_TARGET_AVX2 static __m256i avx2(__m256i V) {
+    __m256i LineEnd =
+        _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\r')));
+    return _mm256_xor_si256(LineEnd, _mm256_set1_epi8(-1));
+  }
+#endif
+
+#if TOY_SCANNER_NEON
+  static uint8x16_t neon(uint8x16_t V) {
+    return vmvnq_u8(
+        vorrq_u8(vceqq_u8(V, vdupq_n_u8('\n')), vceqq_u8(V, vdupq_n_u8('\r'))));
+  }
+#endif
+};
+
+//===----------------------------------------------------------------------===//
+// Scanning loops
+//===----------------------------------------------------------------------===//
+
+template <typename ClassT>
+const char *scanScalar(const char *Cur, const char *End) {
+  while (Cur != End && ClassT::scalar(static_cast<unsigned char>(*Cur)))
+    ++Cur;
+  return Cur;
+}
+
+#if TOY_SCANNER_X86
+template <typename ClassT>
+const char *scanSSE2(const char *Cur, const char *End) {
+  while (End - Cur >= 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Cur));
+    unsigned Outside = ~_mm_movemask_epi8(ClassT::sse2(V)) & 0xFFFFU;
+    if (Outside != 0)
+      return Cur + __builtin_ctz(Outside);
+    Cur += 16;
+  }
+  return scanScalar<ClassT>(Cur, End);
+}
+
+template <typename ClassT>
+TOY_TARGET_AVX2 const char *scanAVX2(const char *Cur, const char *End) {
+  // Most runs (identifiers, indentation) are short. Probe the first 16 bytes
+  // with SSE2 so they do not pay for a full 32-byte load.
+  if (End - Cur >= 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Cur));
+    unsigned Outside = ~_mm_movemask_epi8(ClassT::sse2(V)) & 0xFFFFU;
+    if (Outside != 0)
+      return Cur + __builtin_ctz(Outside);
+    Cur += 16;
+  }
+
+  while (End - Cur >= 32) {
+    __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Cur));
+    unsigned Outside = ~static_cast<unsigned>(
+        _mm256_movemask_epi8(ClassT::avx2(V)));
+    if (Outside != 0)
+      return Cur + __builtin_ctz(Outside);
+    Cur += 32;
+  }
+  // Finish the tail with the 16-byte loop instead of going byte by byte.
+  return scanSSE2<ClassT>(Cur, End);
+}
+#endif
+
+#if TOY_SCANNER_NEON
+template <typename ClassT>
+const char *scanNEON(const char *Cur, const char *End) {
+  while (End - Cur >= 16) {
+    uint8x16_t V = vld1q_u8(reinterpret_cast<const uint8_t *>(Cur));
+    uint8x16_t Outside = vmvnq_u8(ClassT::neon(V));
+    // NEON has no movemask; shift-narrow each 16-bit pair down to one byte so
+    // that every input lane becomes a nibble of a 64-bit scalar.
+    uint8x8_t Nibbles = vshrn_n_u16(vreinterpretq_u16_u8(Outside), 4);
+    uint64_t Mask = vget_lane_u64(vreinterpret_u64_u8(Nibbles), 0);
+    if (Mask != 0)
+      return Cur + (__builtin_ctzll(Mask) >> 2);
+    Cur += 16;
+  }
+  return scanScalar<ClassT>(Cur, End);
+}
+#endif
+
+template <template <typename> class ScanT>
+constexpr ScanFunctions makeFunctions() {
+  return {&ScanT<Whitespace>::run, &ScanT<Identifier>::run,
+          &ScanT<Digit>::run, &ScanT<NotLineEnd>::run};
+}
+
+template <typename ClassT>
+struct ScalarScan {
+  static const char *run(const char *Cur, const char *End) {
+    return scanScalar<ClassT>(Cur, End);
+  }
+};
+
+#if TOY_SCANNER_X86
+template <typename ClassT>
+struct SSE2Scan {
+  static const char *run(const char *Cur, const char *End) {
+    return scanSSE2<ClassT>(Cur, End);
+  }
+};
+
+template <typename ClassT>
+struct AVX2Scan {
+  static const char *run(const char *Cur, const char *End) {
+    return scanAVX2<ClassT>(Cur, End);
+  }
+};
+#endif
+
+#if TOY_SCANNER_NEON
+template <typename ClassT>
+struct NEONScan {
+  static const char *run(const char *Cur, const char *End) {
+    return scanNEON<ClassT>(Cur, End);
+  }
+};
+#endif
+
+ScanFunctions getFunctions(ISA Kind) {
+  switch (Kind) {
+  case ISA::Scalar: return makeFunctions<ScalarScan>();
+#if TOY_SCANNER_X86
+  case ISA::SSE2: return makeFunctions<SSE2Scan>();
+  case ISA::AVX2: return makeFunctions<AVX2Scan>();
+#endif
+#if TOY_SCANNER_NEON
+  case ISA::NEON: return makeFunctions<NEONScan>();
+#endif
+  default: assert(false && "ISA is not compiled in"); break;
+  }
+  return makeFunctions<ScalarScan>();
+}
+
+ISA getBestISA() {
+#if TOY_SCANNER_X86
+  if (isSupported(ISA::AVX2))
+    return ISA::AVX2;
+  return ISA::SSE2;
+#elif TOY_SCANNER_NEON
+  return ISA::NEON;
+#else
+  return ISA::Scalar;
+#endif
+}
+
+ISA Selected = getBestISA();
+
+} // namespace
+
+ScanFunctions Active = getFunctions(Selected);
+
+bool isSupported(ISA Kind) {
+  switch (Kind) {
+  case ISA::Scalar: return true;
+#if TOY_SCANNER_X86
+  // SSE2 is part of the x86-64 baseline.
+  case ISA::SSE2: return true;
+  case ISA::AVX2:
+    // We may run from a static initializer, before libgcc has probed the CPU.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+#if TOY_SCANNER_NEON
+  // NEON is mandatory on AArch64.
+  case ISA::NEON: return true;
+#endif
+  default: return false;
+  }
+}
+
+void select(ISA Kind) {
+  assert(isSupported(Kind) && "Selected ISA is not supported");
+  Selected = Kind;
+  Active = getFunctions(Kind);
+}
+
+ISA getSelected() {
+  return Selected;
+}
+
+std::string_view getName(ISA Kind) {
+  switch (Kind) {
+  case ISA::Scalar: return "scalar";
+  case ISA::SSE2: return "sse2";
+  case ISA::AVX2: return "avx2";
+  case ISA::NEON: return "neon";
+  }
+  return "<unknown>";
+}
+
+} // namespace scanner
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string_view>
+
+//===----------------------------------------------------------------------===//
+// CharScanner - Bulk character-class scanning used by the Lexer.
+//===----------------------------------------------------------------------===//
+
+namespace scanner {
+
+/// The instruction set a scanning routine is implemented with. The best one
+/// supported by the running CPU is selected on first use; Scalar is always
+/// available.
+enum class ISA {
+  Scalar,
+  SSE2,
+  AVX2,
+  NEON,
+};
+
+/// Every routine returns a pointer to the first byte in [Cur, End) that does
+/// NOT belong to the scanned class, or End if there is none.
+struct ScanFunctions {
+  /// [ \t\n\v\f\r]*
+  const char *(*SkipWhitespace)(const char *Cur, const char *End);
+  /// [a-zA-Z0-9_]*
+  const char *(*SkipIdentifier)(const char *Cur, const char *End);
+  /// [0-9]*
+  const char *(*SkipDigits)(const char *Cur, const char *End);
+  /// [^\n\r]*
+  const char *(*SkipToLineEnd)(const char *Cur, const char *End);
+};
+
+extern ScanFunctions Active;
+
+/// Return true if \p Kind can run on this CPU.
+bool isSupported(ISA Kind);
+
+/// Switch every scanning routine to \p Kind, which must be supported.
+void select(ISA Kind);
+
+ISA getSelected();
+
+std::string_view getName(ISA Kind);
+
+inline const char *skipWhitespace(const char *Cur, const char *End) {
+  return Active.SkipWhitespace(Cur, End);
+}
+
+inline const char *skipIdentifier(const char *Cur, const char *End) {
+  return Active.SkipIdentifier(Cur, End);
+}
+
+inline const char *skipDigits(const char *Cur, const char *End) {
+  return Active.SkipDigits(Cur, End);
+}
+
+inline const char *skipToLineEnd(const char *Cur, const char *End) {
+  return Active.SkipToLineEnd(Cur, End);
+}
+
+} // namespace scanner
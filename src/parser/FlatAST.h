@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "parser/ASTKind.h"
+#include "support/Symbol.h"
+
+//===----------------------------------------------------------------------===//
+// FlatAST - A compact, index-based alternative to the pointer-based AST.
+//===----------------------------------------------------------------------===//
+
+/// FlatAST - A whole unit as one contiguous array of 16-byte nodes. A node
+/// holds its kind, an operator, and three 32-bit operand fields that contain
+/// child indices, Symbol IDs or literal bits. Variable-length lists live in
+/// side arrays, and a node stores their range as (first, count). There is no
+/// per-node allocation and no vtable pointer, and children are stored just
+/// before their parents, so walking a large function touches few cache lines.
+class FlatAST {
+public:
+  /// Meaning of the operand fields A, B and C for each kind of node. Names
+  /// and types are Symbol IDs; "list" is a (first, count) range in B and C.
+  ///
+  ///   Number     B = low 32 bits, C = high 32 bits of the value
+  ///   Variable   A = name
+  ///   Unary      Op = opcode, A = operand
+  ///   Binary     Op = opcode, A = LHS, B = RHS
+  ///   Call       A = callee, B/C = argument list
+  ///   Block      B/C = statement list
+  ///   If         A = condition, B = then block, C = else block or none
+  ///   While      A = condition, B = body
+  ///   Var        A = name, B = type, C = initializer or none
+  ///   Return     A = value or none
+  ///   ExprStmt   A = expression
+  ///   Prototype  A = name, B/C = parameter list
+  ///   Function   A = prototype, B = body
+  ///   Import     A = module name
+  using Kind = ASTKind;
+
+  /// NodeRef - Index of a node, or none. Like a null pointer, none converts
+  /// to false, and nullptr converts to none.
+  class NodeRef {
+  public:
+    NodeRef() = default;
+    NodeRef(std::nullptr_t) {}
+    explicit NodeRef(uint32_t Index) : Index(Index) {}
+
+    explicit operator bool() const { return Index != None; }
+
+    uint32_t getIndex() const { return Index; }
+
+    friend bool operator==(NodeRef LHS, NodeRef RHS) = default;
+
+  private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    uint32_t Index = None;
+  };
+
+  struct Node {
+    Kind K;
+    char Op = 0;
+    uint32_t A = 0;
+    uint32_t B = 0;
+    uint32_t C = 0;
+  };
+  static_assert(sizeof(Node) == 16, "Nodes should stay 16 bytes");
+
+  const Node &operator[](NodeRef Ref) const {
+    assert(Ref && "Dereferencing a null NodeRef");
+    return Nodes[Ref.getIndex()];
+  }
+
+  /// Interpret operand field \p Field as a child.
+  static NodeRef child(uint32_t Field) { return NodeRef(Field); }
+
+  static Symbol symbol(uint32_t Field) { return Symbol::fromID(Field); }
+
+  static int64_t getNumber(const Node &N) {
+    return static_cast<int64_t>(uint64_t(N.C) << 32 | N.B);
+  }
+
+  /// Arguments of a Call, or statements of a Block.
+  std::span<const NodeRef> getList(const Node &N) const {
+    return {Lists.data() + N.B, N.C};
+  }
+
+  /// (name, type) pairs of a Prototype.
+  std::span<const std::pair<Symbol, Symbol>> getParams(const Node &N) const {
+    return {Params.data() + N.B, N.C};
+  }
+
+  /// The return type is stored right before the parameters.
+  Symbol getReturnType(const Node &N) const { return Params[N.B - 1].first; }
+
+  /// Top-level Prototype, Function and Import nodes, in source order.
+  const std::vector<NodeRef> &getDecls() const { return Decls; }
+
+  size_t getNumNodes() const { return Nodes.size(); }
+
+  /// Bytes used by the nodes and the side arrays.
+  size_t getMemoryUsage() const {
+    return Nodes.capacity() * sizeof(Node) +
+           Lists.capacity() * sizeof(NodeRef) +
+           Params.capacity() * sizeof(Params[0]) +
+           Decls.capacity() * sizeof(NodeRef);
+  }
+
+private:
+  friend class FlatASTBuilder;
+  friend class ASTCache;
+
+  std::vector<Node> Nodes;
+  std::vector<NodeRef> Lists;
+  std::vector<std::pair<Symbol, Symbol>> Params;
+  std::vector<NodeRef> Decls;
+};
+
+/// FlatASTBuilder - Lets the Parser build a FlatAST; see ASTBuilder.
+class FlatASTBuilder {
+public:
+  using UnitType = FlatAST;
+  using NodeRef = FlatAST::NodeRef;
+  using ExprRef = NodeRef;
+  using StmtRef = NodeRef;
+  using PrototypeRef = NodeRef;
+  using FunctionRef = NodeRef;
+  using ImportRef = NodeRef;
+
+  FlatASTBuilder() = default;
+  explicit FlatASTBuilder(FlatAST &Tree) : Tree(&Tree) {}
+
+  ExprRef makeNumber(int64_t Val) {
+    auto Bits = static_cast<uint64_t>(Val);
+    return add({FlatAST::Kind::Number, 0, 0, uint32_t(Bits),
+                uint32_t(Bits >> 32)});
+  }
+
+  ExprRef makeVariable(Symbol Name) {
+    return add({FlatAST::Kind::Variable, 0, Name.getID()});
+  }
+
+  ExprRef makeUnary(char Opcode, ExprRef Operand) {
+    return add({FlatAST::Kind::Unary, Opcode, Operand.getIndex()});
+  }
+
+  ExprRef makeBinary(char Op, ExprRef LHS, ExprRef RHS) {
+    return add({FlatAST::Kind::Binary, Op, LHS.getIndex(), RHS.getIndex()});
+  }
+
+  ExprRef makeCall(Symbol Callee, std::span<const ExprRef> Args) {
+    auto [First, Count] = addList(Args);
+    return add({FlatAST::Kind::Call, 0, Callee.getID(), First, Count});
+  }
+
+  StmtRef makeBlock(std::span<const StmtRef> Stmts) {
+    auto [First, Count] = addList(Stmts);
+    return add({FlatAST::Kind::Block, 0, 0, First, Count});
+  }
+
+  StmtRef makeIf(ExprRef Cond, StmtRef Then, StmtRef Else = nullptr) {
+    return add({FlatAST::Kind::If, 0, Cond.getIndex(), Then.getIndex(),
+                Else.getIndex()});
+  }
+
+  StmtRef makeWhile(ExprRef Cond, StmtRef Body) {
+    return add(
+        {FlatAST::Kind::While, 0, Cond.getIndex(), Body.getIndex()});
+  }
+
+  StmtRef makeVar(Symbol Name, Symbol Type, ExprRef Init) {
+    return add({FlatAST::Kind::Var, 0, Name.getID(), Type.getID(),
+                Init.getIndex()});
+  }
+
+  StmtRef makeReturn(ExprRef Val = nullptr) {
+    return add({FlatAST::Kind::Return, 0, Val.getIndex()});
+  }
+
+  StmtRef makeExprStmt(ExprRef E) {
+    return add({FlatAST::Kind::ExprStmt, 0, E.getIndex()});
+  }
+
+  PrototypeRef
+  makePrototype(Symbol ReturnType, Symbol Name,
+                std::span<const std::pair<Symbol, Symbol>> Params) {
+    Tree->Params.emplace_back(ReturnType, Symbol());
+    auto First = static_cast<uint32_t>(Tree->Params.size());
+    Tree->Params.insert(Tree->Params.end(), Params.begin(), Params.end());
+    return add({FlatAST::Kind::Prototype, 0, Name.getID(), First,
+                static_cast<uint32_t>(Params.size())});
+  }
+
+  FunctionRef makeFunction(PrototypeRef Proto, StmtRef Body) {
+    return add(
+        {FlatAST::Kind::Function, 0, Proto.getIndex(), Body.getIndex()});
+  }
+
+  ImportRef makeImport(Symbol ModuleName) {
+    return add({FlatAST::Kind::Import, 0, ModuleName.getID()});
+  }
+
+  void addPrototype(PrototypeRef Proto) { Tree->Decls.push_back(Proto); }
+
+  void addFunction(FunctionRef Func) { Tree->Decls.push_back(Func); }
+
+  void addImport(ImportRef Import) { Tree->Decls.push_back(Import); }
+
+private:
+  NodeRef add(FlatAST::Node N) {
+    Tree->Nodes.push_back(N);
+    return NodeRef(static_cast<uint32_t>(Tree->Nodes.size() - 1));
+  }
+
+  std::pair<uint32_t, uint32_t> addList(std::span<const NodeRef> Items) {
+    auto First = static_cast<uint32_t>(Tree->Lists.size());
+    Tree->Lists.insert(Tree->Lists.end(), Items.begin(), Items.end());
+    return {First, static_cast<uint32_t>(Items.size())};
+  }
+
+  FlatAST *Tree = nullptr;
+};
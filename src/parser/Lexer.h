@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+#include "parser/CharScanner.h"
+#include "parser/SourceBuffer.h"
+#include "support/Symbol.h"
+
+//===----------------------------------------------------------------------===//
+// Lexer
+//===----------------------------------------------------------------------===//
+
+// The lexer returns tokens [0-255] if it is an unknown character, otherwise one
+// of these for known things.
+enum Token {
+  tok_eof = -1,
+
+  // commands
+  tok_func = -2,
+  tok_extern = -3,
+
+  // primary
+  tok_identifier = -4,
+  tok_number = -5,
+
+  // control
+  tok_if = -6,
+  tok_else = -8,
+  tok_for = -9,
+  tok_while = -10,
+  tok_return = -11,
+
+  // var definition
+  tok_var = -13,
+
+  // modules
+  tok_import = -14
+};
+
+/// Lexeme - A single lexed token. Text is a slice of the SourceBuffer, and
+/// Offset is the byte offset of its first character.
+struct Lexeme {
+  int Kind = tok_eof;
+  uint32_t Offset = 0;
+  std::string_view Text;
+  Symbol Sym; // Filled in if tok_identifier
+};
+
+class Lexer {
+public:
+  Lexer(const SourceBuffer &Buffer)
+      : Begin(Buffer.begin()),
+        Cur(Buffer.begin()),
+        End(Buffer.end()) {}
+
+  const Lexeme &getLastTok() const { return LastTok; }
+
+  uint32_t getLastTokOffset() const { return LastTok.Offset; }
+
+  std::string_view getIdentifierStr() const { return LastTok.Text; }
+
+  Symbol getSymbol() const { return LastTok.Sym; }
+
+  int64_t getNumVal() const { return NumVal; }
+
+  /// gettok - Return the next token from the source buffer.
+  int gettok() {
+    LastTok.Kind = lex();
+    LastTok.Text = {TokStart, static_cast<size_t>(Cur - TokStart)};
+    LastTok.Offset = TokStart - Begin;
+    return LastTok.Kind;
+  }
+
+private:
+  static constexpr int KeywordTokens[] = {
+#define TOY_KEYWORD(Spelling, Token) Token,
+#include "support/Keywords.def"
+  };
+
+  int lex() {
+    while (true) {
+      // Skip any whitespace.
+      Cur = scanner::skipWhitespace(Cur, End);
+
+      // Comment until end of line.
+      if (Cur == End || *Cur != '#')
+        break;
+      Cur = scanner::skipToLineEnd(Cur, End);
+    }
+
+    TokStart = Cur;
+
+    // Check for end of file.
+    if (Cur == End)
+      return tok_eof;
+
+    if (isalpha(static_cast<unsigned char>(*Cur))) {
+      // identifier: [a-zA-Z][a-zA-Z0-9_]*
+      Cur = scanner::skipIdentifier(Cur + 1, End);
+
+      // Keywords are interned first, so the Symbol alone tells them apart.
+      LastTok.Sym = Symbol::intern(
+          {TokStart, static_cast<size_t>(Cur - TokStart)});
+      if (LastTok.Sym.isKeyword())
+        return KeywordTokens[LastTok.Sym.getKeywordIndex()];
+      return tok_identifier;
+    }
+
+    if (isdigit(static_cast<unsigned char>(*Cur))) { // Number: [0-9]+
+      Cur = scanner::skipDigits(Cur + 1, End);
+
+      // Like strtol with base 0, a leading zero selects octal.
+      int Base = (*TokStart == '0') ? 8 : 10;
+      NumVal = 0;
+      std::from_chars(TokStart, Cur, NumVal, Base);
+      return tok_number;
+    }
+
+    // Otherwise, just return the character as its ascii value.
+    return static_cast<unsigned char>(*Cur++);
+  }
+
+  const char *Begin;
+  const char *Cur;
+  const char *End;
+  const char *TokStart = nullptr;
+
+  Lexeme LastTok;
+  int64_t NumVal = 0; // Filled in if tok_number
+};
@@ -0,0 +1,90 @@
+#include "parser/ParallelParser.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "parser/Parser.h"
+#include "support/ThreadPool.h"
+
+namespace {
+
+/// Split into a few chunks per thread, so that one long function does not
+/// leave the other threads idle.
+constexpr size_t ChunksPerThread = 4;
+
+/// Token indices of every 'func', 'extern' and 'import' that is not nested in
+/// braces.
+std::vector<size_t> findTopLevelDecls(const TokenBuffer &Tokens) {
+  std::vector<size_t> Starts;
+  int Depth = 0;
+  for (size_t I = 0;; ++I) {
+    switch (Tokens.getKind(I)) {
+    case tok_eof: return Starts;
+    case '{': ++Depth; break;
+    case '}': Depth = std::max(Depth - 1, 0); break;
+    case tok_func:
+    case tok_extern:
+    case tok_import:
+      if (Depth == 0)
+        Starts.push_back(I);
+      break;
+    default: break;
+    }
+  }
+}
+
+struct Chunk {
+  size_t Begin = 0;
+  size_t End = 0;
+  CompilationUnit Unit;
+  std::vector<std::string> Diagnostics;
+};
+
+} // namespace
+
+void parseInParallel(const SourceBuffer &Buffer, const TokenBuffer &Tokens,
+                     CompilationUnit &Unit, unsigned NumThreads) {
+  auto Starts = findTopLevelDecls(Tokens);
+  size_t NumChunks = std::min(Starts.size(), NumThreads * ChunksPerThread);
+  if (NumThreads <= 1 || NumChunks <= 1) {
+    Parser P(Buffer, Tokens);
+    P.Parse(Unit);
+    return;
+  }
+
+  std::vector<Chunk> Chunks(NumChunks);
+  for (size_t I = 0; I < NumChunks; ++I) {
+    // The first chunk also owns whatever precedes the first declaration, and
+    // the last one runs up to tok_eof.
+    Chunks[I].Begin = I == 0 ? 0 : Starts[I * Starts.size() / NumChunks];
+    Chunks[I].End = I + 1 == NumChunks
+                        ? SIZE_MAX
+                        : Starts[(I + 1) * Starts.size() / NumChunks];
+  }
+
+  {
+    ThreadPool Pool(NumThreads);
+    for (auto &C : Chunks) {
+      Pool.async([&Buffer, &Tokens, &C] {
+        Parser P(Buffer, Tokens, C.Begin, C.End);
+        P.setDiagnosticSink(&C.Diagnostics);
+        P.Parse(C.Unit);
+      });
+    }
+    Pool.wait();
+  }
+
+  // Error recovery may skip across a declaration boundary, which a chunk
+  // cannot see past. Rather than risk different diagnostics or a different
+  // AST, redo an erroneous input serially.
+  if (std::any_of(Chunks.begin(), Chunks.end(),
+                  [](const Chunk &C) { return !C.Diagnostics.empty(); })) {
+    Parser P(Buffer, Tokens);
+    P.Parse(Unit);
+    return;
+  }
+
+  for (auto &C : Chunks)
+    Unit.append(std::move(C.Unit));
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "parser/AST.h"
+#include "parser/SourceBuffer.h"
+#include "parser/TokenBuffer.h"
+
+/// Parse \p Tokens into \p Unit on \p NumThreads threads.
+///
+/// A quick pre-scan balances braces to find every top-level 'func' and
+/// 'extern', the token stream is cut into chunks at those boundaries, and
+/// each chunk is parsed on its own. The pieces are appended to \p Unit in
+/// source order, so the result is the same as that of a serial Parser::Parse.
+void parseInParallel(const SourceBuffer &Buffer, const TokenBuffer &Tokens,
+                     CompilationUnit &Unit, unsigned NumThreads);
@@ -1,188 +1,120 @@
 #pragma once
 
-#include <cstdio>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "parser/AST.h"
 #include "parser/Error.h"
+#include "parser/FlatAST.h"
+#include "parser/Lexer.h"
+#include "parser/SourceBuffer.h"
+#include "parser/TokenBuffer.h"
+#include "support/Symbol.h"
 
 //===----------------------------------------------------------------------===//
-// Lexer
+// Parser
 //===----------------------------------------------------------------------===//
 
-// The lexer returns tokens [0-255] if it is an unknown character, otherwise one
-// of these for known things.
-enum Token {
-  tok_eof = -1,
-
-  // commands
-  tok_func = -2,
-  tok_extern = -3,
-
-  // primary
-  tok_identifier = -4,
-  tok_number = -5,
-
-  // control
-  tok_if = -6,
-  tok_else = -8,
-  tok_for = -9,
-  tok_while = -10,
-  tok_return = -11,
-
-  // var definition
-  tok_var = -13
-};
-
-class Lexer {
+/// ParserBase - Everything the grammar needs that does not depend on the kind
+/// of tree being built: walking the token stream, operator precedence and
+/// diagnostics.
+class ParserBase {
 public:
-  Lexer(FILE *Stream) : Stream(Stream) {}
-
-  std::pair<int, int> getLastTokPos() const { return LastTokPos; }
-
-  std::string getIdentifierStr() const { return IdentifierStr; }
-
-  int64_t getNumVal() const { return NumVal; }
-
-  /// gettok - Return the next token from standard input.
-  int gettok() {
-    // Skip any whitespace.
-    while (isspace(LastChar))
-      LastChar = getchar();
-
-    LastTokPos = getpos();
-    if (isalpha(LastChar)) { // identifier: [a-zA-Z][a-zA-Z0-9]*
-      IdentifierStr = (char)LastChar;
-
-      while (isalnum((LastChar = getchar())) || LastChar == '_')
-        IdentifierStr += (char)LastChar;
-
-      if (IdentifierStr == "func")
-        return tok_func;
-      if (IdentifierStr == "extern")
-        return tok_extern;
-      if (IdentifierStr == "if")
-        return tok_if;
-      if (IdentifierStr == "else")
-        return tok_else;
-      if (IdentifierStr == "for")
-        return tok_for;
-      if (IdentifierStr == "while")
-        return tok_while;
-      if (IdentifierStr == "return")
-        return tok_return;
-      if (IdentifierStr == "var")
-        return tok_var;
-      return tok_identifier;
-    }
+  /// Parse the tokens in [Begin, End) of \p Tokens. The range must start at a
+  /// top-level declaration; tokens from End onwards read as tok_eof.
+  ParserBase(const SourceBuffer &Buffer, const TokenBuffer &Tokens,
+             size_t Begin = 0, size_t End = SIZE_MAX)
+      : Buffer(Buffer),
+        Tokens(Tokens),
+        NextPos(Begin),
+        EndPos(End) {
+    // Install standard binary operators.
+    // 1 is lowest precedence.
+    BinopPrecedence['='] = 2;
+    BinopPrecedence['<'] = 10;
+    BinopPrecedence['>'] = 10;
+    BinopPrecedence['+'] = 20;
+    BinopPrecedence['-'] = 20;
+    BinopPrecedence['*'] = 40; // highest.
+  }
 
-    if (isdigit(LastChar)) { // Number: [0-9]+
-      std::string NumStr;
-      do {
-        NumStr += (char)LastChar;
-        LastChar = getchar();
-      } while (isdigit(LastChar));
+  /// Index of the token the parser is looking at. Every token before it has
+  /// been consumed for good.
+  size_t getCurPos() const { return CurPos; }
 
-      NumVal = strtol(NumStr.c_str(), nullptr, 0);
-      return tok_number;
-    }
+  /// Number of diagnostics reported so far.
+  size_t getNumErrors() const { return NumErrors; }
 
-    if (LastChar == '#') {
-      // Comment until end of line.
-      do
-        LastChar = getchar();
-      while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+  /// Collect diagnostics into \p Sink instead of printing them.
+  void setDiagnosticSink(std::vector<std::string> *Sink) { DiagSink = Sink; }
 
-      if (LastChar != EOF)
-        return gettok();
-    }
+  struct Expected {
+    std::vector<std::string> Strs;
 
-    // Check for end of file.  Don't eat the EOF.
-    if (LastChar == EOF)
-      return tok_eof;
+    Expected(std::initializer_list<int> Tokens) {
+      for (auto Tok : Tokens) {
+        Strs.push_back(formatToken(Tok));
+      }
+    }
 
-    // Otherwise, just return the character as its ascii value.
-    int ThisChar = LastChar;
-    LastChar = getchar();
-    return ThisChar;
-  }
+    Expected(std::vector<std::string> Strs) : Strs(std::move(Strs)) {}
+  };
 
-private:
-  int getchar() {
-    auto Char = ::fgetc(Stream);
+  struct In {
+    std::string_view Rule;
 
-    if (Char == '\n') {
-      row += 1;
-      col = 0;
-    } else
-      col += 1;
+    In(std::string_view Rule) : Rule(Rule) {}
+  };
 
-    return Char;
-  }
+  struct After {
+    std::string_view Symbol;
 
-  std::pair<int, int> getpos() const { return {row, col}; }
+    After(std::string_view Symbol) : Symbol(Symbol) {}
+  };
 
-  FILE *Stream;
+protected:
+  const SourceBuffer &Buffer;
 
-  int row = 1;
-  int col = 0;
+  const TokenBuffer &Tokens;
 
-  int LastChar = ' ';
+  /// CurTok/getNextToken - Walk the pre-lexed token stream.  CurTok is the
+  /// kind of the token at CurPos, the one the parser is looking at.
+  /// getNextToken advances to the next token and updates CurTok.
+  static constexpr size_t NoPos = SIZE_MAX;
 
-  std::pair<int, int> LastTokPos;
-  std::string IdentifierStr; // Filled in if tok_identifier
-  int64_t NumVal;            // Filled in if tok_number
-};
+  int CurTok = tok_eof;
+  size_t CurPos = NoPos;
+  size_t NextPos;
+  size_t EndPos;
 
-//===----------------------------------------------------------------------===//
-// Parser
-//===----------------------------------------------------------------------===//
+  int getNextToken() {
+    CurPos = NextPos++;
+    CurTok = CurPos < EndPos ? Tokens.getKind(CurPos) : tok_eof;
 
-class Parser {
-public:
-  Parser(FILE *Stream, std::string Path) : L(Stream), Path(std::move(Path)) {
-    // Install standard binary operators.
-    // 1 is lowest precedence.
-    BinopPrecedence['='] = 2;
-    BinopPrecedence['<'] = 10;
-    BinopPrecedence['+'] = 20;
-    BinopPrecedence['-'] = 20;
-    BinopPrecedence['*'] = 40; // highest.
+    return CurTok;
   }
 
-  /// top ::= definition | external | ';'
-  void Parse(CompilationUnit &Unit) {
+  /// Make the token at \p Pos the current one again.
+  void rewind(size_t Pos) {
+    NextPos = Pos;
     getNextToken();
-    while (true) {
-      switch (CurTok) {
-      case tok_eof: return;
-      case ';': // ignore top-level semicolons.
-        getNextToken();
-        break;
-      case tok_func: HandleDefinition(Unit); break;
-      case tok_extern: HandleExtern(Unit); break;
-      default: assert(false && "unexpected token"); break;
-      }
-    }
   }
 
-private:
-  Lexer L;
-
-  std::string Path;
-
-  /// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the
-  /// current token the parser is looking at.  getNextToken reads another token
-  /// from the lexer and updates CurTok with its results.
-  int CurTok;
+  /// peekToken - Look \p N tokens past CurTok without consuming anything.
+  int peekToken(size_t N = 1) const {
+    return CurPos + N < EndPos ? Tokens.getKind(CurPos + N) : tok_eof;
+  }
 
-  int getNextToken() {
-    CurTok = L.gettok();
+  std::vector<std::string> *DiagSink = nullptr;
+  size_t NumErrors = 0;
 
-    return CurTok;
-  }
+  Symbol getSymbol() const { return Tokens.getSymbol(CurPos); }
 
   /// BinopPrecedence - This holds the precedence for each binary operator that
   /// is defined.
@@ -215,53 +147,127 @@ private:
     case tok_for: return "<tok_for>";
     case tok_while: return "<tok_while>";
     case tok_var: return "<tok_var>";
+    case tok_import: return "<tok_import>";
     default: return "<unknown>";
     }
   }
 
-public:
-  struct Expected {
-    std::vector<std::string> Strs;
-
-    Expected(const std::vector<int> &Tokens) {
-      for (auto Tok : Tokens) {
-        Strs.push_back(formatToken(Tok));
-      }
-    }
+  std::nullptr_t logError(std::string_view Str);
 
-    Expected(std::vector<std::string> Strs) : Strs(std::move(Strs)) {}
-  };
+  std::nullptr_t logError(const Expected &E, const In &I);
 
-  struct In {
-    std::string_view Rule;
+  std::nullptr_t logError(const Expected &E, const After &Af);
+};
 
-    In(std::string_view Rule) : Rule(Rule) {}
-  };
+/// BasicParser - The recursive-descent grammar. \p BuilderT decides what the
+/// parsed declarations turn into: ASTBuilder makes a CompilationUnit of AST
+/// nodes, FlatASTBuilder makes a FlatAST.
+template <typename BuilderT>
+class BasicParser : public ParserBase {
+public:
+  using UnitType = typename BuilderT::UnitType;
+  using ExprRef = typename BuilderT::ExprRef;
+  using StmtRef = typename BuilderT::StmtRef;
+  using PrototypeRef = typename BuilderT::PrototypeRef;
+  using FunctionRef = typename BuilderT::FunctionRef;
+  using ImportRef = typename BuilderT::ImportRef;
+
+  using ParserBase::ParserBase;
+
+  /// top ::= definition | external | import | ';'
+  void Parse(UnitType &Unit) {
+    while (ParseTopLevel(Unit)) {
+    }
+  }
 
-  struct After {
-    std::string_view Symbol;
+  /// With lazy bodies, a function definition only records the tokens of its
+  /// body, which ParseLazyBody() turns into statements later. Only builders
+  /// that provide makeLazyFunction support this; others parse eagerly.
+  void setLazyBodies(bool Lazy) { LazyBodies = Lazy; }
+
+  /// Parse the body recorded for a lazily parsed function, which spans the
+  /// tokens [Begin, End), into \p Unit.
+  StmtRef ParseLazyBody(UnitType &Unit, size_t Begin, size_t End) {
+    Build = BuilderT(Unit);
+    EndPos = End;
+    rewind(Begin);
+    return ParseBlockStmt();
+  }
 
-    After(std::string_view Symbol) : Symbol(Symbol) {}
-  };
+  /// Parse the next top-level declaration into \p Unit, skipping stray
+  /// semicolons. Returns false once there is nothing left to parse.
+  bool ParseTopLevel(UnitType &Unit) {
+    Build = BuilderT(Unit);
+    if (CurPos == NoPos)
+      getNextToken();
+    while (true) {
+      switch (CurTok) {
+      case tok_eof: return false;
+      case ';': // ignore top-level semicolons.
+        getNextToken();
+        break;
+      case tok_func: HandleDefinition(); return true;
+      case tok_extern: HandleExtern(); return true;
+      case tok_import: HandleImport(); return true;
+      default:
+        // A chunk of a parallel parse just gives up; the serial re-parse that
+        // follows reproduces the exact behavior.
+        if (DiagSink != nullptr) {
+          logError("unexpected token");
+          return false;
+        }
+        assert(false && "unexpected token");
+        break;
+      }
+    }
+  }
 
 private:
-  std::nullptr_t logError(std::string_view Str);
-
-  std::nullptr_t logError(const Expected &E, const In &I);
-
-  std::nullptr_t logError(const Expected &E, const After &Af);
+  BuilderT Build;
+
+  bool LazyBodies = false;
+
+  /// Child lists are collected on these stacks while they are parsed, then
+  /// handed to the builder in one piece, so no temporary vector is allocated
+  /// per node. Nested lists simply push on top of their parent's entries.
+  std::vector<ExprRef> ExprStack;
+  std::vector<StmtRef> StmtStack;
+  std::vector<std::pair<Symbol, Symbol>> ParamStack;
+
+  /// An operator, '(' or call that ParseExpression has read but not yet
+  /// applied, because some of its operands are still to come.
+  struct PendingOp {
+    enum KindTy : uint8_t { Unary, Binary, Paren, Call };
+
+    PendingOp() = default;
+    PendingOp(KindTy Kind, char Op = 0, Symbol Callee = {}, size_t Mark = 0)
+        : Kind(Kind),
+          Op(Op),
+          Callee(Callee),
+          Mark(Mark) {}
+
+    KindTy Kind = Unary;
+    char Op = 0;
+    Symbol Callee;
+    /// Where the arguments of a call start on ExprStack.
+    size_t Mark = 0;
+  };
+  std::vector<PendingOp> OpStack;
 
-  std::vector<std::unique_ptr<StmtAST>> ParseStmts() {
-    std::vector<std::unique_ptr<StmtAST>> Stmts;
+  /// The entries pushed onto \p Stack since \p Mark.
+  template <typename T>
+  static std::span<const T> since(const std::vector<T> &Stack, size_t Mark) {
+    return std::span<const T>(Stack).subspan(Mark);
+  }
 
+  /// Push the statements of a block onto StmtStack.
+  void ParseStmts() {
     while (CurTok != '}') {
       auto S = ParseStmt();
       if (!S)
         continue;
-      Stmts.emplace_back(std::move(S));
+      StmtStack.push_back(S);
     }
-
-    return Stmts;
   }
 
   /// stmt
@@ -271,7 +277,7 @@ private:
   ///   ::= varstmt
   ///   ::= expr ';'
   ///   ::= ';'
-  std::unique_ptr<StmtAST> ParseStmt() {
+  StmtRef ParseStmt() {
     if (CurTok == '{')
       return ParseBlockStmt();
 
@@ -299,83 +305,30 @@ private:
       return logError(Expected({';'}), After("expression"));
     getNextToken();
 
-    return std::make_unique<ExprStmtAST>(std::move(E));
-  }
-
-  /// numberexpr ::= number
-  std::unique_ptr<ExprAST> ParseNumberExpr() {
-    auto Result = std::make_unique<NumberExprAST>(L.getNumVal());
-    getNextToken(); // consume the number
-    return std::move(Result);
-  }
-
-  /// parenexpr ::= '(' expression ')'
-  std::unique_ptr<ExprAST> ParseParenExpr() {
-    getNextToken(); // eat (.
-    auto V = ParseExpression();
-    if (!V)
-      return nullptr;
-
-    if (CurTok != ')') {
-      return logError(Expected({')'}), In("parenexpr"));
-    }
-    getNextToken(); // eat ).
-    return V;
-  }
-
-  /// identifierexpr
-  ///   ::= identifier
-  ///   ::= identifier '(' expression* ')'
-  std::unique_ptr<ExprAST> ParseIdentifierExpr() {
-    std::string IdName = L.getIdentifierStr();
-
-    getNextToken(); // eat identifier.
-
-    if (CurTok != '(') // Simple variable ref.
-      return std::make_unique<VariableExprAST>(IdName);
-
-    // Call.
-    getNextToken(); // eat (
-    std::vector<std::unique_ptr<ExprAST>> Args;
-    if (CurTok != ')') {
-      while (true) {
-        if (auto Arg = ParseExpression())
-          Args.push_back(std::move(Arg));
-        else
-          return nullptr;
-
-        if (CurTok == ')')
-          break;
-
-        if (CurTok != ',') {
-          return logError(Expected({')', ','}), In("argument list"));
-        }
-        getNextToken();
-      }
-    }
-
-    // Eat the ')'.
-    getNextToken();
-
-    return std::make_unique<CallExprAST>(IdName, std::move(Args));
+    return Build.makeExprStmt(E);
   }
 
   /// block ::= '{' stmts '}'
-  std::unique_ptr<StmtAST> ParseBlockStmt() {
+  StmtRef ParseBlockStmt() {
     getNextToken(); // eat '{'.
-    auto Block = ParseStmts();
+    size_t Mark = StmtStack.size();
+    ParseStmts();
 
-    if (CurTok != '}')
+    if (CurTok != '}') {
+      StmtStack.resize(Mark);
       return logError(Expected({'}'}), In("block"));
+    }
 
     getNextToken(); // eat '}'.
-    return std::make_unique<BlockStmtAST>(std::move(Block));
+    auto Block = Build.makeBlock(since(StmtStack, Mark));
+    StmtStack.resize(Mark);
+    return Block;
   }
 
   /// ifexpr
   ///   ::= 'if' expr block
   ///   ::= 'if' expr block else block
-  std::unique_ptr<StmtAST> ParseIfStmt() {
+  StmtRef ParseIfStmt() {
     getNextToken(); // eat the if.
 
     // condition.
@@ -391,7 +344,7 @@ private:
       return nullptr;
 
     if (CurTok != tok_else)
-      return std::make_unique<IfStmtAST>(std::move(Cond), std::move(Then));
+      return Build.makeIf(Cond, Then);
 
     getNextToken(); // eat 'else'.
     if (CurTok != '{') {
@@ -402,12 +355,11 @@ private:
     if (!Else)
       return nullptr;
 
-    return std::make_unique<IfStmtAST>(std::move(Cond), std::move(Then),
-                                       std::move(Else));
+    return Build.makeIf(Cond, Then, Else);
   }
 
   /// whilestmt ::= 'while' expr block
-  std::unique_ptr<StmtAST> ParseWhileStmt() {
+  StmtRef ParseWhileStmt() {
     getNextToken(); // eat 'while'.
 
     auto Cond = ParseExpression();
@@ -422,18 +374,18 @@ private:
     if (!Body)
       return nullptr;
 
-    return std::make_unique<WhileStmtAST>(std::move(Cond), std::move(Body));
+    return Build.makeWhile(Cond, Body);
   }
 
   /// varstmt ::= 'var' identifier ':' identifier ('=' expr)? ';'
-  std::unique_ptr<StmtAST> ParseVarStmt() {
+  StmtRef ParseVarStmt() {
     getNextToken(); // eat the var.
 
     // At least one variable name is required.
     if (CurTok != tok_identifier)
       return logError(Expected({tok_identifier}), After("var"));
 
-    std::string Name = L.getIdentifierStr();
+    Symbol Name = getSymbol();
     getNextToken(); // eat identifier.
 
     if (CurTok != ':')
@@ -443,11 +395,11 @@ private:
     if (CurTok != tok_identifier)
       return logError(Expected({tok_identifier}), After(":"));
 
-    std::string Type = L.getIdentifierStr();
+    Symbol Type = getSymbol();
     getNextToken(); // eat identifier.
 
     // Read the optional initializer.
-    std::unique_ptr<ExprAST> Init = nullptr;
+    ExprRef Init = nullptr;
     if (CurTok == '=') {
       getNextToken(); // eat the '='.
 
@@ -459,16 +411,15 @@ private:
     if (CurTok != ';')
       return logError(Expected({';'}), In("var statement"));
 
-    return std::make_unique<VarStmtAST>(std::move(Name), std::move(Type),
-                                        std::move(Init));
+    return Build.makeVar(Name, Type, Init);
   }
 
   /// returnstmt ::= 'return' expr? ';'
-  std::unique_ptr<StmtAST> ParseReturnStmt() {
+  StmtRef ParseReturnStmt() {
     getNextToken(); // eat 'return'.
 
     if (CurTok == ';')
-      return std::make_unique<ReturnStmtAST>();
+      return Build.makeReturn();
 
     auto E = ParseExpression();
     if (!E)
@@ -478,98 +429,147 @@ private:
       return logError(Expected({';'}), After("Expression"));
     getNextToken();
 
-    return std::make_unique<ReturnStmtAST>(std::move(E));
+    return Build.makeReturn(E);
   }
 
-  /// primary
-  ///   ::= identifierexpr
-  ///   ::= numberexpr
-  ///   ::= parenexpr
-  ///   ::= ifexpr
-  ///   ::= forexpr
-  ///   ::= varexpr
-  std::unique_ptr<ExprAST> ParsePrimary() {
-    switch (CurTok) {
-    default:
-      return logError(Expected({tok_identifier, tok_number, '('}),
-                      In("primary"));
-    case tok_identifier: return ParseIdentifierExpr();
-    case tok_number: return ParseNumberExpr();
-    case '(': return ParseParenExpr();
-    }
-  }
+  /// expression ::= unary binoprhs
+  /// binoprhs   ::= (binop unary)*
+  /// unary      ::= primary | unop unary
+  /// primary    ::= identifier
+  ///            ::= identifier '(' (expression (',' expression)*)? ')'
+  ///            ::= number
+  ///            ::= '(' expression ')'
+  ///
+  /// Parsed with explicit operator and operand stacks instead of recursion
+  /// (shunting-yard), so neither long operator chains nor deep nesting can
+  /// overflow the call stack. All binary operators are left-associative, and
+  /// unary operators bind tighter than any of them.
+  ExprRef ParseExpression() {
+    size_t OpBase = OpStack.size();
+    size_t ValBase = ExprStack.size();
+    auto Fail = [&](std::nullptr_t) -> ExprRef {
+      OpStack.resize(OpBase);
+      ExprStack.resize(ValBase);
+      return nullptr;
+    };
+
+    while (true) {
+      // Expecting an operand. Any other ASCII character is a unary operator.
+      while (isascii(CurTok) && CurTok != '(' && CurTok != ',') {
+        OpStack.emplace_back(PendingOp::Unary, static_cast<char>(CurTok));
+        getNextToken();
+      }
 
-  /// unary
-  ///   ::= primary
-  ///   ::= '!' unary
-  std::unique_ptr<ExprAST> ParseUnary() {
-    // If the current token is not an operator, it must be a primary expr.
-    if (!isascii(CurTok) || CurTok == '(' || CurTok == ',')
-      return ParsePrimary();
+      switch (CurTok) {
+      case '(':
+        OpStack.emplace_back(PendingOp::Paren);
+        getNextToken(); // eat (.
+        continue;
+      case tok_number:
+        ExprStack.push_back(Build.makeNumber(Tokens.getNumVal(CurPos)));
+        getNextToken(); // consume the number
+        break;
+      case tok_identifier: {
+        Symbol IdName = getSymbol();
+        getNextToken(); // eat identifier.
 
-    // If this is a unary operator, read it.
-    int Opc = CurTok;
-    getNextToken();
-    if (auto Operand = ParseUnary())
-      return std::make_unique<UnaryExprAST>(Opc, std::move(Operand));
-    return nullptr;
-  }
+        if (CurTok != '(') { // Simple variable ref.
+          ExprStack.push_back(Build.makeVariable(IdName));
+          break;
+        }
 
-  /// binoprhs
-  ///   ::= ('+' unary)*
-  std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec,
-                                         std::unique_ptr<ExprAST> LHS) {
-    // If this is a binop, find its precedence.
-    while (true) {
-      int TokPrec = GetTokPrecedence();
+        getNextToken(); // eat (
+        if (CurTok != ')') {
+          // Parse the arguments as operands, then make the call once the
+          // closing ')' shows up.
+          OpStack.emplace_back(PendingOp::Call, 0, IdName, ExprStack.size());
+          continue;
+        }
+        getNextToken(); // eat ).
+        ExprStack.push_back(Build.makeCall(IdName, {}));
+        break;
+      }
+      default:
+        return Fail(logError(Expected({tok_identifier, tok_number, '('}),
+                             In("primary")));
+      }
 
-      // If this is a binop that binds at least as tightly as the current binop,
-      // consume it, otherwise we are done.
-      if (TokPrec < ExprPrec)
-        return LHS;
+      // An operand is complete. Apply the pending unary operators, then look
+      // at what follows it.
+      while (true) {
+        while (OpStack.size() > OpBase &&
+               OpStack.back().Kind == PendingOp::Unary) {
+          ExprStack.back() =
+              Build.makeUnary(OpStack.back().Op, ExprStack.back());
+          OpStack.pop_back();
+        }
 
-      // Okay, we know this is a binop.
-      int BinOp = CurTok;
-      getNextToken(); // eat binop
+        // A binary operator first reduces everything on its left that binds
+        // at least as tightly.
+        if (int Prec = GetTokPrecedence(); Prec > 0) {
+          ReduceBinaryOps(OpBase, Prec);
+          OpStack.emplace_back(PendingOp::Binary, static_cast<char>(CurTok));
+          getNextToken(); // eat binop
+          break;
+        }
 
-      // Parse the unary expression after the binary operator.
-      auto RHS = ParseUnary();
-      if (!RHS)
-        return nullptr;
+        // Otherwise the innermost (sub)expression ends here.
+        ReduceBinaryOps(OpBase, 0);
+        if (OpStack.size() == OpBase) {
+          auto Result = ExprStack.back();
+          ExprStack.pop_back();
+          return Result;
+        }
 
-      // If BinOp binds less tightly with RHS than the operator after RHS, let
-      // the pending operator take RHS as its LHS.
-      int NextPrec = GetTokPrecedence();
-      if (TokPrec < NextPrec) {
-        RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
-        if (!RHS)
-          return nullptr;
-      }
+        auto &Open = OpStack.back();
+        if (Open.Kind == PendingOp::Paren) {
+          if (CurTok != ')')
+            return Fail(logError(Expected({')'}), In("parenexpr")));
+          getNextToken(); // eat ).
+          OpStack.pop_back();
+          continue;
+        }
 
-      // Merge LHS/RHS.
-      LHS = std::make_unique<BinaryExprAST>(BinOp, std::move(LHS),
-                                            std::move(RHS));
+        // The operand is an argument of the innermost call.
+        if (CurTok == ')') {
+          getNextToken(); // eat ).
+          auto Call = Build.makeCall(Open.Callee, since(ExprStack, Open.Mark));
+          ExprStack.resize(Open.Mark);
+          ExprStack.push_back(Call);
+          OpStack.pop_back();
+          continue;
+        }
+        if (CurTok != ',')
+          return Fail(logError(Expected({')', ','}), In("argument list")));
+        getNextToken(); // eat ,
+        break;
+      }
     }
   }
 
-  /// expression
-  ///   ::= unary binoprhs
-  std::unique_ptr<ExprAST> ParseExpression() {
-    auto LHS = ParseUnary();
-    if (!LHS)
-      return nullptr;
-
-    return ParseBinOpRHS(0, std::move(LHS));
+  /// Combine the binary operators on top of OpStack that bind at least as
+  /// tightly as \p Prec with their operands.
+  void ReduceBinaryOps(size_t OpBase, int Prec) {
+    while (OpStack.size() > OpBase) {
+      auto &Top = OpStack.back();
+      if (Top.Kind != PendingOp::Binary || BinopPrecedence[Top.Op] < Prec)
+        return;
+
+      auto RHS = ExprStack.back();
+      ExprStack.pop_back();
+      ExprStack.back() = Build.makeBinary(Top.Op, ExprStack.back(), RHS);
+      OpStack.pop_back();
+    }
   }
 
   /// prototype ::= identifier '(' (param (',' param)*)? ')' ( ':' identifier)?
-  std::unique_ptr<PrototypeAST> ParsePrototype() {
-    std::string FnName;
+  PrototypeRef ParsePrototype() {
+    Symbol FnName;
 
     if (CurTok != tok_identifier)
       return logError(Expected({tok_identifier}), In("prototype"));
 
-    FnName = L.getIdentifierStr();
+    FnName = getSymbol();
     getNextToken(); // eat identifier
 
     if (CurTok != '(') {
@@ -580,15 +580,15 @@ private:
     if (CurTok != tok_identifier && CurTok != ')')
       return logError(Expected({')', tok_identifier}), In("parameter list"));
 
-    std::vector<std::pair<std::string, std::string>> Params;
+    ParamStack.clear();
     while (CurTok == tok_identifier) {
-      auto Name = L.getIdentifierStr();
+      Symbol Name = getSymbol();
       if (getNextToken() != ':')
         return logError(Expected({':'}), After("parameter name"));
       if (getNextToken() != tok_identifier)
         return logError(Expected({tok_identifier}), After("':'"));
-      auto Type = L.getIdentifierStr();
-      Params.emplace_back(std::move(Name), std::move(Type));
+      Symbol Type = getSymbol();
+      ParamStack.emplace_back(Name, Type);
       auto Next = getNextToken();
       if (Next == ')')
         break;
@@ -602,46 +602,86 @@ private:
     getNextToken(); // eat ')'.
 
     if (CurTok != ':')
-      return std::make_unique<PrototypeAST>(FnName, Params);
+      return Build.makePrototype(Symbol::intern("void"), FnName, ParamStack);
 
     getNextToken(); // eat ':'.
     if (CurTok != tok_identifier)
       return logError(Expected({tok_identifier}), After("':'"));
 
-    auto ReturnType = L.getIdentifierStr();
+    Symbol ReturnType = getSymbol();
     getNextToken(); // eat identifier.
-    return std::make_unique<PrototypeAST>(ReturnType, FnName, Params);
+    return Build.makePrototype(ReturnType, FnName, ParamStack);
   }
 
   /// definition ::= 'func' prototype expression
-  std::unique_ptr<FunctionAST> ParseDefinition() {
+  FunctionRef ParseDefinition() {
     getNextToken(); // eat 'func'.
     auto Proto = ParsePrototype();
     if (!Proto)
       return nullptr;
 
+    if constexpr (requires { Build.makeLazyFunction(Proto, 0, 0); }) {
+      if (LazyBodies && CurTok == '{') {
+        size_t Begin = CurPos;
+        if (SkipBlock())
+          return Build.makeLazyFunction(Proto, Begin, CurPos);
+        // The braces do not balance. Parse the body now to diagnose it.
+        rewind(Begin);
+      }
+    }
+
     if (auto E = ParseBlockStmt())
-      return std::make_unique<FunctionAST>(std::move(Proto), std::move(E));
+      return Build.makeFunction(Proto, E);
     return nullptr;
   }
 
+  /// Step over a block by matching braces, without parsing it. Returns false
+  /// if the input ends first.
+  bool SkipBlock() {
+    size_t Depth = 0;
+    while (CurTok != tok_eof) {
+      if (CurTok == '{') {
+        ++Depth;
+      } else if (CurTok == '}' && --Depth == 0) {
+        getNextToken(); // eat '}'.
+        return true;
+      }
+      getNextToken();
+    }
+    return false;
+  }
+
   /// external ::= 'extern' prototype
-  std::unique_ptr<PrototypeAST> ParseExtern() {
+  PrototypeRef ParseExtern() {
     getNextToken(); // eat extern.
     return ParsePrototype();
   }
 
-  void HandleDefinition(CompilationUnit &U) {
+  /// import ::= 'import' identifier ';'
+  ImportRef ParseImport() {
+    getNextToken(); // eat import.
+    if (CurTok != tok_identifier)
+      return logError(Expected({tok_identifier}), After("import"));
+
+    Symbol ModuleName = getSymbol();
+    if (getNextToken() != ';')
+      return logError(Expected({';'}), After("module name"));
+
+    getNextToken(); // eat ';'.
+    return Build.makeImport(ModuleName);
+  }
+
+  void HandleDefinition() {
     if (auto FnAST = ParseDefinition())
-      U.addFunction(std::move(FnAST));
+      Build.addFunction(FnAST);
     else
       // Skip token for error recovery.
       getNextToken();
   }
 
-  void HandleExtern(CompilationUnit &U) {
+  void HandleExtern() {
     if (auto ProtoAST = ParseExtern()) {
-      U.addPrototype(std::move(ProtoAST));
+      Build.addPrototype(ProtoAST);
       // if (auto *FnIR = ProtoAST->codegen()) {
       //   fprintf(stderr, "Read extern: ");
       //   FnIR->print(errs());
@@ -653,12 +693,20 @@ private:
       getNextToken();
     }
   }
+
+  void HandleImport() {
+    if (auto Import = ParseImport())
+      Build.addImport(Import);
+    else
+      // Skip token for error recovery.
+      getNextToken();
+  }
 };
 
 namespace fmt {
 template <>
-struct formatter<Parser::Expected> : formatter<std::string_view> {
-  auto format(const Parser::Expected &E, format_context &ctx) const
+struct formatter<ParserBase::Expected> : formatter<std::string_view> {
+  auto format(const ParserBase::Expected &E, format_context &ctx) const
       -> format_context::iterator {
     return fmt::format_to(ctx.out(), "{}",
                           fmt::join(E.Strs.begin(), E.Strs.end(), ", "));
@@ -667,20 +715,29 @@ struct formatter<Parser::Expected> : formatter<std::string_view> {
 
 } // namespace fmt
 
-inline std::nullptr_t Parser::logError(std::string_view Str) {
-  auto TokPos = L.getLastTokPos();
-  printError("{}:{}:{}: {}", Path, TokPos.first, TokPos.second, Str);
+inline std::nullptr_t ParserBase::logError(std::string_view Str) {
+  ++NumErrors;
+  auto [Row, Col] = Buffer.getLineAndColumn(Tokens.getOffset(CurPos));
+  if (DiagSink != nullptr)
+    DiagSink->push_back(
+        fmt::format("{}:{}:{}: {}", Buffer.getPath(), Row, Col, Str));
+  else
+    printError("{}:{}:{}: {}", Buffer.getPath(), Row, Col, Str);
   return nullptr;
 }
 
-inline std::nullptr_t Parser::logError(const Expected &E, const In &I) {
+inline std::nullptr_t ParserBase::logError(const Expected &E, const In &I) {
   logError(fmt::format("Expected [{}] in {}, got {}", E, I.Rule,
                        formatToken(CurTok)));
   return nullptr;
 }
 
-inline std::nullptr_t Parser::logError(const Expected &E, const After &Af) {
+inline std::nullptr_t ParserBase::logError(const Expected &E,
+                                           const After &Af) {
   logError(fmt::format("Expected [{}] after {}, got {}", E, Af.Symbol,
                        formatToken(CurTok)));
   return nullptr;
 }
+
+using Parser = BasicParser<ASTBuilder>;
+using FlatParser = BasicParser<FlatASTBuilder>;
@@ -0,0 +1,112 @@
+#include "parser/SourceBuffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::~SourceBuffer() {
+  if (Mapping != nullptr)
+    ::munmap(Mapping, MappingSize);
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::open(std::string Path) {
+  auto Buffer = std::unique_ptr<SourceBuffer>(new SourceBuffer(Path));
+
+  if (Path == "-") {
+    if (!Buffer->readStream(STDIN_FILENO))
+      return nullptr;
+    return Buffer;
+  }
+
+  int FD = ::open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (FD < 0)
+    return nullptr;
+
+  struct stat Stat;
+  bool Success = false;
+  if (::fstat(FD, &Stat) == 0) {
+    // Pipes, character devices and friends cannot be mapped.
+    if (S_ISREG(Stat.st_mode) && Stat.st_size > 0)
+      Success = Buffer->mapFile(FD, Stat.st_size);
+    else
+      Success = Buffer->readStream(FD);
+  }
+
+  int SavedErrno = errno;
+  ::close(FD);
+  errno = SavedErrno;
+
+  return Success ? std::move(Buffer) : nullptr;
+}
+
+bool SourceBuffer::mapFile(int FD, size_t Size) {
+  void *Addr = ::mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+  if (Addr == MAP_FAILED)
+    return readStream(FD);
+
+  // The Lexer walks the file front to back exactly once.
+  ::madvise(Addr, Size, MADV_SEQUENTIAL);
+
+  Mapping = Addr;
+  MappingSize = Size;
+  Begin = static_cast<const char *>(Addr);
+  End = Begin + Size;
+  return true;
+}
+
+bool SourceBuffer::readStream(int FD) {
+  char Chunk[64 * 1024];
+  while (true) {
+    ssize_t N = ::read(FD, Chunk, sizeof(Chunk));
+    if (N == 0)
+      break;
+    if (N < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Storage.append(Chunk, N);
+  }
+
+  Begin = Storage.data();
+  End = Begin + Storage.size();
+  return true;
+}
+
+void SourceBuffer::release(uint32_t Offset) {
+  if (Mapping == nullptr)
+    return;
+
+  static const size_t PageSize = ::sysconf(_SC_PAGESIZE);
+  size_t NewReleased = std::min<size_t>(Offset, MappingSize);
+  NewReleased = NewReleased / PageSize * PageSize;
+  if (NewReleased <= Released)
+    return;
+  ::madvise(static_cast<char *>(Mapping) + Released, NewReleased - Released,
+            MADV_DONTNEED);
+  Released = NewReleased;
+}
+
+std::pair<int, int> SourceBuffer::getLineAndColumn(uint32_t Offset) const {
+  if (LineOffsets.empty()) {
+    LineOffsets.push_back(0);
+    for (const char *P = Begin; P != End;) {
+      const auto *NL =
+          static_cast<const char *>(std::memchr(P, '\n', End - P));
+      if (NL == nullptr)
+        break;
+      P = NL + 1;
+      LineOffsets.push_back(P - Begin);
+    }
+  }
+
+  auto Iter = std::upper_bound(LineOffsets.begin(), LineOffsets.end(), Offset);
+  int Row = Iter - LineOffsets.begin();
+  int Col = Offset - *std::prev(Iter) + 1;
+  return {Row, Col};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "support/Noncopyable.h"
+
+//===----------------------------------------------------------------------===//
+// SourceBuffer
+//===----------------------------------------------------------------------===//
+
+/// SourceBuffer - Holds the whole input as one contiguous, read-only range of
+/// bytes. Regular files are mmapped; stdin and other streams are read into an
+/// owned buffer. Tokens refer to it through byte offsets and string_views, so
+/// the buffer must outlive everything produced by the Lexer and the Parser.
+class SourceBuffer : Noncopyable {
+public:
+  ~SourceBuffer();
+
+  /// Open \p Path, or stdin if \p Path is "-". Returns nullptr and leaves errno
+  /// set on failure.
+  static std::unique_ptr<SourceBuffer> open(std::string Path);
+
+  const char *begin() const { return Begin; }
+  const char *end() const { return End; }
+  size_t size() const { return End - Begin; }
+
+  std::string_view getText() const { return {Begin, size()}; }
+  const std::string &getPath() const { return Path; }
+
+  /// Translate a byte offset into a 1-based (row, column) pair. The line table
+  /// is built on the first call, so the common error-free path never pays for
+  /// it.
+  std::pair<int, int> getLineAndColumn(uint32_t Offset) const;
+
+  /// Hint that the bytes before \p Offset are no longer needed. Mapped pages
+  /// are dropped from memory and read back from the file if touched again.
+  void release(uint32_t Offset);
+
+private:
+  SourceBuffer(std::string Path) : Path(std::move(Path)) {}
+
+  bool mapFile(int FD, size_t Size);
+  bool readStream(int FD);
+
+  std::string Path;
+  const char *Begin = nullptr;
+  const char *End = nullptr;
+
+  /// Set when Begin/End point into a mapping that needs munmap.
+  void *Mapping = nullptr;
+  size_t MappingSize = 0;
+  /// Length of the page-aligned prefix of Mapping dropped by release().
+  size_t Released = 0;
+
+  /// Backing storage when the input could not be mapped.
+  std::string Storage;
+
+  /// Offset of the first byte of each line; LineOffsets[0] is always 0.
+  mutable std::vector<uint32_t> LineOffsets;
+};
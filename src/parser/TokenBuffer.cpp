@@ -0,0 +1,131 @@
+#include "parser/TokenBuffer.h"
+
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+template <typename T>
+TokenBuffer::Array<T>::Array(size_t Capacity) : Bytes(Capacity * sizeof(T)) {
+  void *Addr = ::mmap(nullptr, Bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (Addr == MAP_FAILED)
+    throw std::bad_alloc();
+  Data = static_cast<T *>(Addr);
+}
+
+template <typename T>
+TokenBuffer::Array<T>::~Array() {
+  ::munmap(Data, Bytes);
+}
+
+template <typename T>
+void TokenBuffer::Array<T>::discard(size_t End) {
+  static const size_t PageSize = ::sysconf(_SC_PAGESIZE);
+  size_t NewDiscarded = End * sizeof(T) / PageSize * PageSize;
+  if (NewDiscarded <= Discarded)
+    return;
+  ::madvise(reinterpret_cast<char *>(Data) + Discarded,
+            NewDiscarded - Discarded, MADV_DONTNEED);
+  Discarded = NewDiscarded;
+}
+
+// Every token but tok_eof covers at least one byte, and two numbers are always
+// separated by at least one other byte.
+TokenBuffer::TokenBuffer(const SourceBuffer &Buffer, size_t Window)
+    : Kinds(Buffer.size() + 1),
+      Offsets(Buffer.size() + 1),
+      Payloads(Buffer.size() + 1),
+      NumVals(Buffer.size() / 2 + 1),
+      Window(Window) {}
+
+TokenBuffer::~TokenBuffer() {
+  // A throttled lexer would otherwise wait forever for readers that are gone.
+  if (Window != 0)
+    advanceLimit(SIZE_MAX - Window);
+  if (Worker.joinable())
+    Worker.join();
+}
+
+std::unique_ptr<TokenBuffer>
+TokenBuffer::tokenize(const SourceBuffer &Buffer, bool Async, size_t Window) {
+  // A synchronous lexer has nobody to wait for.
+  auto Tokens = std::unique_ptr<TokenBuffer>(
+      new TokenBuffer(Buffer, Async ? Window : 0));
+  if (Async)
+    Tokens->Worker =
+        std::thread([&Buffer, T = Tokens.get()] { T->run(Buffer); });
+  else
+    Tokens->run(Buffer);
+  return Tokens;
+}
+
+void TokenBuffer::run(const SourceBuffer &Buffer) {
+  Lexer L(Buffer);
+  size_t Count = 0;
+  size_t NumCount = 0;
+
+  while (true) {
+    int Kind = L.gettok();
+    Kinds[Count] = static_cast<int16_t>(Kind);
+    Offsets[Count] = L.getLastTokOffset();
+    if (Kind == tok_identifier) {
+      Payloads[Count] = L.getSymbol().getID();
+    } else if (Kind == tok_number) {
+      NumVals[NumCount] = L.getNumVal();
+      Payloads[Count] = NumCount++;
+    }
+    ++Count;
+
+    if (Kind == tok_eof)
+      break;
+    if (Count % PublishInterval == 0) {
+      publish(Count, false);
+      if (Window != 0)
+        throttle(Count);
+    }
+  }
+
+  publish(Count, true);
+}
+
+Symbol TokenBuffer::getSymbol(size_t Index) const {
+  return Symbol::fromID(Payloads[clamp(Index)]);
+}
+
+void TokenBuffer::advanceLimit(size_t Index) const {
+  size_t Old = Limit.load(std::memory_order_relaxed);
+  while (Old < Index &&
+         !Limit.compare_exchange_weak(Old, Index, std::memory_order_release))
+    ;
+  Limit.notify_all();
+}
+
+void TokenBuffer::throttle(size_t Count) {
+  while (true) {
+    size_t Current = Limit.load(std::memory_order_acquire);
+    if (Count < Current + Window)
+      return;
+    Limit.wait(Current, std::memory_order_acquire);
+  }
+}
+
+void TokenBuffer::release(size_t Index) {
+  Index = std::min(Index, size_t(Published.load(std::memory_order_acquire) &
+                                 ~DoneBit));
+  if (Index <= Released)
+    return;
+
+  for (size_t I = Released; I != Index; ++I)
+    if (Kinds[I] == tok_number)
+      ++ReleasedNums;
+  Released = Index;
+
+  Kinds.discard(Released);
+  Offsets.discard(Released);
+  Payloads.discard(Released);
+  NumVals.discard(ReleasedNums);
+
+  if (Window != 0)
+    advanceLimit(Released);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "parser/Lexer.h"
+#include "parser/SourceBuffer.h"
+#include "support/Noncopyable.h"
+#include "support/Symbol.h"
+
+//===----------------------------------------------------------------------===//
+// TokenBuffer
+//===----------------------------------------------------------------------===//
+
+/// TokenBuffer - The whole token stream of a SourceBuffer, lexed in a separate
+/// pass and stored as a structure of arrays: one array of token kinds, one of
+/// byte offsets, and one of payloads. The payload of an identifier is its
+/// Symbol ID; the payload of a number is an index into the side table of
+/// literal values. Any token can be read by index, so the Parser gets
+/// arbitrary lookahead for free.
+///
+/// For large inputs, the tokens can be produced on a background thread. Readers
+/// then block only when they catch up with the lexer. A streaming reader can
+/// also bound how far the lexer runs ahead and hand consumed tokens back with
+/// release(), so the resident part of the buffer stays small however large the
+/// input is.
+class TokenBuffer : Noncopyable {
+public:
+  /// Inputs at least this large are lexed asynchronously by tokenize().
+  static constexpr size_t AsyncThreshold = 1 << 20;
+
+  ~TokenBuffer();
+
+  /// Lex \p Buffer, on a background thread if it is large.
+  static std::unique_ptr<TokenBuffer> tokenize(const SourceBuffer &Buffer) {
+    return tokenize(Buffer, Buffer.size() >= AsyncThreshold);
+  }
+
+  /// Lex \p Buffer. With a non-zero \p Window, an asynchronous lexer pauses
+  /// once it is that many tokens ahead of both the last release() and the
+  /// furthest token a reader has asked for.
+  static std::unique_ptr<TokenBuffer>
+  tokenize(const SourceBuffer &Buffer, bool Async, size_t Window = 0);
+
+  /// Token kind at \p Index. Indices past the end read as tok_eof.
+  int getKind(size_t Index) const { return Kinds[clamp(Index)]; }
+
+  uint32_t getOffset(size_t Index) const { return Offsets[clamp(Index)]; }
+
+  Symbol getSymbol(size_t Index) const;
+
+  int64_t getNumVal(size_t Index) const {
+    return NumVals[Payloads[clamp(Index)]];
+  }
+
+  /// Number of tokens, including the final tok_eof. Waits for the lexer.
+  size_t size() const {
+    wait(SIZE_MAX);
+    return Published.load(std::memory_order_acquire) & ~DoneBit;
+  }
+
+  /// Promise that no token before \p Index will be read again. Their storage
+  /// is returned to the system and a windowed lexer may move on.
+  void release(size_t Index);
+
+private:
+  /// Set in Published once the final tok_eof is visible.
+  static constexpr size_t DoneBit = size_t(1) << 63;
+
+  /// Publish a batch of tokens to readers at least this often.
+  static constexpr size_t PublishInterval = 4096;
+
+  TokenBuffer(const SourceBuffer &Buffer, size_t Window);
+
+  void run(const SourceBuffer &Buffer);
+
+  /// Let the lexer run at least up to \p Index + Window.
+  void advanceLimit(size_t Index) const;
+
+  /// Block the lexer while it is a whole window ahead of its readers.
+  void throttle(size_t Count);
+
+  void publish(size_t Count, bool Done) {
+    Published.store(Done ? (Count | DoneBit) : Count,
+                    std::memory_order_release);
+    Published.notify_all();
+  }
+
+  /// Block until the token at \p Index is visible, or the whole input has
+  /// been lexed.
+  void wait(size_t Index) const {
+    while (true) {
+      size_t State = Published.load(std::memory_order_acquire);
+      if ((State & DoneBit) != 0 || Index < State)
+        return;
+      if (Window != 0)
+        advanceLimit(Index);
+      Published.wait(State, std::memory_order_acquire);
+    }
+  }
+
+  size_t clamp(size_t Index) const {
+    // Fast path: the token has already been published.
+    if (Index < (Published.load(std::memory_order_acquire) & ~DoneBit))
+      return Index;
+
+    wait(Index);
+    // The last token is always tok_eof.
+    size_t Count = Published.load(std::memory_order_acquire) & ~DoneBit;
+    return std::min(Index, Count - 1);
+  }
+
+  /// An anonymous mapping sized up front for the worst case of one token per
+  /// byte. Pages are only committed once written, and are written only past
+  /// the published count, so readers never race with a reallocation.
+  template <typename T>
+  class Array : Noncopyable {
+  public:
+    explicit Array(size_t Capacity);
+    ~Array();
+
+    T &operator[](size_t Index) { return Data[Index]; }
+    const T &operator[](size_t Index) const { return Data[Index]; }
+
+    /// Drop the whole pages that lie before element \p End.
+    void discard(size_t End);
+
+  private:
+    T *Data;
+    size_t Bytes;
+    size_t Discarded = 0;
+  };
+
+  Array<int16_t> Kinds;
+  Array<uint32_t> Offsets;
+  Array<uint32_t> Payloads;
+  Array<int64_t> NumVals;
+
+  std::atomic<size_t> Published = 0;
+
+  /// Run-ahead bound of the lexer, or 0 for none.
+  const size_t Window;
+
+  /// The lexer may fill the buffer up to Limit + Window.
+  mutable std::atomic<size_t> Limit = 0;
+
+  /// Number of released tokens and numbers. Only touched by the reader.
+  size_t Released = 0;
+  size_t ReleasedNums = 0;
+
+  std::thread Worker;
+};
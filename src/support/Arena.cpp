@@ -0,0 +1,32 @@
+#include "support/Arena.h"
+
+#include <algorithm>
+#include <iterator>
+
+void *Arena::allocateSlow(size_t Size, size_t Align) {
+  // Leave room to align the start of the object however the slab is aligned.
+  size_t Needed = Size + Align - 1;
+
+  // Oversized objects get a slab of their own, so the current one can still
+  // be filled up.
+  if (Needed > NextSlabSize / 2) {
+    auto &Slab = Slabs.emplace_back(new char[Needed]);
+    auto Addr = reinterpret_cast<uintptr_t>(Slab.get());
+    return Slab.get() + (Align - Addr % Align) % Align;
+  }
+
+  auto &Slab = Slabs.emplace_back(new char[NextSlabSize]);
+  Cur = Slab.get();
+  End = Cur + NextSlabSize;
+  if (++SlabsOfSize == GrowthDelay) {
+    SlabsOfSize = 0;
+    NextSlabSize = std::min(NextSlabSize * 2, MaxSlabSize);
+  }
+  return allocate(Size, Align);
+}
+
+void Arena::adopt(Arena &&Other) {
+  Slabs.insert(Slabs.end(), std::make_move_iterator(Other.Slabs.begin()),
+               std::make_move_iterator(Other.Slabs.end()));
+  Other = Arena(Other.FirstSlabSize, Other.GrowthDelay);
+}
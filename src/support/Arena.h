@@ -0,0 +1,94 @@
+#ifndef TOY_LANG_SUPPORT_ARENA_H
+#define TOY_LANG_SUPPORT_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "support/Noncopyable.h"
+
+/// Arena - A bump-pointer allocator. Objects are carved out of large slabs one
+/// after the other and are never freed individually: all the memory goes away
+/// at once when the Arena is destroyed. No destructor is ever run, so only
+/// trivially destructible types may be allocated here.
+class Arena : Noncopyable {
+public:
+  Arena() = default;
+  /// Start with slabs of \p FirstSlabSize bytes, and make \p GrowthDelay
+  /// slabs of each size before doubling it. This suits owners that are often
+  /// much smaller than the default first slab, where a doubled slab would
+  /// mostly go unused.
+  explicit Arena(size_t FirstSlabSize, unsigned GrowthDelay = 1)
+      : FirstSlabSize(FirstSlabSize),
+        GrowthDelay(GrowthDelay),
+        NextSlabSize(FirstSlabSize) {}
+  Arena(Arena &&Other) noexcept { *this = std::move(Other); }
+  Arena &operator=(Arena &&Other) noexcept {
+    Slabs = std::move(Other.Slabs);
+    FirstSlabSize = Other.FirstSlabSize;
+    GrowthDelay = Other.GrowthDelay;
+    NextSlabSize = std::exchange(Other.NextSlabSize, Other.FirstSlabSize);
+    SlabsOfSize = std::exchange(Other.SlabsOfSize, 0);
+    Cur = std::exchange(Other.Cur, nullptr);
+    End = std::exchange(Other.End, nullptr);
+    return *this;
+  }
+
+  void *allocate(size_t Size, size_t Align) {
+    auto Addr = reinterpret_cast<uintptr_t>(Cur);
+    size_t Adjust = (Align - Addr % Align) % Align;
+    if (Cur == nullptr || Size + Adjust > size_t(End - Cur))
+      return allocateSlow(Size, Align);
+
+    char *Ptr = Cur + Adjust;
+    Cur = Ptr + Size;
+    return Ptr;
+  }
+
+  template <typename T, typename... ArgTs>
+  T *create(ArgTs &&...Args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "An Arena never runs destructors");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<ArgTs>(Args)...);
+  }
+
+  /// Copy \p Items into the Arena.
+  template <typename T>
+  std::span<T> copy(std::span<const T> Items) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "An Arena never runs destructors");
+    if (Items.empty())
+      return {};
+    auto *Ptr = static_cast<T *>(allocate(Items.size_bytes(), alignof(T)));
+    std::uninitialized_copy(Items.begin(), Items.end(), Ptr);
+    return {Ptr, Items.size()};
+  }
+
+  /// Take over every slab of \p Other, which is left empty. Objects allocated
+  /// from it now live as long as this Arena.
+  void adopt(Arena &&Other);
+
+private:
+  /// Slabs start small so that tiny units stay cheap, and double up to a cap.
+  static constexpr size_t MinSlabSize = 4096;
+  static constexpr size_t MaxSlabSize = 1 << 20;
+
+  void *allocateSlow(size_t Size, size_t Align);
+
+  std::vector<std::unique_ptr<char[]>> Slabs;
+  size_t FirstSlabSize = MinSlabSize;
+  unsigned GrowthDelay = 1;
+  size_t NextSlabSize = MinSlabSize;
+  /// Slabs made so far of NextSlabSize bytes.
+  unsigned SlabsOfSize = 0;
+  char *Cur = nullptr;
+  char *End = nullptr;
+};
+
+#endif // !TOY_LANG_SUPPORT_ARENA_H
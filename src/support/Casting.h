@@ -0,0 +1,45 @@
+#ifndef TOY_LANG_SUPPORT_CASTING_H
+#define TOY_LANG_SUPPORT_CASTING_H
+
+#include <cassert>
+#include <type_traits>
+
+/// isa<>, cast<> and dyn_cast<> - Checked downcasts without RTTI. A class To
+/// supports them by providing a static To::classof(const From *) that says
+/// whether an object is a To, usually by looking at a kind field.
+
+template <typename To, typename From> bool isa(const From *Val) {
+  assert(Val != nullptr && "isa<> on a null pointer");
+  return To::classof(Val);
+}
+
+template <typename To, typename From>
+  requires(!std::is_pointer_v<From>)
+bool isa(const From &Val) {
+  return To::classof(&Val);
+}
+
+/// The type \p To, const if \p From is.
+template <typename To, typename From>
+using CastResult = std::conditional_t<std::is_const_v<From>, const To, To>;
+
+/// Downcast \p Val, which must be a \p To.
+template <typename To, typename From> CastResult<To, From> *cast(From *Val) {
+  assert(isa<To>(Val) && "cast<> to the wrong kind");
+  return static_cast<CastResult<To, From> *>(Val);
+}
+
+template <typename To, typename From>
+  requires(!std::is_pointer_v<From>)
+CastResult<To, From> &cast(From &Val) {
+  assert(isa<To>(Val) && "cast<> to the wrong kind");
+  return static_cast<CastResult<To, From> &>(Val);
+}
+
+/// Downcast \p Val if it is a \p To, and return null otherwise.
+template <typename To, typename From>
+CastResult<To, From> *dyn_cast(From *Val) {
+  return isa<To>(Val) ? static_cast<CastResult<To, From> *>(Val) : nullptr;
+}
+
+#endif // !TOY_LANG_SUPPORT_CASTING_H
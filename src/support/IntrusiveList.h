@@ -0,0 +1,142 @@
+#ifndef TOY_LANG_SUPPORT_INTRUSIVE_LIST_H
+#define TOY_LANG_SUPPORT_INTRUSIVE_LIST_H
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+#include "support/Noncopyable.h"
+
+template <typename T> class IntrusiveList;
+
+/// IntrusiveListNode - The links that let a T be on an IntrusiveList. A T
+/// derives from this, and is on at most one list at a time.
+template <typename T> class IntrusiveListNode {
+public:
+  /// The neighbours on the list, or null at either end.
+  T *getPrevNode() const { return Prev; }
+  T *getNextNode() const { return Next; }
+
+private:
+  friend class IntrusiveList<T>;
+
+  T *Prev = nullptr;
+  T *Next = nullptr;
+};
+
+/// IntrusiveList - A doubly linked list of objects that carry their own
+/// links. Inserting and unlinking are O(1) anywhere, and iterators stay
+/// valid until their element is unlinked. The list does not own its
+/// elements.
+template <typename T> class IntrusiveList : Noncopyable {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    iterator() = default;
+
+    reference operator*() const { return *Node; }
+    pointer operator->() const { return Node; }
+
+    iterator &operator++() {
+      Node = Node->IntrusiveListNode<T>::getNextNode();
+      return *this;
+    }
+    iterator operator++(int) {
+      auto Old = *this;
+      ++*this;
+      return Old;
+    }
+    /// Stepping back from end() gives the last element.
+    iterator &operator--() {
+      Node = Node != nullptr ? Node->IntrusiveListNode<T>::getPrevNode()
+                             : List->Tail;
+      return *this;
+    }
+    iterator operator--(int) {
+      auto Old = *this;
+      --*this;
+      return Old;
+    }
+
+    bool operator==(const iterator &Other) const {
+      return Node == Other.Node;
+    }
+
+    /// The element, or null for end().
+    T *getNode() const { return Node; }
+
+  private:
+    friend class IntrusiveList;
+
+    iterator(T *Node, const IntrusiveList *List) : Node(Node), List(List) {}
+
+    T *Node = nullptr;
+    const IntrusiveList *List = nullptr;
+  };
+
+  using reverse_iterator = std::reverse_iterator<iterator>;
+
+  IntrusiveList() = default;
+
+  iterator begin() const { return {Head, this}; }
+  iterator end() const { return {nullptr, this}; }
+  reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+  /// The position of \p N, which must be on this list.
+  iterator getIterator(T *N) const { return {N, this}; }
+
+  bool empty() const { return Head == nullptr; }
+  size_t size() const { return Size; }
+
+  T &front() const {
+    assert(!empty() && "front() of an empty list");
+    return *Head;
+  }
+  T &back() const {
+    assert(!empty() && "back() of an empty list");
+    return *Tail;
+  }
+
+  /// Link \p N in before \p Pos, and return its position.
+  iterator insert(iterator Pos, T *N) {
+    auto &Links = node(N);
+    assert(Links.Prev == nullptr && Links.Next == nullptr && Head != N &&
+           "Element is already on a list");
+    T *Next = Pos.Node;
+    T *Prev = Next != nullptr ? node(Next).Prev : Tail;
+    Links.Prev = Prev;
+    Links.Next = Next;
+    (Prev != nullptr ? node(Prev).Next : Head) = N;
+    (Next != nullptr ? node(Next).Prev : Tail) = N;
+    ++Size;
+    return {N, this};
+  }
+
+  void push_back(T *N) { insert(end(), N); }
+  void push_front(T *N) { insert(begin(), N); }
+
+  /// Unlink \p N, which must be on this list.
+  void remove(T *N) {
+    auto &Links = node(N);
+    (Links.Prev != nullptr ? node(Links.Prev).Next : Head) = Links.Next;
+    (Links.Next != nullptr ? node(Links.Next).Prev : Tail) = Links.Prev;
+    Links.Prev = Links.Next = nullptr;
+    --Size;
+  }
+
+private:
+  static IntrusiveListNode<T> &node(T *N) { return *N; }
+
+  T *Head = nullptr;
+  T *Tail = nullptr;
+  size_t Size = 0;
+};
+
+#endif // !TOY_LANG_SUPPORT_INTRUSIVE_LIST_H
@@ -0,0 +1,96 @@
+#include "support/Symbol.h"
+
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view Keywords[] = {
+#define TOY_KEYWORD(Spelling, Token) #Spelling,
+#include "support/Keywords.def"
+};
+
+class SymbolTable {
+public:
+  SymbolTable() {
+    insert("");
+    for (auto Keyword : Keywords)
+      insert(Keyword);
+  }
+
+  static SymbolTable &get() {
+    static SymbolTable Table;
+    return Table;
+  }
+
+  uint32_t intern(std::string_view Str) {
+    // Identifiers repeat a lot. A small per-thread cache of recent hits lets
+    // most lookups skip the lock entirely; cached views point into Storage,
+    // which never moves.
+    struct CacheEntry {
+      std::string_view Spelling;
+      uint32_t ID = 0;
+    };
+    thread_local CacheEntry Cache[1024];
+
+    size_t Hash = std::hash<std::string_view>()(Str);
+    auto &Entry = Cache[Hash % std::size(Cache)];
+    if (Entry.ID != 0 && Entry.Spelling == Str)
+      return Entry.ID;
+
+    {
+      std::shared_lock Lock(Mutex);
+      if (auto Iter = IDs.find(Str); Iter != IDs.end()) {
+        Entry = {Iter->first, Iter->second};
+        return Entry.ID;
+      }
+    }
+
+    std::unique_lock Lock(Mutex);
+    uint32_t ID = insert(Str);
+    Entry = {Spellings[ID], ID};
+    return ID;
+  }
+
+  std::string_view lookup(uint32_t ID) {
+    std::shared_lock Lock(Mutex);
+    return Spellings[ID];
+  }
+
+private:
+  uint32_t insert(std::string_view Str) {
+    // Someone may have inserted Str between dropping the shared lock and
+    // taking the exclusive one.
+    if (auto Iter = IDs.find(Str); Iter != IDs.end())
+      return Iter->second;
+
+    // std::deque never relocates its elements, so views into them stay valid.
+    std::string_view Stored = Storage.emplace_back(Str);
+    uint32_t ID = Spellings.size();
+    Spellings.push_back(Stored);
+    IDs.emplace(Stored, ID);
+    return ID;
+  }
+
+  std::shared_mutex Mutex;
+  std::deque<std::string> Storage;
+  std::vector<std::string_view> Spellings;
+  std::unordered_map<std::string_view, uint32_t> IDs;
+};
+
+} // namespace
+
+const uint32_t Symbol::NumKeywords = std::size(Keywords);
+
+Symbol Symbol::intern(std::string_view Str) {
+  return Symbol(SymbolTable::get().intern(Str));
+}
+
+std::string_view Symbol::str() const {
+  return SymbolTable::get().lookup(ID);
+}
@@ -0,0 +1,66 @@
+#ifndef TOY_LANG_SUPPORT_SYMBOL_H
+#define TOY_LANG_SUPPORT_SYMBOL_H
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "fmt/format.h"
+
+/// Symbol - An interned identifier. Every distinct spelling is stored once in
+/// a process-wide table and represented everywhere else by a 32-bit ID, so
+/// comparing, hashing and copying names is as cheap as for an integer.
+///
+/// ID 0 is the empty spelling, which is also what a default-constructed Symbol
+/// refers to. IDs 1 to NumKeywords are the reserved words listed in
+/// support/Keywords.def, in order.
+class Symbol {
+public:
+  Symbol() = default;
+
+  /// Return the Symbol for \p Str, adding it to the table if needed. Safe to
+  /// call from multiple threads.
+  static Symbol intern(std::string_view Str);
+
+  static const uint32_t NumKeywords;
+
+  /// Rebuild a Symbol from an ID previously returned by getID().
+  static Symbol fromID(uint32_t ID) { return Symbol(ID); }
+
+  uint32_t getID() const { return ID; }
+
+  std::string_view str() const;
+
+  bool empty() const { return ID == 0; }
+
+  bool isKeyword() const { return ID != 0 && ID <= NumKeywords; }
+
+  /// Position of this keyword in Keywords.def.
+  uint32_t getKeywordIndex() const { return ID - 1; }
+
+  friend bool operator==(Symbol LHS, Symbol RHS) = default;
+  friend auto operator<=>(Symbol LHS, Symbol RHS) = default;
+
+private:
+  explicit Symbol(uint32_t ID) : ID(ID) {}
+
+  uint32_t ID = 0;
+};
+
+template <>
+struct std::hash<Symbol> {
+  size_t operator()(Symbol S) const noexcept {
+    return std::hash<uint32_t>()(S.getID());
+  }
+};
+
+template <>
+struct fmt::formatter<Symbol> : fmt::formatter<std::string_view> {
+  auto format(Symbol S, format_context &Ctx) const
+      -> format_context::iterator {
+    return fmt::formatter<std::string_view>::format(S.str(), Ctx);
+  }
+};
+
+#endif // !TOY_LANG_SUPPORT_SYMBOL_H
@@ -0,0 +1,107 @@
+#include "support/ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+/// The pool that the current thread works for, and its index there.
+thread_local const void *CurrentPool = nullptr;
+thread_local size_t CurrentIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned NumThreads) {
+  if (NumThreads == 0)
+    NumThreads = std::max(1U, std::thread::hardware_concurrency());
+
+  Queues.reserve(NumThreads);
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Queues.push_back(std::make_unique<TaskQueue>());
+
+  Workers.reserve(NumThreads);
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Workers.emplace_back([this, I] { work(I); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock Lock(Mutex);
+    Stopping = true;
+  }
+  HasWork.notify_all();
+
+  for (auto &Worker : Workers)
+    Worker.join();
+}
+
+void ThreadPool::async(std::function<void()> Task) {
+  size_t Index = 0;
+  if (CurrentPool == this) {
+    Index = CurrentIndex;
+  } else {
+    std::unique_lock Lock(Mutex);
+    Index = NextQueue++ % Queues.size();
+  }
+
+  {
+    std::unique_lock Lock(Queues[Index]->Mutex);
+    Queues[Index]->Tasks.push_back(std::move(Task));
+  }
+
+  {
+    std::unique_lock Lock(Mutex);
+    ++Queued;
+    ++Unfinished;
+  }
+  HasWork.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock Lock(Mutex);
+  AllDone.wait(Lock, [this] { return Unfinished == 0; });
+}
+
+std::function<void()> ThreadPool::take(size_t Index) {
+  // Every claim is backed by a task that is already in some deque, but
+  // another worker may get to it first, so keep looking until one turns up.
+  while (true) {
+    for (size_t I = 0; I < Queues.size(); ++I) {
+      auto &Queue = *Queues[(Index + I) % Queues.size()];
+      std::unique_lock Lock(Queue.Mutex);
+      if (Queue.Tasks.empty())
+        continue;
+
+      std::function<void()> Task;
+      if (I == 0) {
+        Task = std::move(Queue.Tasks.back());
+        Queue.Tasks.pop_back();
+      } else {
+        Task = std::move(Queue.Tasks.front());
+        Queue.Tasks.pop_front();
+      }
+      return Task;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void ThreadPool::work(size_t Index) {
+  CurrentPool = this;
+  CurrentIndex = Index;
+
+  while (true) {
+    {
+      std::unique_lock Lock(Mutex);
+      HasWork.wait(Lock, [this] { return Stopping || Queued != 0; });
+      if (Queued == 0)
+        return;
+      --Queued;
+    }
+
+    take(Index)();
+
+    std::unique_lock Lock(Mutex);
+    if (--Unfinished == 0)
+      AllDone.notify_all();
+  }
+}
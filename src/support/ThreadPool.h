@@ -0,0 +1,64 @@
+#ifndef TOY_LANG_SUPPORT_THREAD_POOL_H
+#define TOY_LANG_SUPPORT_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "support/Noncopyable.h"
+
+/// ThreadPool - A fixed set of worker threads with a deque of tasks each.
+///
+/// Tasks submitted from outside the pool are dealt out to the deques in turn,
+/// and a task that a worker submits goes onto its own deque. A worker takes
+/// its newest task first. When its deque is empty, it steals the oldest task
+/// of another worker, so uneven tasks still keep every thread busy.
+class ThreadPool : Noncopyable {
+public:
+  /// Spawn \p NumThreads workers, or one per hardware thread if it is 0.
+  explicit ThreadPool(unsigned NumThreads = 0);
+
+  /// Finish every queued task, then join the workers.
+  ~ThreadPool();
+
+  unsigned getNumThreads() const { return Workers.size(); }
+
+  void async(std::function<void()> Task);
+
+  /// Block until every task submitted so far has finished.
+  void wait();
+
+private:
+  struct TaskQueue {
+    std::mutex Mutex;
+    std::deque<std::function<void()>> Tasks;
+  };
+
+  void work(size_t Index);
+
+  /// Take a task, looking in the deque of worker \p Index first. The caller
+  /// must have claimed one of the Queued tasks.
+  std::function<void()> take(size_t Index);
+
+  std::vector<std::thread> Workers;
+  std::vector<std::unique_ptr<TaskQueue>> Queues;
+
+  /// Guards the counters below, which the workers sleep on.
+  std::mutex Mutex;
+  std::condition_variable HasWork;
+  std::condition_variable AllDone;
+  /// Tasks in the deques that no worker has claimed yet.
+  size_t Queued = 0;
+  /// Tasks that have been submitted and have not finished.
+  size_t Unfinished = 0;
+  /// The deque that the next task from outside the pool goes to.
+  size_t NextQueue = 0;
+  bool Stopping = false;
+};
+
+#endif // !TOY_LANG_SUPPORT_THREAD_POOL_H
@@ -39,6 +39,50 @@ std::string CBNZ::toAsm() {
   return fmt::format("cbnz\t{}, {}", Value->toAsm(), Target->toAsm());
 }
 
+std::string_view getCondName(CondCode CC) {
+  switch (CC) {
+  case CondCode::EQ: return "eq";
+  case CondCode::NE: return "ne";
+  case CondCode::LT: return "lt";
+  case CondCode::LE: return "le";
+  case CondCode::GT: return "gt";
+  case CondCode::GE: return "ge";
+  case CondCode::LO: return "lo";
+  case CondCode::LS: return "ls";
+  case CondCode::HI: return "hi";
+  case CondCode::HS: return "hs";
+  }
+  return "";
+}
+
+CondCode getInverseCond(CondCode CC) {
+  switch (CC) {
+  case CondCode::EQ: return CondCode::NE;
+  case CondCode::NE: return CondCode::EQ;
+  case CondCode::LT: return CondCode::GE;
+  case CondCode::LE: return CondCode::GT;
+  case CondCode::GT: return CondCode::LE;
+  case CondCode::GE: return CondCode::LT;
+  case CondCode::LO: return CondCode::HS;
+  case CondCode::LS: return CondCode::HI;
+  case CondCode::HI: return CondCode::LS;
+  case CondCode::HS: return CondCode::LO;
+  }
+  return CC;
+}
+
+std::string Bcc::toAsm() {
+  return fmt::format("b.{}\t{}", getCondName(CC), Target->toAsm());
+}
+
+std::string CMP::toAsm() {
+  return fmt::format("cmp\t{}, {}", LHS->toAsm(), RHS->toAsm());
+}
+
+std::string CSET::toAsm() {
+  return fmt::format("cset\t{}, {}", Result->toAsm(), getCondName(CC));
+}
+
 std::string BL::toAsm() {
   return fmt::format("bl\t{}", Target->toAsm());
 }
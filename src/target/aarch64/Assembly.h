@@ -4,6 +4,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "fmt/format.h"
@@ -212,6 +213,73 @@ public:
   }
 };
 
+/// CondCode - A condition on the flags that a CMP sets, as tested by B.cond
+/// and CSET.
+enum class CondCode {
+  EQ,
+  NE,
+  LT,
+  LE,
+  GT,
+  GE,
+  LO,
+  LS,
+  HI,
+  HS,
+};
+
+std::string_view getCondName(CondCode CC);
+
+/// The condition that holds exactly when \p CC does not.
+CondCode getInverseCond(CondCode CC);
+
+/// B.cond - Branch if the flags satisfy the condition.
+class Bcc : public Instruction {
+  CondCode CC;
+  Label *Target;
+
+public:
+  Bcc(CondCode CC, Label *Target) : CC(CC), Target(Target) {}
+
+  std::string toAsm() override;
+};
+
+class CMP : public Instruction {
+  Operand *LHS;
+  Operand *RHS;
+
+public:
+  CMP(Operand *LHS, Operand *RHS) : LHS(LHS), RHS(RHS) {}
+
+  std::string toAsm() override;
+  void collectVirtRegs(std::vector<Operand **> &Src,
+                       std::vector<Operand **> & /*Dst*/) override {
+    for (auto Op : {&LHS, &RHS}) {
+      if ((*Op)->isVirtual())
+        Src.push_back(Op);
+      else if ((*Op)->isMemory())
+        (*Op)->collectVirtRegs(Src);
+    }
+  }
+};
+
+/// CSET - Set the result to 1 if the flags satisfy the condition, and to 0
+/// otherwise.
+class CSET : public Instruction {
+  Operand *Result;
+  CondCode CC;
+
+public:
+  CSET(Operand *Result, CondCode CC) : Result(Result), CC(CC) {}
+
+  std::string toAsm() override;
+  void collectVirtRegs(std::vector<Operand **> & /*Src*/,
+                       std::vector<Operand **> &Dst) override {
+    if (Result->isVirtual())
+      Dst.push_back(&Result);
+  }
+};
+
 class BL : public Instruction {
   Label *Target;
 
@@ -1,6 +1,10 @@
 #ifndef TOY_LANG_TARGET_AARCH64_ASSEMBLY_UNIT_H
 #define TOY_LANG_TARGET_AARCH64_ASSEMBLY_UNIT_H
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+
 #include "target/aarch64/Assembly.h"
 
 namespace aarch64 {
@@ -47,6 +51,7 @@ class AssemblyUnit {
   };
   std::vector<std::unique_ptr<Procedure>> DefinedProcedures;
   std::vector<std::unique_ptr<Label>> ExternalProcedures;
+  std::vector<std::unique_ptr<Label>> RetiredProcedures;
 
 public:
   PhysicalRegister *getPhysicsReg(int N) {
@@ -68,6 +73,20 @@ public:
     return DefinedProcedures.back().get();
   }
 
+  /// Free \p Proc once its code has been written out. Returns a stand-in for
+  /// its entry label, so that later calls to it can still be lowered.
+  Label *retireProcedure(Procedure *Proc) {
+    auto Iter = std::find_if(
+        DefinedProcedures.rbegin(), DefinedProcedures.rend(),
+        [Proc](const auto &Ptr) { return Ptr.get() == Proc; });
+    assert(Iter != DefinedProcedures.rend() && "Unknown procedure");
+
+    RetiredProcedures.emplace_back(
+        std::make_unique<Label>(std::string(Proc->getEntryLabel()->getName())));
+    DefinedProcedures.erase(std::next(Iter).base());
+    return RetiredProcedures.back().get();
+  }
+
   Label *addExternalProcedure(std::string ProcName) {
     ExternalProcedures.emplace_back(
         std::make_unique<Label>(std::move(ProcName)));
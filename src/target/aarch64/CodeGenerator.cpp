@@ -1,48 +1,115 @@
 #include "target/aarch64/CodeGenerator.h"
 
+#include <algorithm>
 #include <cassert>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
 
 #include "ir/AllocaInst.h"
 #include "ir/BranchInst.h"
 #include "ir/CallInst.h"
+#include "ir/PhiInst.h"
 
 namespace aarch64 {
 
-void CodeGenerator::visit(IRCompilationUnit &IRUnit) {
-  for (auto &Fn : IRUnit) {
-    if (Fn->getBlocks().empty()) {
-      auto *Lbl = Unit.addExternalProcedure(Fn->getName());
-      FnTable[Fn.get()] = Lbl;
-      continue;
-    }
-
-    auto *Proc = Unit.makeNewProcedure(Fn->getName());
-    FnTable[Fn.get()] = Proc->getEntryLabel();
+void CodeGenerator::lower(IRCompilationUnit &IRUnit) {
+  for (auto &Fn : IRUnit)
+    lower(*Fn);
+}
 
-    FunctionCG FnCG(*this, Unit, *Proc);
-    Fn->accept(FnCG);
+Procedure *CodeGenerator::lower(Function &Fn) {
+  // The body of an imported function is only there for the optimizer.
+  if (Fn.getBlocks().empty() || Fn.isAvailableExternally()) {
+    auto *Lbl = Unit.addExternalProcedure(std::string(Fn.getName().str()));
+    FnTable[&Fn] = Lbl;
+    return nullptr;
   }
+
+  auto *Proc = Unit.makeNewProcedure(std::string(Fn.getName().str()));
+  FnTable[&Fn] = Proc->getEntryLabel();
+
+  FunctionCG FnCG(*this, Unit, *Proc);
+  FnCG.visit(Fn);
+  return Proc;
+}
+
+void CodeGenerator::retire(Function &Fn, Procedure &Proc) {
+  FnTable[&Fn] = Unit.retireProcedure(&Proc);
 }
 
 Label *CodeGenerator::lookupFunctionEntry(Function *Fn) {
-  return FnTable[Fn];
+  // A function that was never lowered, such as one declared by an import
+  // while compiling one declaration at a time, is external.
+  auto &Entry = FnTable[Fn];
+  if (Entry == nullptr)
+    Entry = Unit.addExternalProcedure(std::string(Fn->getName().str()));
+  return Entry;
 }
 
 void FunctionCG::visit(Function &Fn) {
+  ValueTable.assign(Fn.getNumValueIDs(), nullptr);
+  BBTable.assign(Fn.getNumBlockIDs(), nullptr);
   Prologue = Proc.getPrologue();
   Proc.setInsertPoint(this->Prologue);
   for (auto &Param : Fn.getArgs())
-    Param->accept(*this);
+    visit(*Param);
 
   for (auto &BB : Fn.getBlocks())
-    BBTable[BB.get()] = Proc.makeNewLabel(std::string(BB->getName()));
+    labelOf(&BB) = Proc.makeNewLabel(fmt::format("BB_{}", BB.getID()));
   this->Epilogue = Proc.getEpilogue();
 
-  for (auto &C : Fn.getConstants())
-    C->accept(*this);
+  for (auto *C : Fn.getConstants())
+    visit(*C);
 
+  // A phi gets its value at the end of each predecessor, which may come
+  // before the phi's block, so every phi needs its register up front.
   for (auto &BB : Fn.getBlocks())
-    BB->accept(*this);
+    for (auto &Inst : BB) {
+      if (!isa<PhiInst>(Inst))
+        break;
+      operandOf(&Inst) = Proc.makeVirtReg();
+    }
+
+  for (auto &BB : Fn.getBlocks()) {
+    visit(BB);
+
+    // A block without a terminator falls through to the next one.
+    auto *Next = BB.getNextNode();
+    if (Next != nullptr && (BB.empty() || !BB.getLastInst()->isTerminator()))
+      emitPhiCopies({Next});
+  }
+}
+
+void FunctionCG::emitPhiCopies(std::initializer_list<BasicBlock *> Succs) {
+  std::vector<std::pair<Operand *, Operand *>> Copies;
+  for (auto *To : Succs) {
+    for (auto &Inst : *To) {
+      if (!isa<PhiInst>(Inst))
+        break;
+      auto &Phi = cast<PhiInst>(Inst);
+      if (auto *Val = Phi.getIncomingValueForBlock(CurBB))
+        Copies.emplace_back(operandOf(&Phi), operandOf(Val));
+    }
+  }
+
+  // The phis take their values at once. If one of them is the value of
+  // another, as when a loop swaps two variables, the old values are copied
+  // out of the way first.
+  bool Overlap = std::any_of(Copies.begin(), Copies.end(), [&](auto &Copy) {
+    return std::any_of(Copies.begin(), Copies.end(),
+                       [&](auto &Other) { return Other.first == Copy.second; });
+  });
+  if (Overlap) {
+    for (auto &[Phi, Val] : Copies) {
+      auto *Tmp = Proc.makeVirtReg();
+      Proc.emit<MOV>(Tmp, Val);
+      Val = Tmp;
+    }
+  }
+  for (auto &[Phi, Val] : Copies)
+    Proc.emit<MOV>(Phi, Val);
 }
 
 void FunctionCG::visit(Parameter &Param) {
@@ -54,34 +121,37 @@ void FunctionCG::visit(Parameter &Param) {
   // ValueTable[&Param] = Unit.getPhysicsReg(ArgCnt++);
   auto SS = Proc.allocateStackSlot();
   Proc.emit<STR>(Unit.getPhysicsReg(ArgCnt), SS);
-  ValueTable[&Param] = SS;
+  auto *Val = Proc.makeVirtReg();
+  Proc.emit<LDR>(Val, SS);
+  operandOf(&Param) = Val;
 
   ++ArgCnt;
 }
 
 void FunctionCG::visit(BasicBlock &BB) {
   // Emit all target code under this label.
-  auto *TheLabel = BBTable[&BB];
+  auto *TheLabel = labelOf(&BB);
   Proc.setInsertPoint(TheLabel);
+  CurBB = &BB;
 
   for (auto &Inst : BB)
-    Inst->accept(*this);
+    visit(Inst);
 }
 
 void FunctionCG::visit(Constant &C) {
   // Make a new Constant Operand and store it in the ValueTable
-  ValueTable[&C] = Proc.makeImm(C.getVal());
+  operandOf(&C) = Proc.makeImm(C.getVal());
 }
 
 void FunctionCG::visit(AllocaInst &Inst) {
   // Assign a new StackSlot, store it in the ValueTable
-  ValueTable[&Inst] = Proc.allocateStackSlot();
+  operandOf(&Inst) = Proc.allocateStackSlot();
 }
 
 void FunctionCG::visit(StoreInst &Inst) {
   // Fetch the Operand from the ValueTable, emit a new STR inst
-  auto *Ptr = ValueTable[Inst.getPtr()];
-  auto *Val = ValueTable[Inst.getVal()];
+  auto *Ptr = operandOf(Inst.getPtr());
+  auto *Val = operandOf(Inst.getVal());
   assert(Ptr->isMemory());
   assert(Val->isConstant() || Val->isRegister());
   Proc.emit<STR>(Val, Ptr);
@@ -89,16 +159,16 @@ void FunctionCG::visit(StoreInst &Inst) {
 
 void FunctionCG::visit(LoadInst &Inst) {
   // Make a new VirtualRegister. Emit a LDR inst. store it in the ValueTable.
-  auto *Ptr = ValueTable[Inst.getPtr()];
+  auto *Ptr = operandOf(Inst.getPtr());
   auto *Result = Proc.makeVirtReg();
   assert(Ptr->isMemory());
   Proc.emit<LDR>(Result, Ptr);
-  ValueTable[&Inst] = Result;
+  operandOf(&Inst) = Result;
 }
 
 void FunctionCG::visit(ArithmeticInst &Inst) {
-  auto *LHS = ValueTable[Inst.getLHS()];
-  auto *RHS = ValueTable[Inst.getRHS()];
+  auto *LHS = operandOf(Inst.getLHS());
+  auto *RHS = operandOf(Inst.getRHS());
   auto *Result = Proc.makeVirtReg();
   assert(LHS->isConstant() || LHS->isRegister());
   assert(RHS->isConstant() || RHS->isRegister());
@@ -107,27 +177,113 @@ void FunctionCG::visit(ArithmeticInst &Inst) {
   case ArithmeticInst::Opcode::Sub: Proc.emit<SUB>(Result, LHS, RHS); break;
   case ArithmeticInst::Opcode::Mul: Proc.emit<MUL>(Result, LHS, RHS); break;
   }
-  ValueTable[&Inst] = Result;
+  operandOf(&Inst) = Result;
+}
+
+bool FunctionCG::isFusedWithBranch(CompareInst &Cmp) {
+  if (!Cmp.hasOneUse())
+    return false;
+  auto *Br = dyn_cast<CJumpInst>(Cmp.getFirstUse()->getUser());
+  return Br != nullptr && Br->getParent() == Cmp.getParent();
+}
+
+CondCode FunctionCG::emitCompare(CompareInst &Cmp) {
+  using Predicate = CompareInst::Predicate;
+  auto *LHS = operandOf(Cmp.getLHS());
+  auto *RHS = operandOf(Cmp.getRHS());
+  auto Pred = Cmp.getPred();
+  assert(LHS->isConstant() || LHS->isRegister());
+  assert(RHS->isConstant() || RHS->isRegister());
+  // Only the second operand of CMP may be an immediate.
+  if (LHS->isConstant() && !RHS->isConstant()) {
+    std::swap(LHS, RHS);
+    Pred = CompareInst::getSwappedPredicate(Pred);
+  } else if (LHS->isConstant()) {
+    auto *Tmp = Proc.makeVirtReg();
+    Proc.emit<MOV>(Tmp, LHS);
+    LHS = Tmp;
+  }
+  Proc.emit<CMP>(LHS, RHS);
+
+  switch (Pred) {
+  case Predicate::EQ: return CondCode::EQ;
+  case Predicate::NE: return CondCode::NE;
+  case Predicate::SLT: return CondCode::LT;
+  case Predicate::SLE: return CondCode::LE;
+  case Predicate::SGT: return CondCode::GT;
+  case Predicate::SGE: return CondCode::GE;
+  case Predicate::ULT: return CondCode::LO;
+  case Predicate::ULE: return CondCode::LS;
+  case Predicate::UGT: return CondCode::HI;
+  case Predicate::UGE: return CondCode::HS;
+  }
+  return CondCode::EQ;
+}
+
+void FunctionCG::visit(CompareInst &Inst) {
+  if (isFusedWithBranch(Inst))
+    return;
+  auto CC = emitCompare(Inst);
+  auto *Result = Proc.makeVirtReg();
+  Proc.emit<CSET>(Result, CC);
+  operandOf(&Inst) = Result;
 }
 
 void FunctionCG::visit(JumpInst &Inst) {
-  auto *Lbl = BBTable[Inst.getDest()];
+  emitPhiCopies({Inst.getDest()});
+  auto *Lbl = labelOf(Inst.getDest());
   Proc.emit<B>(Lbl);
 }
 
 void FunctionCG::visit(CJumpInst &Inst) {
-  auto *Cond = ValueTable[Inst.getCond()];
-  auto *T = BBTable[Inst.getTrueBB()];
-  auto *F = BBTable[Inst.getFalseBB()];
+  auto *T = labelOf(Inst.getTrueBB());
+  auto *F = labelOf(Inst.getFalseBB());
+
+  // A fused compare sets the flags before the phi copies, which leave them
+  // alone, so the copies may overwrite its operands. Whichever successor
+  // comes next in layout is fallen through to.
+  auto *Cmp = dyn_cast<CompareInst>(Inst.getCond());
+  if (Cmp != nullptr && isFusedWithBranch(*Cmp)) {
+    auto CC = emitCompare(*Cmp);
+    emitPhiCopies({Inst.getTrueBB(), Inst.getFalseBB()});
+    auto *Next = CurBB->getNextNode();
+    if (Inst.getTrueBB() == Next && Inst.getFalseBB() != Next) {
+      Proc.emit<Bcc>(getInverseCond(CC), F);
+    } else {
+      Proc.emit<Bcc>(CC, T);
+      if (Inst.getFalseBB() != Next)
+        Proc.emit<B>(F);
+    }
+    return;
+  }
+
+  auto *Cond = operandOf(Inst.getCond());
+  // The copies for both successors are made before branching. If the
+  // condition is one of the phis, it is saved from being overwritten.
+  auto IsPhiOf = [&](BasicBlock *BB) {
+    for (auto &Phi : *BB) {
+      if (!isa<PhiInst>(Phi))
+        break;
+      if (&Phi == Inst.getCond())
+        return true;
+    }
+    return false;
+  };
+  if (IsPhiOf(Inst.getTrueBB()) || IsPhiOf(Inst.getFalseBB())) {
+    auto *Saved = Proc.makeVirtReg();
+    Proc.emit<MOV>(Saved, Cond);
+    Cond = Saved;
+  }
+  emitPhiCopies({Inst.getTrueBB(), Inst.getFalseBB()});
   Proc.emit<CBNZ>(Cond, T);
   Proc.emit<B>(F);
 }
 
 void FunctionCG::visit(CallInst &Inst) {
-  auto &Args = Inst.getArguments();
+  auto Args = Inst.getArguments();
   assert(Args.size() <= 8);
   for (size_t I = 0; I < Args.size(); ++I) {
-    auto *Opr = ValueTable[Args[I]];
+    auto *Opr = operandOf(Args[I]);
     assert(Opr->isConstant() || Opr->isRegister());
     Proc.emit<MOV>(Unit.getPhysicsReg(I), Opr);
   }
@@ -135,17 +291,21 @@ void FunctionCG::visit(CallInst &Inst) {
 
   auto *Ret = Proc.makeVirtReg();
   Proc.emit<MOV>(Ret, Unit.getPhysicsReg(0));
-  ValueTable[&Inst] = Ret;
+  operandOf(&Inst) = Ret;
 }
 
 void FunctionCG::visit(ReturnInst &Inst) {
   // Load or Move the value to the x0. Jump to the Epilogue.
   if (auto *Ret = Inst.getVal()) {
-    auto *Opr = ValueTable[Ret];
+    auto *Opr = operandOf(Ret);
     assert(Opr->isConstant() || Opr->isRegister());
     Proc.emit<MOV>(Unit.getPhysicsReg(0), Opr);
   }
   Proc.emit<B>(Epilogue);
 }
 
+void FunctionCG::visit(PhiInst &) {
+  // Its register was made up front, and the predecessors fill it in.
+}
+
 } // namespace aarch64
@@ -1,7 +1,9 @@
 #ifndef TOY_LANG_TARGET_AARCH64_CODE_GENERATOR_H
 #define TOY_LANG_TARGET_AARCH64_CODE_GENERATOR_H
 
+#include <initializer_list>
 #include <unordered_map>
+#include <vector>
 
 #include "ir/IRCompilationUnit.h"
 #include "ir/IRVisitor.h"
@@ -10,50 +12,81 @@
 
 namespace aarch64 {
 
-class CodeGenerator : public IRVisitor {
+class CodeGenerator {
   AssemblyUnit &Unit;
   std::unordered_map<Function *, Label *> FnTable;
 
 public:
   CodeGenerator(AssemblyUnit &Unit) : Unit(Unit) {}
 
-  void visit(IRCompilationUnit &IRUnit) override;
+  /// Lower every function of \p IRUnit.
+  void lower(IRCompilationUnit &IRUnit);
+
+  /// Lower a single function. Returns nullptr if \p Fn is only declared.
+  Procedure *lower(Function &Fn);
+
+  /// Free the Procedure lowered from \p Fn, keeping only its entry label.
+  void retire(Function &Fn, Procedure &Proc);
 
   Label *lookupFunctionEntry(Function *Fn);
 };
 
-class FunctionCG : public IRVisitor {
+class FunctionCG : public IRVisitor<FunctionCG> {
   CodeGenerator &CG;
   AssemblyUnit &Unit;
   Procedure &Proc;
 
-  std::unordered_map<Value *, Operand *> ValueTable;
-  std::unordered_map<BasicBlock *, Label *> BBTable;
+  /// The operand of each value and the label of each block, indexed by ID.
+  std::vector<Operand *> ValueTable;
+  std::vector<Label *> BBTable;
+
+  Operand *&operandOf(Value *V) { return ValueTable[V->getID()]; }
+  Label *&labelOf(BasicBlock *BB) { return BBTable[BB->getID()]; }
 
   Label *Prologue = nullptr;
   Label *Epilogue = nullptr;
   // Label *InsertPoint = nullptr;
 
+  /// The block being lowered.
+  BasicBlock *CurBB = nullptr;
+
   int ArgCnt = 0;
 
+  /// Give the phis of the successors \p Succs their values for control
+  /// coming from CurBB.
+  void emitPhiCopies(std::initializer_list<BasicBlock *> Succs);
+
+  /// Whether the only use of \p Cmp is the branch that ends its block. The
+  /// branch then compares and tests the flags itself, and the boolean is
+  /// never materialized.
+  static bool isFusedWithBranch(CompareInst &Cmp);
+
+  /// Emit a CMP for \p Cmp, and return the condition that holds when its
+  /// predicate does.
+  CondCode emitCompare(CompareInst &Cmp);
+
 public:
   FunctionCG(CodeGenerator &CG, AssemblyUnit &Unit, Procedure &Proc)
       : CG(CG),
         Unit(Unit),
         Proc(Proc) {}
 
-  void visit(Function &Fn) override;
-  void visit(Parameter &Arg) override;
-  void visit(BasicBlock &BB) override;
-  void visit(Constant &C) override;
-  void visit(AllocaInst &Inst) override;
-  void visit(StoreInst &Inst) override;
-  void visit(LoadInst &Inst) override;
-  void visit(ArithmeticInst &Inst) override;
-  void visit(JumpInst &Inst) override;
-  void visit(CJumpInst &Inst) override;
-  void visit(CallInst &Inst) override;
-  void visit(ReturnInst &Inst) override;
+  using IRVisitor::visit;
+
+  void visit(Function &Fn);
+  void visit(Parameter &Arg);
+  void visit(BasicBlock &BB);
+  void visit(Constant &C);
+  void visit(AllocaInst &Inst);
+  void visit(StoreInst &Inst);
+  void visit(LoadInst &Inst);
+  void visit(ArithmeticInst &Inst);
+  void visit(CompareInst &Inst);
+  void visit(JumpInst &Inst);
+  void visit(CJumpInst &Inst);
+  void visit(CallInst &Inst);
+  void visit(ReturnInst &Inst);
+  void visit(PhiInst &Inst);
 };
 
 } // namespace aarch64
@@ -49,10 +49,7 @@ public:
         auto *VReg = static_cast<VirtualRegister *>(*Src[I]);
         auto *PReg = Unit.getPhysicsReg(8 + I);
 
-        auto It = Map.find(VReg);
-        assert(It != Map.end());
-
-        Proc.emitAt<decltype(Iter), LDR>(Lbl, Iter, PReg, It->second);
+        Proc.emitAt<decltype(Iter), LDR>(Lbl, Iter, PReg, getSlot(VReg));
         *Src[I] = PReg;
       }
 
@@ -60,12 +57,8 @@ public:
         auto *VReg = static_cast<VirtualRegister *>(*Dst[I]);
         auto *PReg = Unit.getPhysicsReg(8 + Src.size() + I);
 
-        auto [It, Res] = Map.emplace(VReg, nullptr);
-        if (Res)
-          It->second = Proc.allocateStackSlot();
-
-        Proc.emitAt<decltype(Iter), LDR>(Lbl, std::next(Iter), PReg,
-                                         It->second);
+        Proc.emitAt<decltype(Iter), STR>(Lbl, std::next(Iter), PReg,
+                                         getSlot(VReg));
         *Dst[I] = PReg;
       }
       Iter = Next;
@@ -73,6 +66,16 @@ public:
   }
 
 private:
+  /// The memory that holds \p VReg. Labels are visited in layout order, so
+  /// this may be a use that comes before the definition, like that of a phi
+  /// whose values are set at the end of a later loop body.
+  Memory *getSlot(VirtualRegister *VReg) {
+    auto [It, Inserted] = Map.emplace(VReg, nullptr);
+    if (Inserted)
+      It->second = Proc.allocateStackSlot();
+    return It->second;
+  }
+
   AssemblyUnit &Unit;
   Procedure &Proc;
   std::unordered_map<VirtualRegister *, Memory *> Map;
@@ -1,9 +1,30 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+
 #include <getopt.h>
 
+#include "analysis/CFG.h"
+#include "analysis/Dominators.h"
+#include "analysis/LoopInfo.h"
 #include "ir/IRDumper.h"
+#include "ir/ModuleSummary.h"
 #include "irgen/IRGenerator.h"
+#include "opt/PassBuilder.h"
+#include "opt/PassManager.h"
+#include "opt/PassTimings.h"
+#include "parser/ASTCache.h"
 #include "parser/ASTDumper.h"
+#include "parser/BodyMaterializer.h"
+#include "parser/CharScanner.h"
+#include "parser/ParallelParser.h"
 #include "parser/Parser.h"
+#include "parser/SourceBuffer.h"
+#include "parser/TokenBuffer.h"
 #include "target/aarch64/AssemblyDumper.h"
 #include "target/aarch64/CodeGenerator.h"
 #include "target/aarch64/NaiveRegisterAllocator.h"
@@ -12,19 +33,273 @@
 // Main driver code.
 //===----------------------------------------------------------------------===//
 
+/// Lex the whole buffer with every scanning ISA the CPU supports and report
+/// the throughput of each.
+static void benchLexer(const SourceBuffer &Buffer) {
+  using Clock = std::chrono::steady_clock;
+
+  auto Saved = scanner::getSelected();
+  for (auto Kind : {scanner::ISA::Scalar, scanner::ISA::SSE2,
+                    scanner::ISA::AVX2, scanner::ISA::NEON}) {
+    if (!scanner::isSupported(Kind))
+      continue;
+    scanner::select(Kind);
+
+    // Repeat small inputs until the measurement is long enough to trust.
+    size_t Tokens = 0;
+    size_t Rounds = 0;
+    auto Start = Clock::now();
+    do {
+      Lexer L(Buffer);
+      while (L.gettok() != tok_eof)
+        ++Tokens;
+      ++Rounds;
+    } while (Clock::now() - Start < std::chrono::milliseconds(200));
+    std::chrono::duration<double> Elapsed = Clock::now() - Start;
+
+    double MB = double(Buffer.size()) * Rounds / (1024 * 1024);
+    fmt::print("{:<8} {:>10.1f} MB/s {:>12} tokens\n", scanner::getName(Kind),
+               MB / Elapsed.count(), Tokens / Rounds);
+  }
+  scanner::select(Saved);
+}
+
+/// Lower \p Unit to IR on \p Jobs threads with each way of dispatching over
+/// the AST and report the throughput of each.
+static void benchIRGen(CompilationUnit &Unit, unsigned Jobs) {
+  using Clock = std::chrono::steady_clock;
+  using Dispatch = irgen::IRGenerator::Dispatch;
+
+  for (auto [D, Name] : {std::pair(Dispatch::Static, "static"),
+                         std::pair(Dispatch::Virtual, "virtual")}) {
+    // One untimed round, so that neither side pays for faulting in the heap.
+    irgen::IRGenerator Warmup(D);
+    Warmup.setNumThreads(Jobs);
+    Warmup.lower(Unit);
+
+    size_t Rounds = 0;
+    auto Start = Clock::now();
+    do {
+      irgen::IRGenerator IRGen(D);
+      IRGen.setNumThreads(Jobs);
+      IRGen.lower(Unit);
+      ++Rounds;
+    } while (Clock::now() - Start < std::chrono::milliseconds(200));
+    std::chrono::duration<double> Elapsed = Clock::now() - Start;
+
+    double Decls = double(Unit.getDecls().size()) * Rounds;
+    fmt::print("{:<8} {:>10.2f} ms/round {:>12.0f} decls/s\n", Name,
+               Elapsed.count() * 1000 / Rounds, Decls / Elapsed.count());
+  }
+}
+
+/// Run each analysis over every function of \p IR and report its throughput,
+/// and then the cost of adding edges to a dominator tree one at a time,
+/// against computing it again after each.
+static void benchAnalysis(IRCompilationUnit &IR) {
+  using Clock = std::chrono::steady_clock;
+  using namespace analysis;
+
+  size_t Blocks = 0;
+  for (auto &Fn : IR)
+    Blocks += Fn->getBlocks().size();
+
+  auto Measure = [&](const char *Name, auto &&Run) {
+    size_t Rounds = 0;
+    auto Start = Clock::now();
+    do {
+      for (auto &Fn : IR) {
+        CFG G(*Fn);
+        Run(G);
+      }
+      ++Rounds;
+    } while (Clock::now() - Start < std::chrono::milliseconds(200));
+    std::chrono::duration<double> Elapsed = Clock::now() - Start;
+
+    fmt::print("{:<10} {:>10.2f} ms/round {:>12.0f} blocks/s\n", Name,
+               Elapsed.count() * 1000 / Rounds,
+               double(Blocks) * Rounds / Elapsed.count());
+  };
+
+  // Each line includes the analyses that the one it measures needs.
+  Measure("cfg", [](CFG &) {});
+  Measure("domtree", [](CFG &G) { DominatorTree DT(G); });
+  Measure("frontier", [](CFG &G) {
+    DominatorTree DT(G);
+    DominanceFrontier DF(G, DT);
+  });
+  Measure("loops", [](CFG &G) {
+    DominatorTree DT(G);
+    LoopInfo LI(G, DT);
+  });
+
+  // Add edges between random blocks of the largest function, as a pass that
+  // rewires branches would.
+  auto Largest = std::max_element(IR.begin(), IR.end(), [](auto &A, auto &B) {
+    return A->getBlocks().size() < B->getBlocks().size();
+  });
+  if (Largest == IR.end() || (*Largest)->getBlocks().size() < 2)
+    return;
+
+  constexpr unsigned Edges = 100;
+  for (bool Incremental : {true, false}) {
+    CFG G(**Largest);
+    DominatorTree DT(G);
+    std::mt19937 Rand(42);
+    std::uniform_int_distribution<unsigned> Pick(0, G.size() - 1);
+
+    auto Start = Clock::now();
+    for (unsigned I = 0; I < Edges; ++I) {
+      unsigned From = Pick(Rand);
+      unsigned To = Pick(Rand);
+      if (!G.addEdge(From, To))
+        continue;
+      if (Incremental)
+        DT.insertEdge(From, To);
+      else
+        DT.recalculate();
+    }
+    std::chrono::duration<double> Elapsed = Clock::now() - Start;
+
+    fmt::print("{:<10} {:>10.2f} us/edge {:>13} blocks\n",
+               Incremental ? "insert" : "recompute",
+               Elapsed.count() * 1e6 / Edges, G.size());
+  }
+}
+
+/// Parse \p Buffer into \p Tree. With a \p CacheDir, reuse the tree saved by
+/// an earlier compilation of the same bytes, or save this one for the next.
+static void parseFlat(const SourceBuffer &Buffer, FlatAST &Tree,
+                      const std::string &CacheDir) {
+  std::optional<ASTCache> Cache;
+  if (!CacheDir.empty()) {
+    Cache.emplace(CacheDir, Buffer);
+    bool Hit = Cache->load(Tree);
+    fmt::print(stderr, "toyc: parse cache {}: {}\n", Hit ? "hit" : "miss",
+               Cache->getEntryPath());
+    if (Hit)
+      return;
+  }
+
+  auto Tokens = TokenBuffer::tokenize(Buffer);
+  FlatParser P(Buffer, *Tokens);
+  P.Parse(Tree);
+
+  // Never cache what error recovery made of a broken input.
+  if (Cache && P.getNumErrors() == 0)
+    Cache->store(Tree);
+}
+
+/// Compile one top-level declaration at a time: parse it, lower it, allocate
+/// registers and print every stage, then free its AST, IR body and machine
+/// code before moving on. Only prototypes and the function tables outlive a
+/// declaration, and the lexer is kept a bounded distance ahead of the parser,
+/// so memory use does not grow with the size of the input.
+static void compileStreaming(SourceBuffer &Buffer, bool DumpAST,
+                             irgen::IRGenerator &IRGen,
+                             opt::FunctionPassManager &FPM,
+                             opt::AnalysisManager &AM) {
+  auto *Timings = AM.getTimings();
+
+  // Tokens the lexer may run ahead of the parser.
+  constexpr size_t Window = 1 << 16;
+
+  auto Tokens = TokenBuffer::tokenize(Buffer, /*Async=*/true, Window);
+  Parser P(Buffer, *Tokens);
+
+  aarch64::AssemblyUnit ASMUnit;
+  aarch64::CodeGenerator CG(ASMUnit);
+  aarch64::AssemblyDumper ASMDumper(stdout);
+
+  CompilationUnit Decl;
+  while (P.ParseTopLevel(Decl)) {
+    // Everything before the lookahead token has been parsed.
+    Tokens->release(P.getCurPos());
+    Buffer.release(Tokens->getOffset(P.getCurPos()));
+
+    if (DumpAST)
+      ASTDumper(stdout, Decl);
+
+    for (auto &D : Decl.getDecls()) {
+      Function *Fn = nullptr;
+      {
+        opt::PassTimings::Scope Timer(Timings, "irgen");
+        Fn = IRGen.lower(*D);
+      }
+      if (IRGen.getNumErrors() != 0)
+        exit(1);
+      if (Fn == nullptr)
+        continue;
+
+      FPM.run(*Fn, AM);
+      AM.clear(*Fn);
+      IRDumper(stdout, *Fn);
+
+      aarch64::Procedure *Proc = nullptr;
+      {
+        opt::PassTimings::Scope Timer(Timings, "codegen");
+        Proc = CG.lower(*Fn);
+      }
+      if (Proc != nullptr) {
+        ASMDumper.dump(*Proc);
+        {
+          opt::PassTimings::Scope Timer(Timings, "regalloc");
+          aarch64::NaiveRegisterAllocator RA(ASMUnit, *Proc);
+          RA.run();
+        }
+        ASMDumper.dump(*Proc);
+        CG.retire(*Fn, *Proc);
+      }
+      // An imported body stays available for inlining into later callers.
+      if (!Fn->isAvailableExternally())
+        Fn->releaseBody();
+    }
+
+    Decl = CompilationUnit();
+  }
+}
+
 int main(int argc, char *argv[]) {
   int C = 0;
   int DumpAST = 0;
+  int BenchLexer = 0;
+  int BenchIRGen = 0;
+  int BenchAnalysis = 0;
+  int Stream = 0;
+  int UseFlatAST = 0;
+  int Lazy = 0;
+  int EmitSummary = 0;
+  int TimePasses = 0;
+  int Stats = 0;
+  // Directories given with -I, searched for imported module summaries.
+  std::vector<std::string> ImportDirs;
+  // Directory of the parse cache; empty to not use one.
+  std::string CacheDir;
+  // Worker threads for the parallel stages; 0 means one per hardware thread.
+  unsigned Jobs = 1;
+  unsigned OptLevel = opt::DefaultOptLevel;
 
   opterr = 0;
   while (true) {
     static struct option long_options[] = {
         {"dump-ast", no_argument, &DumpAST, 1},
+        {"bench-lexer", no_argument, &BenchLexer, 1},
+        {"bench-irgen", no_argument, &BenchIRGen, 1},
+        {"bench-analysis", no_argument, &BenchAnalysis, 1},
+        {"stream", no_argument, &Stream, 1},
+        {"flat-ast", no_argument, &UseFlatAST, 1},
+        {"lazy", no_argument, &Lazy, 1},
+        {"emit-summary", no_argument, &EmitSummary, 1},
+        {"time-passes", no_argument, &TimePasses, 1},
+        {"stats", no_argument, &Stats, 1},
+        {"import-dir", required_argument, nullptr, 'I'},
+        {"jobs", required_argument, nullptr, 'j'},
+        {"cache-dir", required_argument, nullptr, 'C'},
         {nullptr, 0, nullptr, 0},
     };
 
     int option_index = 0;
-    C = getopt_long(argc, argv, "", long_options, &option_index);
+    C = getopt_long(argc, argv, "j:I:O:C:", long_options, &option_index);
     if (C == -1)
       break;
 
@@ -41,6 +316,28 @@ int main(int argc, char *argv[]) {
       else
         printError("option {}", long_options[option_index].name);
       break;
+    case 'j': {
+      char *End = nullptr;
+      Jobs = strtoul(optarg, &End, 10);
+      if (*optarg == '\0' || *End != '\0') {
+        printError("Invalid number of jobs \"{}\"", optarg);
+        exit(1);
+      }
+      if (Jobs == 0)
+        Jobs = std::max(1U, std::thread::hardware_concurrency());
+      break;
+    }
+    case 'O': {
+      char *End = nullptr;
+      OptLevel = strtoul(optarg, &End, 10);
+      if (*optarg == '\0' || *End != '\0' || OptLevel > opt::MaxOptLevel) {
+        printError("Invalid optimization level \"-O{}\"", optarg);
+        exit(1);
+      }
+      break;
+    }
+    case 'C': CacheDir = optarg; break;
+    case 'I': ImportDirs.push_back(optarg); break;
     case '?': printError("Invalid option \"-{}\"", (char)optopt); exit(1);
     default: printError("Invalid option \"-{}\"", (char)C); exit(1);
     }
@@ -51,38 +348,136 @@ int main(int argc, char *argv[]) {
     exit(1);
   }
 
-  FILE *Stream = fopen(argv[optind], "r");
-  if (Stream == nullptr) {
+  auto Buffer = SourceBuffer::open(argv[optind]);
+  if (Buffer == nullptr) {
     printError("{}: \"{}\"", strerror(errno), argv[optind]);
     exit(2);
   }
 
-  CompilationUnit Unit;
+  if (BenchLexer) {
+    benchLexer(*Buffer);
+    return 0;
+  }
 
-  Parser P(Stream, argv[optind]);
+  // Imports are looked up next to the input first.
+  irgen::IRGenerator IRGen;
+  std::filesystem::path InputPath(argv[optind]);
+  IRGen.addImportPath(InputPath.has_parent_path()
+                          ? InputPath.parent_path().string()
+                          : std::string("."));
+  for (auto &Dir : ImportDirs)
+    IRGen.addImportPath(Dir);
+  IRGen.setNumThreads(Jobs);
 
-  // Run the main "interpreter loop" now.
-  P.Parse(Unit);
+  opt::PassTimings Timings;
+  opt::AnalysisManager AM(TimePasses ? &Timings : nullptr);
+  auto Report = [&](const opt::Pass &Pipeline) {
+    if (Stats)
+      opt::printStatisticsReport(stderr, Pipeline);
+    if (TimePasses)
+      Timings.print(stderr);
+  };
 
-  if (DumpAST)
-    ASTDumper(stdout, Unit);
+  if (Stream) {
+    // The bodies are gone by the time the whole module has been seen.
+    if (EmitSummary) {
+      printError("--emit-summary cannot be used with --stream");
+      exit(1);
+    }
+    auto FPM = opt::buildFunctionPipeline(OptLevel);
+    compileStreaming(*Buffer, DumpAST, IRGen, *FPM, AM);
+    Report(*FPM);
+    return 0;
+  }
 
-  irgen::IRGenerator IRGen;
-  Unit.accept(IRGen);
+  // The parse cache holds FlatASTs, so using it implies --flat-ast.
+  if (UseFlatAST || !CacheDir.empty()) {
+    FlatAST Tree;
+    {
+      opt::PassTimings::Scope Timer(AM.getTimings(), "parse");
+      parseFlat(*Buffer, Tree, CacheDir);
+    }
+
+    if (DumpAST)
+      ASTDumper(stdout, Tree);
+
+    opt::PassTimings::Scope Timer(AM.getTimings(), "irgen");
+    IRGen.lower(Tree);
+  } else {
+    std::optional<opt::PassTimings::Scope> ParseTimer(
+        std::in_place, AM.getTimings(), "parse");
+    auto Tokens = TokenBuffer::tokenize(*Buffer);
+    CompilationUnit Unit;
+    if (Lazy) {
+      // Only parse what main can reach.
+      Parser P(*Buffer, *Tokens);
+      P.setLazyBodies(true);
+      P.Parse(Unit);
+
+      Symbol Roots[] = {Symbol::intern("main")};
+      BodyMaterializer(*Buffer, *Tokens, Unit).materializeReachable(Roots);
+    } else if (Jobs > 1) {
+      parseInParallel(*Buffer, *Tokens, Unit, Jobs);
+    } else {
+      Parser P(*Buffer, *Tokens);
+
+      // Run the main "interpreter loop" now.
+      P.Parse(Unit);
+    }
+    ParseTimer.reset();
+
+    if (DumpAST)
+      ASTDumper(stdout, Unit);
+
+    if (BenchIRGen) {
+      benchIRGen(Unit, Jobs);
+      return 0;
+    }
+
+    opt::PassTimings::Scope Timer(AM.getTimings(), "irgen");
+    IRGen.lower(Unit);
+  }
+
+  if (IRGen.getNumErrors() != 0)
+    exit(1);
+
+  if (BenchAnalysis) {
+    benchAnalysis(IRGen.getIR());
+    return 0;
+  }
+
+  auto MPM = opt::buildModulePipeline(OptLevel);
+  MPM->run(IRGen.getIR(), AM);
+
+  // Save the interface of this module for others to import, next to it.
+  if (EmitSummary) {
+    auto SummaryPath = InputPath.replace_extension(".tsum").string();
+    if (!ModuleSummary::write(SummaryPath, IRGen.getIR())) {
+      printError("cannot write module summary \"{}\"", SummaryPath);
+      exit(1);
+    }
+  }
 
   IRDumper(stdout, IRGen.getIR());
 
   aarch64::AssemblyUnit ASMUnit;
   aarch64::CodeGenerator CG(ASMUnit);
-  IRGen.getIR().accept(CG);
+  {
+    opt::PassTimings::Scope Timer(AM.getTimings(), "codegen");
+    CG.lower(IRGen.getIR());
+  }
 
   aarch64::AssemblyDumper ASMDumper(stdout);
   ASMDumper.dump(ASMUnit);
-  for (auto &Proc : ASMUnit.getDefinedProcedures()) {
-    aarch64::NaiveRegisterAllocator RA(ASMUnit, *Proc);
-    RA.run();
+  {
+    opt::PassTimings::Scope Timer(AM.getTimings(), "regalloc");
+    for (auto &Proc : ASMUnit.getDefinedProcedures()) {
+      aarch64::NaiveRegisterAllocator RA(ASMUnit, *Proc);
+      RA.run();
+    }
   }
   ASMDumper.dump(ASMUnit);
 
+  Report(*MPM);
   return 0;
 }